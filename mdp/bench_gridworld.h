@@ -0,0 +1,31 @@
+#ifndef REINFORCEMENT_LEARNING_BENCH_GRIDWORLD_H
+#define REINFORCEMENT_LEARNING_BENCH_GRIDWORLD_H
+
+#include <mdp/gridworld.h>
+
+#include <chrono>
+#include <memory>
+
+using Clock = std::chrono::steady_clock;
+using ms_duration = std::chrono::duration<double, std::milli>;
+
+/// Builds the gridworld shared by the benchmarks: rows of walls every few cells with a gap at the end, and the
+/// goal in the last corner
+/// \tparam TGridworld
+/// \param size
+/// \return
+template<class TGridworld = rl::mdp::Gridworld>
+std::shared_ptr<TGridworld> create_gridworld(size_t size) {
+    using Reward = typename TGridworld::Reward;
+
+    auto gridworld = std::make_shared<TGridworld>(size, size);
+    gridworld->cost_of_living(Reward{-1});
+    for (size_t row = 2; row < size - 1; row += 4) {
+        for (size_t column = 0; column + 2 < size; ++column) gridworld->set_wall_state({row, column}, Reward{-2});
+    }
+    gridworld->set_initial_state({0, 0});
+    gridworld->set_terminal_state({size - 1, size - 1}, Reward{10});
+    return gridworld;
+}
+
+#endif //REINFORCEMENT_LEARNING_BENCH_GRIDWORLD_H
@@ -0,0 +1,73 @@
+#include <mdp/gridworld.h>
+#include <mdp/agents.h>
+
+#include "bench_gridworld.h"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cstdlib>
+
+using rl::mdp::GridworldState;
+using rl::mdp::GridworldAction;
+
+/// Measures policy evaluation sweeps and environment steps for a reward type
+/// \tparam TReward
+/// \param size
+/// \param sweeps
+/// \param steps
+template<class TReward>
+void run_benchmark(const std::string& name, size_t size, size_t sweeps, size_t steps) {
+    using Gridworld = rl::mdp::BasicGridworld<TReward>;
+    using Policy = rl::mdp::BasicGridworldGreedyPolicy<TReward>;
+    using Environment = rl::mdp::MDPEnvironment<Gridworld>;
+    using Agent = rl::mdp::TD0Agent<GridworldState, GridworldAction, TReward, rl::mdp::GridworldStateIndexer>;
+
+    auto gridworld = create_gridworld<Gridworld>(size);
+    Policy policy(gridworld, 0.99);
+
+    // Sweeps over the gridworld and over the compiled model
+    auto start = Clock::now();
+    for (size_t i = 0; i != sweeps; ++i) policy.policy_evaluation();
+    double sweep_ms = ms_duration(Clock::now() - start).count() / static_cast<double>(sweeps);
+
+    policy.compile_model();
+    start = Clock::now();
+    for (size_t i = 0; i != sweeps; ++i) policy.policy_evaluation();
+    double compiled_sweep_ms = ms_duration(Clock::now() - start).count() / static_cast<double>(sweeps);
+
+    // Agent-environment steps, restarting when an episode ends
+    Environment environment(gridworld, 42, rl::mdp::SamplingMode::ALIAS);
+    Agent agent(0.1, 0.99, 0.1, 42, gridworld->state_indexer());
+    start = Clock::now();
+    GridworldAction action = agent.start(environment.start());
+    for (size_t i = 0; i != steps; ++i) {
+        auto [next_state, reward, is_terminal] = environment.step(action);
+        if (is_terminal) {
+            agent.end(reward);
+            action = agent.start(environment.start());
+        } else {
+            action = agent.step(reward, next_state);
+        }
+    }
+    double steps_per_second = static_cast<double>(steps) / (ms_duration(Clock::now() - start).count() / 1000.0);
+
+    fmt::print("{:>6} | {:>5}x{:<5} | value table {:>8.1f} KiB | sweep {:>8.3f} ms | compiled sweep {:>8.3f} ms | "
+               "{:>10.0f} steps/s\n",
+               name, size, size, static_cast<double>(size * size * sizeof(TReward)) / 1024.0,
+               sweep_ms, compiled_sweep_ms, steps_per_second);
+}
+
+int main(int argc, char** argv) {
+    // Optional arguments: grid size, sweeps and steps
+    size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512;
+    size_t sweeps = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+    size_t steps = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1000000;
+
+    run_benchmark<double>("double", size, sweeps, steps);
+    run_benchmark<float>("float", size, sweeps, steps);
+
+    return 0;
+}
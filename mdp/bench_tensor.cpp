@@ -0,0 +1,49 @@
+#include <mdp/gridworld.h>
+#include <mdp/tensor_mdp.h>
+
+#include "bench_gridworld.h"
+
+#include <fmt/core.h>
+
+#include <chrono>
+#include <memory>
+#include <cstdlib>
+
+using rl::mdp::Gridworld;
+using rl::mdp::GridworldState;
+using rl::mdp::GridworldAction;
+
+/// Times a number of sweeps of a policy
+/// \return Milliseconds per sweep
+template<class Policy>
+double time_sweeps(Policy& policy, size_t sweeps) {
+    auto start = Clock::now();
+    for (size_t i = 0; i != sweeps; ++i) policy.policy_evaluation();
+    return ms_duration(Clock::now() - start).count() / static_cast<double>(sweeps);
+}
+
+int main(int argc, char** argv) {
+    // Optional arguments: largest grid size and sweeps
+    size_t max_size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 32;
+    size_t sweeps = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+    for (size_t size = 4; size <= max_size; size *= 2) {
+        auto gridworld = create_gridworld(size);
+
+        rl::mdp::GridworldGreedyPolicy greedy(gridworld, 0.99);
+        double greedy_ms = time_sweeps(greedy, sweeps);
+
+        auto start = Clock::now();
+        auto tensors = std::make_shared<const rl::mdp::TensorMDP<GridworldState, GridworldAction>>(*gridworld);
+        double export_ms = ms_duration(Clock::now() - start).count();
+
+        rl::mdp::TensorGreedyPolicy<GridworldState, GridworldAction> tensor_policy(tensors, 0.99);
+        double tensor_ms = time_sweeps(tensor_policy, sweeps);
+
+        fmt::print("{:>4}x{:<4} | {:>6} states | export {:>9.3f} ms | GridworldGreedyPolicy {:>9.4f} ms/sweep | "
+                   "TensorGreedyPolicy {:>9.4f} ms/sweep\n",
+                   size, size, size * size, export_ms, greedy_ms, tensor_ms);
+    }
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <mdp/gridworld.h>
 #include <mdp/mdp.h>
+#include <mdp/states.h>
 
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
@@ -11,17 +12,21 @@
 #include <vector>
 #include <utility>
 #include <map>
+#include <limits>
 #include <numeric>
 #include <algorithm>
 
 namespace rl::mdp {
 
     /// Represents a basic agent with a random policy
-    template<class TState, class TAction>
-    class BasicRandomAgent: public MDPAgent<TState, TAction> {
+    /// \tparam TState
+    /// \tparam TAction
+    /// \tparam TReward
+    template<class TState, class TAction, class TReward=double>
+    class BasicRandomAgent: public MDPAgent<TState, TAction, TReward> {
     public:
         using RandomEngine = std::default_random_engine;
-        using Reward = typename MDPAgent<TState, TAction>::Reward;
+        using Reward = typename MDPAgent<TState, TAction, TReward>::Reward;
         using Actions = ActionTraits<TAction>;
 
         /// Default constructor
@@ -75,30 +80,53 @@ namespace rl::mdp {
         Reward m_total_reward;
     };
 
-    /// Basic agent policy that
+    /// Basic agent policy that keeps the action values in a flat table, indexed by a state indexer
     /// \tparam TState
     /// \tparam TAction
     /// \tparam TValue
-    template<class TState, class TAction, class TValue=double>
+    /// \tparam TIndexer Maps states to dense ids, e.g. StateIndexer or GridworldStateIndexer
+    template<class TState, class TAction, class TValue=double, class TIndexer=StateIndexer<TState>>
     class BasicAgentPolicy{
     public:
         using RandomEngine = std::default_random_engine;
+        using Indexer = TIndexer;
 
         /// Initializes the Policy
         /// \param seed Seed for the random generator, 0 if random seed
-        explicit BasicAgentPolicy(RandomEngine::result_type seed = 0): m_random_engine(seed),
-        m_action_distribution(0, Actions::total_actions() - 1){
+        /// \param indexer Indexer used for mapping states to rows of the value table
+        explicit BasicAgentPolicy(RandomEngine::result_type seed = 0, Indexer indexer = Indexer{}):
+        m_indexer(std::move(indexer)), m_value_function(m_indexer.size(), ActionArray{}),
+        m_random_engine(seed), m_action_distribution(0, Actions::total_actions() - 1){
             if(seed == 0){
                 m_random_engine.seed(std::random_device{}());
             }
         }
 
+        /// Returns the row of the value table for a state, growing the table if needed
+        /// \param state
+        /// \return
+        size_t state_index(const TState& state){
+            size_t idx = m_indexer.index(state);
+            if(idx >= m_value_function.size()){
+                m_value_function.resize(std::max(idx + 1, m_indexer.size()), ActionArray{});
+            }
+            return idx;
+        }
+
+        /// Returns the value of a state action pair, with the state given by its index
+        /// \param state_idx
+        /// \param action
+        /// \return
+        TValue& indexed_value(size_t state_idx, const TAction& action){
+            return m_value_function[state_idx][Actions::id(action)];
+        }
+
         /// Returns the value of a state action pair
         /// \param state
         /// \param action
         /// \return
         TValue& value(const TState& state, const TAction& action){
-            return m_value_function[state][Actions::id(action)];
+            return indexed_value(state_index(state), action);
         }
 
         /// Returns the valie of a state action pair, sent as pair
@@ -113,7 +141,7 @@ namespace rl::mdp {
         /// \param state
         /// \return
         TAction best_action(const TState& state){
-            auto& actions = m_value_function[state];
+            auto& actions = m_value_function[state_index(state)];
             auto best_iter = std::max_element(actions.cbegin(), actions.cend());
 
             return Actions::from_id(std::distance(actions.cbegin(), best_iter));
@@ -137,8 +165,10 @@ namespace rl::mdp {
 
     private:
         using Actions = ActionTraits<TAction>;
-        using ActionArray = std::array<double, ActionTraits<TAction>::total_actions()>;
-        std::map<TState, ActionArray> m_value_function;
+        using ActionArray = std::array<TValue, ActionTraits<TAction>::total_actions()>;
+
+        Indexer m_indexer;
+        std::vector<ActionArray> m_value_function;
 
         RandomEngine m_random_engine;
         std::uniform_int_distribution<size_t> m_action_distribution;
@@ -147,31 +177,34 @@ namespace rl::mdp {
     /// Agent that implements the MonteCarlo approach to learning
     /// \tparam TState
     /// \tparam TAction
-    template<class TState, class TAction>
-    class MCAgent: public MDPAgent<TState, TAction>{
+    /// \tparam TReward Type of the rewards, returns and action values
+    /// \tparam TIndexer Maps states to dense ids, e.g. StateIndexer or GridworldStateIndexer
+    template<class TState, class TAction, class TReward=double, class TIndexer=StateIndexer<TState>>
+    class MCAgent: public MDPAgent<TState, TAction, TReward>{
     public:
-        using Reward = typename MDPAgent<TState, TAction>::Reward;
-        using Policy = BasicAgentPolicy<TState, TAction>;
+        using Reward = typename MDPAgent<TState, TAction, TReward>::Reward;
+        using Policy = BasicAgentPolicy<TState, TAction, TReward, TIndexer>;
         using RandomEngine = typename Policy::RandomEngine;
 
-        explicit MCAgent(double gamma = 1.0, double epsilon = 0.1, typename RandomEngine::result_type seed = 0):
-        m_gamma(gamma), m_epsilon(epsilon), m_policy(seed) {}
+        explicit MCAgent(Reward gamma = 1.0, double epsilon = 0.1, typename RandomEngine::result_type seed = 0,
+                         TIndexer indexer = TIndexer{}):
+        m_gamma(gamma), m_epsilon(epsilon), m_policy(seed, std::move(indexer)) {}
 
         TAction start(const TState &initial_state) override {
             // Select initial action
             auto action = m_policy.best_action_e(initial_state, m_epsilon);
 
-            // Restart episode information
+            // Restart episode information, clearing only the visited flags of the last episode
+            for(const auto& [state_idx, a, r]: m_episode_run){
+                if(state_idx != NO_STATE) m_state_action_visited[state_action_index(state_idx, a)] = false;
+            }
             m_episode_run.clear();
             m_is_first_visit.clear();
-            m_state_action_visited.clear();
 
             // Add information of this step
-            m_episode_run.push_back({initial_state, action, 0.0});
-
-            StateAction state_action{initial_state, action};
-            m_is_first_visit.push_back(true);
-            m_state_action_visited.insert(state_action);
+            size_t state_idx = m_policy.state_index(initial_state);
+            m_episode_run.push_back({state_idx, action, Reward{}});
+            m_is_first_visit.push_back(visit(state_idx, action));
 
             return action;
         }
@@ -179,22 +212,20 @@ namespace rl::mdp {
         TAction step(const Reward &reward, const TState &next_state) override {
             // Select action and add episode information
             auto action = m_policy.best_action_e(next_state, m_epsilon);
-            m_episode_run.push_back({next_state, action, reward});
+            size_t state_idx = m_policy.state_index(next_state);
+            m_episode_run.push_back({state_idx, action, reward});
 
             // Check if it is the first visit
-            StateAction state_action{next_state, action};
-            bool is_first_visit = m_state_action_visited.find(state_action) == m_state_action_visited.end();
-            m_is_first_visit.push_back(is_first_visit);
-            m_state_action_visited.insert(state_action);
+            m_is_first_visit.push_back(visit(state_idx, action));
 
             return action;
         }
 
         void end(const Reward &reward) override {
-            m_episode_run.push_back({TState{}, TAction{}, reward});
+            m_episode_run.push_back({NO_STATE, TAction{}, reward});
 
             // Learn from episode information
-            Reward total_return = 0.0;  // G
+            Reward total_return{};  // G
 
             // The last episode is the second to last, as the last only contains Reward info
             long last_episode = m_episode_run.size()-2;
@@ -206,56 +237,88 @@ namespace rl::mdp {
 
                 // Check if first visit
                 if(m_is_first_visit[idx]){
-                    StateAction state_action{std::get<ID_STATE>(current_step), std::get<ID_ACTION>(current_step)};
-                    m_returns[state_action](total_return);
+                    size_t state_idx = std::get<ID_STATE>(current_step);
+                    const TAction& action = std::get<ID_ACTION>(current_step);
+                    auto& returns = m_returns[state_action_index(state_idx, action)];
+                    returns(total_return);
 
-                    m_policy.value(state_action) = boost::accumulators::mean(m_returns[state_action]);
+                    m_policy.indexed_value(state_idx, action) = boost::accumulators::mean(returns);
                 }
             }
         }
 
     private:
-        double m_gamma, m_epsilon;
+        Reward m_gamma;
+        double m_epsilon;
 
         // Policy information
         Policy m_policy;
 
-        // Episode memory
-        using StateActionReward = std::tuple<TState, TAction, Reward>;
-        using StateAction = std::pair<TState, TAction>;
+        // Episode memory, states are stored by index
+        static constexpr size_t NO_STATE = std::numeric_limits<size_t>::max();
+        using StateActionReward = std::tuple<size_t, TAction, Reward>;
         std::vector<StateActionReward> m_episode_run;
 
         // First visit
-        // If the StateAction has been visited
-        std::set<StateAction> m_state_action_visited;
+        // If the StateAction has been visited, indexed by state_action_index
+        std::vector<bool> m_state_action_visited;
 
         // Where has the StateAction was first visited
         std::vector<bool> m_is_first_visit;
 
-        // Returns information
+        // Returns information, indexed by state_action_index
         using ReturnsInfo = boost::accumulators::accumulator_set<Reward,
             boost::accumulators::stats<boost::accumulators::tag::mean>>;
-        std::map<StateAction, ReturnsInfo> m_returns;
+        std::vector<ReturnsInfo> m_returns;
+
+        /// Returns the flat index of a state-action pair
+        /// \param state_idx
+        /// \param action
+        /// \return
+        static size_t state_action_index(size_t state_idx, const TAction& action){
+            return state_idx * ActionTraits<TAction>::total_actions() + ActionTraits<TAction>::id(action);
+        }
+
+        /// Marks a state-action pair as visited, growing the tables if needed
+        /// \param state_idx
+        /// \param action
+        /// \return True if it is the first visit in the episode
+        bool visit(size_t state_idx, const TAction& action){
+            size_t sa_idx = state_action_index(state_idx, action);
+            if(sa_idx >= m_state_action_visited.size()){
+                size_t new_size = (state_idx + 1) * ActionTraits<TAction>::total_actions();
+                m_state_action_visited.resize(new_size, false);
+                m_returns.resize(new_size);
+            }
+
+            bool is_first_visit = !m_state_action_visited[sa_idx];
+            m_state_action_visited[sa_idx] = true;
+            return is_first_visit;
+        }
     };
 
     /// Agent that implements the TD(0) approach to learning
     /// \tparam TState
     /// \tparam TAction
-    template<class TState, class TAction>
-    class TD0Agent: public MDPAgent<TState, TAction>{
+    /// \tparam TReward Type of the rewards and action values
+    /// \tparam TIndexer Maps states to dense ids, e.g. StateIndexer or GridworldStateIndexer
+    template<class TState, class TAction, class TReward=double, class TIndexer=StateIndexer<TState>>
+    class TD0Agent: public MDPAgent<TState, TAction, TReward>{
     public:
-        using typename MDPAgent<TState, TAction>::Reward;
-        using RandomEngine = typename BasicAgentPolicy<TState, TAction>::RandomEngine;
+        using typename MDPAgent<TState, TAction, TReward>::Reward;
+        using Policy = BasicAgentPolicy<TState, TAction, TReward, TIndexer>;
+        using RandomEngine = typename Policy::RandomEngine;
 
-        explicit TD0Agent(double alpha = 0.2,
-                          double gamma = 1.0,
+        explicit TD0Agent(Reward alpha = 0.2,
+                          Reward gamma = 1.0,
                           double epsilon = 0.1,
-                          typename RandomEngine::result_type seed = 0)
-        : m_gamma(gamma), m_epsilon(epsilon), m_policy(seed), m_alpha(alpha)
+                          typename RandomEngine::result_type seed = 0,
+                          TIndexer indexer = TIndexer{})
+        : m_epsilon(epsilon), m_gamma(gamma), m_alpha(alpha), m_policy(seed, std::move(indexer))
         {}
 
         TAction start(const TState &initial_state) override {
-            m_last_state = initial_state;
+            m_last_state = m_policy.state_index(initial_state);
             m_last_action = m_policy.best_action_e(initial_state, m_epsilon);
 
             return m_last_action;
@@ -263,26 +326,29 @@ namespace rl::mdp {
 
         TAction step(const Reward &reward, const TState &next_state) override {
             TAction next_action = m_policy.best_action_e(next_state, m_epsilon);
+            size_t next_state_idx = m_policy.state_index(next_state);
 
-            Reward value = m_alpha * (reward + m_gamma * m_policy.value(next_state, next_action) - m_policy.value(m_last_state, m_last_action));
-            m_policy.value(m_last_state, m_last_action) += value;
+            Reward value = m_alpha * (reward + m_gamma * m_policy.indexed_value(next_state_idx, next_action) - m_policy.indexed_value(m_last_state, m_last_action));
+            m_policy.indexed_value(m_last_state, m_last_action) += value;
 
-            m_last_state = next_state;
+            m_last_state = next_state_idx;
             m_last_action = next_action;
 
             return next_action;
         }
 
         void end(const Reward &reward) override {
-            Reward value = m_alpha * (reward - m_policy.value(m_last_state, m_last_action));
-            m_policy.value(m_last_state, m_last_action) += value;
+            Reward value = m_alpha * (reward - m_policy.indexed_value(m_last_state, m_last_action));
+            m_policy.indexed_value(m_last_state, m_last_action) += value;
         }
 
     private:
-        double m_epsilon, m_gamma, m_alpha;
-        BasicAgentPolicy<TState, TAction> m_policy;
+        double m_epsilon;
+        Reward m_gamma, m_alpha;
+        Policy m_policy;
 
-        TState m_last_state;
+        // Last state is stored by index
+        size_t m_last_state;
         TAction m_last_action;
     };
 
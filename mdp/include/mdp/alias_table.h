@@ -0,0 +1,144 @@
+#ifndef REINFORCEMENT_LEARNING_ALIAS_TABLE_H
+#define REINFORCEMENT_LEARNING_ALIAS_TABLE_H
+
+#include <mdp/actions.h>
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace rl::mdp {
+
+    /// Walker/Vose alias tables for the transitions of every State-Action pair of an MDP that provides the
+    /// state indexing hooks (num_states, for_each_indexed_transition). After building, a transition is
+    /// sampled in O(1) with a single uniform number and without allocations.
+    /// \tparam TAction
+    /// \tparam TReward
+    /// \tparam TProbability
+    template<class TAction, class TReward=double, class TProbability=double>
+    class AliasTable {
+    public:
+        using Actions = ActionTraits<TAction>;
+
+        /// Builds the tables for all the State-Action pairs of the given MDP
+        /// \tparam MDP
+        /// \param mdp
+        template<class MDP>
+        void build(const MDP& mdp) {
+            const size_t total_actions = Actions::total_actions();
+            const size_t total_states = mdp.num_states();
+
+            m_entries.clear();
+            m_offsets.assign(1, 0);
+            m_offsets.reserve(total_states * total_actions + 1);
+
+            for (size_t s = 0; s != total_states; ++s) {
+                for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                    size_t begin = m_entries.size();
+                    mdp.for_each_indexed_transition(s, Actions::from_id(action_id),
+                                                    [this](size_t s_i, const TReward& r, const TProbability& p) {
+                        m_entries.push_back(Entry{p, 0, s_i, r});
+                    });
+
+                    build_range(begin, m_entries.size());
+                    m_offsets.push_back(m_entries.size());
+                }
+            }
+        }
+
+        /// Returns true if the State-Action pair has transitions
+        /// \param state_idx
+        /// \param action_id
+        /// \return
+        [[nodiscard]]
+        bool has_transitions(size_t state_idx, size_t action_id) const {
+            size_t row = state_idx * Actions::total_actions() + action_id;
+            return m_offsets[row] != m_offsets[row + 1];
+        }
+
+        /// Samples a transition of the State-Action pair, which must have transitions.
+        /// \param state_idx
+        /// \param action_id
+        /// \param target_probability Uniform value in [0, 1)
+        /// \return Pair with [next state index, reward]
+        [[nodiscard]]
+        std::pair<size_t, TReward> sample(size_t state_idx, size_t action_id, TProbability target_probability) const {
+            size_t row = state_idx * Actions::total_actions() + action_id;
+            size_t begin = m_offsets[row], size = m_offsets[row + 1] - begin;
+
+            // Use the integer part to select a column and the fractional part to choose between it and its alias
+            TProbability scaled = target_probability * static_cast<TProbability>(size);
+            size_t column = std::min(static_cast<size_t>(scaled), size - 1);
+            const Entry& entry = m_entries[begin + column];
+
+            const Entry& chosen = (scaled - static_cast<TProbability>(column)) < entry.threshold ?
+                    entry : m_entries[begin + entry.alias];
+            return {chosen.successor, chosen.reward};
+        }
+
+    private:
+        struct Entry {
+            TProbability threshold;
+            uint32_t alias;
+            size_t successor;
+            TReward reward;
+        };
+
+        std::vector<size_t> m_offsets;
+        std::vector<Entry> m_entries;
+
+        // Work lists reused between builds
+        std::vector<uint32_t> m_small, m_large;
+
+        /// Runs Vose's algorithm over the last entries [begin, end), whose thresholds hold the probabilities.
+        /// The entries are removed if their probabilities do not add up to a positive value, so the
+        /// State-Action pair has no transitions, as when sampling linearly.
+        /// \param begin
+        /// \param end
+        void build_range(size_t begin, size_t end) {
+            auto size = static_cast<uint32_t>(end - begin);
+            if (size == 0) return;
+
+            // Scale probabilities so the average column has weight 1
+            TProbability total_probability{};
+            for (size_t i = begin; i != end; ++i) total_probability += m_entries[i].threshold;
+            if (!(total_probability > TProbability{0})) {
+                m_entries.resize(begin);
+                return;
+            }
+
+            m_small.clear();
+            m_large.clear();
+            for (uint32_t i = 0; i != size; ++i) {
+                Entry& entry = m_entries[begin + i];
+                entry.threshold = entry.threshold * static_cast<TProbability>(size) / total_probability;
+                entry.alias = i;
+                (entry.threshold < TProbability{1} ? m_small : m_large).push_back(i);
+            }
+
+            // Pair each small column with a large one
+            while (!m_small.empty() && !m_large.empty()) {
+                uint32_t small = m_small.back(), large = m_large.back();
+                m_small.pop_back();
+
+                Entry& small_entry = m_entries[begin + small];
+                Entry& large_entry = m_entries[begin + large];
+                small_entry.alias = large;
+                large_entry.threshold -= TProbability{1} - small_entry.threshold;
+
+                if (large_entry.threshold < TProbability{1}) {
+                    m_large.pop_back();
+                    m_small.push_back(large);
+                }
+            }
+
+            // Remaining columns are full (up to rounding errors)
+            for (uint32_t i: m_small) m_entries[begin + i].threshold = TProbability{1};
+            for (uint32_t i: m_large) m_entries[begin + i].threshold = TProbability{1};
+        }
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_ALIAS_TABLE_H
@@ -0,0 +1,548 @@
+#ifndef REINFORCEMENT_LEARNING_COMPILED_MDP_H
+#define REINFORCEMENT_LEARNING_COMPILED_MDP_H
+
+#include <mdp/mdp.h>
+#include <mdp/actions.h>
+#include <mdp/snapshot.h>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <numeric>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace rl::mdp {
+    namespace detail {
+        /// Detects models with wall states (e.g. Gridworld)
+        template<class MDP, class = void>
+        struct has_wall_state : std::false_type {};
+
+        template<class MDP>
+        struct has_wall_state<MDP, std::void_t<decltype(std::declval<const MDP&>().is_wall_state(
+                std::declval<const typename MDP::State&>()))>> : std::true_type {};
+    } // namespace detail
+
+    /// Read-only MDP that stores the dynamics of another MDP in contiguous CSR arrays.
+    /// States are assigned dense indices in the order returned by get_states() and actions use
+    /// ActionTraits<TAction>::id, so the transitions of a State-Action pair are the range
+    /// [offsets[s * A + a], offsets[s * A + a + 1]) of the successor, reward and probability arrays.
+    /// The arrays are either owned or used in place from a memory mapped snapshot (see save and load).
+    /// \tparam TState
+    /// \tparam TAction
+    /// \tparam TReward
+    /// \tparam TProbability
+    template<class TState, class TAction, class TReward=double, class TProbability=double>
+    class CompiledMDP : public MDP<TState, TAction, TReward, TProbability> {
+    public:
+        using Base = MDP<TState, TAction, TReward, TProbability>;
+        using typename Base::State;
+        using typename Base::Action;
+        using typename Base::Reward;
+        using typename Base::Probability;
+        using typename Base::StateRewardProbability;
+
+        using Actions = ActionTraits<TAction>;
+        using StateIndex = size_t;
+
+        /// View over the transitions of a single State-Action pair
+        struct TransitionRange {
+            const StateIndex* successors;
+            const Reward* rewards;
+            const Probability* probabilities;
+            const Probability* cumulative;
+            size_t size;
+
+            [[nodiscard]] bool empty() const { return size == 0; }
+        };
+
+        /// Compiles the given MDP. Probabilities are normalised once so they sum 1.0 for every
+        /// available State-Action pair. Pairs whose probabilities do not add up to a positive value are left
+        /// without transitions, so they are not available. Models with walls (is_wall_state) also keep the wall
+        /// flags.
+        /// \param mdp
+        template<class Model, std::enable_if_t<std::is_base_of_v<Base, Model>, int> = 0>
+        explicit CompiledMDP(const Model& mdp) {
+            // Assign dense indices to states
+            m_owned.states = mdp.get_states();
+            const size_t total_states = m_owned.states.size();
+            m_owned.state_order.resize(total_states);
+            std::iota(m_owned.state_order.begin(), m_owned.state_order.end(), StateIndex{0});
+            std::sort(m_owned.state_order.begin(), m_owned.state_order.end(),
+                      [this](StateIndex a, StateIndex b) { return m_owned.states[a] < m_owned.states[b]; });
+            bind_owned();
+
+            const size_t total_actions = Actions::total_actions();
+            m_owned.offsets.reserve(total_states * total_actions + 1);
+            m_owned.offsets.push_back(0);
+            m_owned.flags.reserve(total_states);
+
+            // Flatten the transitions of every State-Action pair
+            std::vector<bool> available(total_actions);
+            for (const auto& state: m_owned.states) {
+                std::fill(available.begin(), available.end(), false);
+                for (const auto& action: mdp.get_actions(state)) {
+                    available[Actions::id(action)] = true;
+                }
+
+                for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                    if (available[action_id]) {
+                        auto srp_list = mdp.get_transitions(state, Actions::from_id(action_id));
+                        Probability total_probability = std::accumulate(
+                                srp_list.begin(), srp_list.end(), Probability{},
+                                [](const auto& value, const auto& srp) { return value + Base::srp_probability(srp); });
+                        if (!(total_probability > Probability{0})) srp_list.clear();
+
+                        Probability cumulative{};
+                        for (const auto& [s_i, r, p]: srp_list) {
+                            Probability normalised = p / total_probability;
+                            cumulative += normalised;
+
+                            m_owned.successors.push_back(state_index(s_i));
+                            m_owned.rewards.push_back(r);
+                            m_owned.probabilities.push_back(normalised);
+                            m_owned.cumulative.push_back(cumulative);
+                        }
+
+                        // Avoid rounding errors when sampling with the last cumulative value
+                        if (!srp_list.empty()) m_owned.cumulative.back() = Probability{1};
+                    }
+
+                    m_owned.offsets.push_back(m_owned.successors.size());
+                }
+
+                uint8_t flags = 0;
+                if (mdp.is_terminal_state(state)) flags |= SNAPSHOT_TERMINAL;
+                if (mdp.is_initial_state(state)) flags |= SNAPSHOT_INITIAL;
+                if constexpr (detail::has_wall_state<Model>::value) {
+                    if (mdp.is_wall_state(state)) flags |= SNAPSHOT_WALL;
+                }
+                m_owned.flags.push_back(flags);
+            }
+            bind_owned();
+        }
+
+        /// Compiled models point to their own arrays, so they can be moved but not copied
+        CompiledMDP(const CompiledMDP&) = delete;
+        CompiledMDP& operator=(const CompiledMDP&) = delete;
+        CompiledMDP(CompiledMDP&&) noexcept = default;
+        CompiledMDP& operator=(CompiledMDP&&) noexcept = default;
+
+        /// SNAPSHOTS ///
+
+        /// Writes the model as a binary snapshot, see SnapshotHeader for the format.
+        /// \param output Binary stream
+        void save(std::ostream& output) const {
+            check_snapshot_platform();
+
+            SnapshotHeader header{};
+            header.magic = SnapshotHeader::MAGIC;
+            header.version = SnapshotHeader::VERSION;
+            header.state_size = sizeof(State);
+            header.reward_size = sizeof(Reward);
+            header.probability_size = sizeof(Probability);
+            header.num_states = m_states.size();
+            header.num_actions = num_actions();
+            header.num_transitions = m_successors.size();
+
+            // Place arrays one after the other
+            uint64_t offset = sizeof(SnapshotHeader);
+            auto place = [&offset](uint64_t bytes) {
+                uint64_t start = detail::snapshot_align(offset);
+                offset = start + bytes;
+                return start;
+            };
+            header.states = place(m_states.size_bytes());
+            header.state_order = place(m_state_order.size_bytes());
+            header.flags = place(m_flags.size_bytes());
+            header.offsets = place(m_offsets.size_bytes());
+            header.successors = place(m_successors.size_bytes());
+            header.rewards = place(m_rewards.size_bytes());
+            header.probabilities = place(m_probabilities.size_bytes());
+            header.cumulative = place(m_cumulative.size_bytes());
+            header.file_size = offset;
+
+            uint64_t written = 0;
+            auto write = [&output, &written](uint64_t position, const void* data, uint64_t bytes) {
+                static const char padding[detail::SNAPSHOT_ALIGNMENT]{};
+                output.write(padding, static_cast<std::streamsize>(position - written));
+                output.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+                written = position + bytes;
+            };
+            write(0, &header, sizeof(SnapshotHeader));
+            write(header.states, m_states.data(), m_states.size_bytes());
+            write(header.state_order, m_state_order.data(), m_state_order.size_bytes());
+            write(header.flags, m_flags.data(), m_flags.size_bytes());
+            write(header.offsets, m_offsets.data(), m_offsets.size_bytes());
+            write(header.successors, m_successors.data(), m_successors.size_bytes());
+            write(header.rewards, m_rewards.data(), m_rewards.size_bytes());
+            write(header.probabilities, m_probabilities.data(), m_probabilities.size_bytes());
+            write(header.cumulative, m_cumulative.data(), m_cumulative.size_bytes());
+
+            if (!output) throw std::runtime_error("Cannot write snapshot");
+        }
+
+        /// Writes the model as a binary snapshot file
+        /// \param path
+        void save(const std::string& path) const {
+            std::ofstream output(path, std::ios::binary | std::ios::trunc);
+            if (!output) throw std::runtime_error("Cannot create snapshot: " + path);
+            save(output);
+        }
+
+        /// Loads a snapshot, mapping the file and using its arrays in place. Throws std::runtime_error if the file
+        /// is not a snapshot of this kind of model.
+        /// \param path
+        /// \return
+        static CompiledMDP load(const std::string& path) {
+            check_snapshot_platform();
+            return CompiledMDP(std::make_shared<const MappedFile>(path));
+        }
+
+        /// INDEXED ACCESS ///
+
+        /// Returns the total amount of states
+        /// \return
+        [[nodiscard]]
+        size_t num_states() const { return m_states.size(); }
+
+        /// Returns the total amount of actions
+        /// \return
+        [[nodiscard]]
+        static constexpr size_t num_actions() { return Actions::total_actions(); }
+
+        /// Returns the total amount of stored transitions
+        /// \return
+        [[nodiscard]]
+        size_t num_transitions() const { return m_successors.size(); }
+
+        /// Returns the dense index of a state. Throws std::out_of_range if the state is unknown.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        StateIndex state_index(const State& state) const {
+            auto iter = std::lower_bound(m_state_order.begin(), m_state_order.end(), state,
+                                         [this](StateIndex idx, const State& s) { return m_states[idx] < s; });
+            if (iter == m_state_order.end() || state < m_states[*iter])
+                throw std::out_of_range("State is not part of the compiled MDP");
+            return *iter;
+        }
+
+        /// Returns the state represented by the given index
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        const State& state_at(StateIndex idx) const { return m_states[idx]; }
+
+        /// Returns the transitions of the given State-Action pair
+        /// \param state
+        /// \param action_id
+        /// \return
+        [[nodiscard]]
+        TransitionRange transitions(StateIndex state, size_t action_id) const {
+            size_t row = state * num_actions() + action_id;
+            size_t begin = m_offsets[row], end = m_offsets[row + 1];
+            return {m_successors.data() + begin, m_rewards.data() + begin,
+                    m_probabilities.data() + begin, m_cumulative.data() + begin,
+                    end - begin};
+        }
+
+        /// Returns true if the action is available in the given state
+        /// \param state
+        /// \param action_id
+        /// \return
+        [[nodiscard]]
+        bool is_available(StateIndex state, size_t action_id) const {
+            size_t row = state * num_actions() + action_id;
+            return m_offsets[row] != m_offsets[row + 1];
+        }
+
+        /// Returns true if the state at the given index is terminal
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        bool is_terminal(StateIndex idx) const { return (m_flags[idx] & SNAPSHOT_TERMINAL) != 0; }
+
+        /// Returns true if the state at the given index is initial
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        bool is_initial(StateIndex idx) const { return (m_flags[idx] & SNAPSHOT_INITIAL) != 0; }
+
+        /// Returns true if the state at the given index was a wall in the original model
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        bool is_wall(StateIndex idx) const { return (m_flags[idx] & SNAPSHOT_WALL) != 0; }
+
+        /// Samples a transition using the cumulative probabilities of the State-Action pair.
+        /// \param state
+        /// \param action_id
+        /// \param target_probability Uniform value in [0, 1)
+        /// \return Position of the chosen transition inside the range, or range size if there are no transitions
+        [[nodiscard]]
+        size_t sample(StateIndex state, size_t action_id, Probability target_probability) const {
+            auto range = transitions(state, action_id);
+            auto iter = std::lower_bound(range.cumulative, range.cumulative + range.size, target_probability);
+            return static_cast<size_t>(iter - range.cumulative);
+        }
+
+        /// Samples the next state of a State-Action pair, used by MDPEnvironment to avoid building transition lists.
+        /// \param state
+        /// \param action
+        /// \param target_probability Uniform value in [0, 1)
+        /// \return Tuple with [next state, reward, is terminal]
+        [[nodiscard]]
+        std::tuple<State, Reward, bool> sample_transition(const State& state, const Action& action,
+                                                          Probability target_probability) const {
+            StateIndex idx = state_index(state);
+            size_t action_id = Actions::id(action);
+            auto range = transitions(idx, action_id);
+
+            size_t position = sample(idx, action_id, target_probability);
+            if (position == range.size) throw std::range_error("Transition probability does not sum 1.0");
+
+            StateIndex next = range.successors[position];
+            return {m_states[next], range.rewards[position], is_terminal(next)};
+        }
+
+        /// MDP ///
+
+        /// Returns the transitions from a State-Action pair
+        /// \param state
+        /// \param action
+        /// \return
+        [[nodiscard]]
+        std::vector<StateRewardProbability> get_transitions(const State& state, const Action& action) const override {
+            auto range = transitions(state_index(state), Actions::id(action));
+
+            std::vector<StateRewardProbability> srp_list;
+            srp_list.reserve(range.size);
+            for (size_t i = 0; i != range.size; ++i) {
+                srp_list.emplace_back(m_states[range.successors[i]], range.rewards[i], range.probabilities[i]);
+            }
+            return srp_list;
+        }
+
+        /// Calls visitor(next_state, reward, probability) for every transition of the State-Action pair,
+        /// without building a transitions list. Returning false from the visitor stops the visit.
+        /// \param state
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_transition(const State& state, const Action& action, Visitor&& visitor) const {
+            auto range = transitions(state_index(state), Actions::id(action));
+            for (size_t i = 0; i != range.size; ++i) {
+                if (!detail::visit_transition(visitor, m_states[range.successors[i]],
+                                              range.rewards[i], range.probabilities[i]))
+                    return;
+            }
+        }
+
+        /// Calls visitor(next_state_index, reward, probability) for every transition of the State-Action pair.
+        /// Returning false from the visitor stops the visit.
+        /// \param state_idx
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_indexed_transition(StateIndex state_idx, const Action& action, Visitor&& visitor) const {
+            auto range = transitions(state_idx, Actions::id(action));
+            for (size_t i = 0; i != range.size; ++i) {
+                if (!detail::visit_transition(visitor, range.successors[i], range.rewards[i], range.probabilities[i]))
+                    return;
+            }
+        }
+
+        /// Compiled MDPs are read-only, always throws std::logic_error
+        void add_transition(const State&, const Action&, const State&, const Reward&, const Probability&) override {
+            throw std::logic_error("Cannot add transitions to a compiled MDP");
+        }
+
+        /// Calculates the expected reward of a given State-Action pair
+        /// \param state
+        /// \param action
+        /// \return
+        Reward expected_reward(const State& state, const Action& action) const override {
+            auto range = transitions(state_index(state), Actions::id(action));
+
+            Reward expected_reward{};
+            for (size_t i = 0; i != range.size; ++i) {
+                expected_reward += range.rewards[i] * range.probabilities[i];
+            }
+            return expected_reward;
+        }
+
+        /// Probability of going to a given state from a state-action pair
+        /// \param from_state
+        /// \param action
+        /// \param to_state
+        /// \return
+        Probability state_transition_probability(const State& from_state,
+                                                 const Action& action,
+                                                 const State& to_state) const override {
+            auto range = transitions(state_index(from_state), Actions::id(action));
+            StateIndex target = state_index(to_state);
+
+            Probability probability{};
+            for (size_t i = 0; i != range.size; ++i) {
+                if (range.successors[i] == target) probability += range.probabilities[i];
+            }
+            return probability;
+        }
+
+        /// Returns a vector with all the states, ordered by index
+        /// \return
+        std::vector<State> get_states() const override { return {m_states.begin(), m_states.end()}; }
+
+        /// Compiled MDPs are read-only, always throws std::logic_error
+        void set_terminal_state(const State&, std::optional<Reward>) override {
+            throw std::logic_error("Cannot change terminal states of a compiled MDP");
+        }
+
+        /// Returns true if the given State is a terminal state.
+        /// \param s
+        /// \return
+        bool is_terminal_state(const State& s) const override { return is_terminal(state_index(s)); }
+
+        /// Returns a list of the terminal states.
+        /// \return
+        std::vector<State> get_terminal_states() const override { return filter_states(SNAPSHOT_TERMINAL); }
+
+        /// Sets the given state as an initial state. Snapshots keep a private copy of the flags once modified.
+        /// \param s
+        void set_initial_state(const State& s) override {
+            StateIndex idx = state_index(s);
+            if (m_owned.flags.size() != m_flags.size()) {
+                m_owned.flags.assign(m_flags.begin(), m_flags.end());
+                m_flags = {m_owned.flags.data(), m_owned.flags.size()};
+            }
+            m_owned.flags[idx] |= SNAPSHOT_INITIAL;
+        }
+
+        /// Returns if the given state is an initial state
+        /// \param s
+        /// \return
+        bool is_initial_state(const State& s) const override { return is_initial(state_index(s)); }
+
+        /// Returns a list with the initial states
+        /// \return
+        std::vector<State> get_initial_states() const override { return filter_states(SNAPSHOT_INITIAL); }
+
+        /// Returns a list with the available actions for a given state.
+        /// \param state
+        /// \return
+        std::vector<Action> get_actions(const State& state) const override {
+            StateIndex idx = state_index(state);
+
+            std::vector<Action> actions;
+            for (size_t action_id = 0; action_id != num_actions(); ++action_id) {
+                if (is_available(idx, action_id)) actions.push_back(Actions::from_id(action_id));
+            }
+            return actions;
+        }
+
+    private:
+        // Arrays built by the constructor, empty when the model uses a snapshot
+        struct OwnedArrays {
+            std::vector<State> states;
+            std::vector<StateIndex> state_order;
+            std::vector<uint8_t> flags;
+            std::vector<size_t> offsets;
+            std::vector<StateIndex> successors;
+            std::vector<Reward> rewards;
+            std::vector<Probability> probabilities, cumulative;
+        } m_owned;
+        std::shared_ptr<const MappedFile> m_snapshot;
+
+        // States, state ids sorted by state and flags
+        boost::span<const State> m_states;
+        boost::span<const StateIndex> m_state_order;
+        boost::span<const uint8_t> m_flags;
+
+        // CSR dynamics
+        boost::span<const size_t> m_offsets;
+        boost::span<const StateIndex> m_successors;
+        boost::span<const Reward> m_rewards;
+        boost::span<const Probability> m_probabilities, m_cumulative;
+
+        /// Uses the arrays of a mapped snapshot in place
+        /// \param snapshot
+        explicit CompiledMDP(std::shared_ptr<const MappedFile> snapshot): m_snapshot(std::move(snapshot)) {
+            const std::byte* data = m_snapshot->data();
+            if (m_snapshot->size() < sizeof(SnapshotHeader)) throw std::runtime_error("Snapshot is truncated");
+
+            SnapshotHeader header{};
+            std::memcpy(&header, data, sizeof(SnapshotHeader));
+            if (header.magic != SnapshotHeader::MAGIC) throw std::runtime_error("File is not an MDP snapshot");
+            if (header.version != SnapshotHeader::VERSION) throw std::runtime_error("Unsupported snapshot version");
+            if (header.state_size != sizeof(State) || header.reward_size != sizeof(Reward) ||
+                header.probability_size != sizeof(Probability) || header.num_actions != num_actions())
+                throw std::runtime_error("Snapshot was written for a different model type");
+            if (header.file_size != m_snapshot->size()) throw std::runtime_error("Snapshot is truncated");
+
+            // Every array must be aligned and inside the file before it is viewed
+            auto view = [data, &header](uint64_t offset, uint64_t size, auto* type) {
+                using T = std::remove_pointer_t<decltype(type)>;
+                if (offset % detail::SNAPSHOT_ALIGNMENT != 0 || offset > header.file_size ||
+                    size > (header.file_size - offset) / sizeof(T))
+                    throw std::runtime_error("Snapshot arrays are out of the file");
+                return boost::span<const T>(reinterpret_cast<const T*>(data + offset), size);
+            };
+            m_states = view(header.states, header.num_states, static_cast<State*>(nullptr));
+            m_state_order = view(header.state_order, header.num_states, static_cast<StateIndex*>(nullptr));
+            m_flags = view(header.flags, header.num_states, static_cast<uint8_t*>(nullptr));
+            m_offsets = view(header.offsets, header.num_states * header.num_actions + 1, static_cast<size_t*>(nullptr));
+            m_successors = view(header.successors, header.num_transitions, static_cast<StateIndex*>(nullptr));
+            m_rewards = view(header.rewards, header.num_transitions, static_cast<Reward*>(nullptr));
+            m_probabilities = view(header.probabilities, header.num_transitions, static_cast<Probability*>(nullptr));
+            m_cumulative = view(header.cumulative, header.num_transitions, static_cast<Probability*>(nullptr));
+
+            // Indices read by the lookups must stay inside the arrays
+            if (m_offsets.front() != 0 || m_offsets.back() != header.num_transitions ||
+                !std::is_sorted(m_offsets.begin(), m_offsets.end()))
+                throw std::runtime_error("Snapshot transition offsets are corrupted");
+            auto valid_state = [&header](StateIndex idx) { return idx < header.num_states; };
+            if (!std::all_of(m_successors.begin(), m_successors.end(), valid_state) ||
+                !std::all_of(m_state_order.begin(), m_state_order.end(), valid_state))
+                throw std::runtime_error("Snapshot state ids are corrupted");
+        }
+
+        /// Points the views to the owned arrays
+        void bind_owned() {
+            m_states = {m_owned.states.data(), m_owned.states.size()};
+            m_state_order = {m_owned.state_order.data(), m_owned.state_order.size()};
+            m_flags = {m_owned.flags.data(), m_owned.flags.size()};
+            m_offsets = {m_owned.offsets.data(), m_owned.offsets.size()};
+            m_successors = {m_owned.successors.data(), m_owned.successors.size()};
+            m_rewards = {m_owned.rewards.data(), m_owned.rewards.size()};
+            m_probabilities = {m_owned.probabilities.data(), m_owned.probabilities.size()};
+            m_cumulative = {m_owned.cumulative.data(), m_owned.cumulative.size()};
+        }
+
+        /// Snapshots store the arrays in place, so they need trivially copyable states, 64 bit ids and a
+        /// little-endian platform
+        static void check_snapshot_platform() {
+            static_assert(std::is_trivially_copyable_v<State>, "Snapshots require trivially copyable states");
+            static_assert(sizeof(StateIndex) == sizeof(uint64_t), "Snapshots require 64 bit state ids");
+            if (!detail::is_little_endian()) throw std::runtime_error("Snapshots require a little-endian platform");
+        }
+
+        /// Returns the states with the given flag
+        /// \param flag
+        /// \return
+        [[nodiscard]]
+        std::vector<State> filter_states(uint8_t flag) const {
+            std::vector<State> states;
+            for (StateIndex idx = 0; idx != m_states.size(); ++idx) {
+                if ((m_flags[idx] & flag) != 0) states.push_back(m_states[idx]);
+            }
+            return states;
+        }
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_COMPILED_MDP_H
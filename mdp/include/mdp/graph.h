@@ -3,30 +3,58 @@
 
 #include <mdp/mdp.h>
 #include <mdp/actions.h>
+#include <mdp/states.h>
+#include <mdp/parallel.h>
 
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/graphviz.hpp>
-#include <map>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <cstdint>
 #include <iterator>
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <functional>
 #include <ostream>
 
 namespace rl::mdp {
-    /// Class for representing an MDP that uses a graph as underlying type
+    namespace detail {
+        /// Detects containers with reserve(size_t)
+        template<class Container, class = void>
+        struct has_reserve : std::false_type {};
+
+        template<class Container>
+        struct has_reserve<Container, std::void_t<decltype(std::declval<Container&>().reserve(size_t{}))>>
+                : std::true_type {};
+    } // namespace detail
+
+    /// Class for representing an MDP that uses a graph as underlying type. Besides the graph, the out-edges of
+    /// every vertex are kept sorted by ActionTraits<Action>::id with per-action offsets, normalised probabilities
+    /// and an available-action mask, so transitions and actions are direct range lookups.
     /// \tparam TState
     /// \tparam TAction
-    template<class TState, class TAction>
-    class GraphMDP : public MDP<TState, TAction> {
+    /// \tparam TReward
+    /// \tparam TProbability
+    /// \tparam TStateMap Container from State to vertex id, with find/end/try_emplace. Defaults to a hashed map
+    /// using std::hash<State>; pass HashedStateMap<State, size_t, Hasher> for a custom hasher or
+    /// std::map<State, size_t> for ordered lookups.
+    template<class TState, class TAction, class TReward = double, class TProbability = double,
+             class TStateMap = HashedStateMap<TState, size_t>>
+    class GraphMDP : public MDP<TState, TAction, TReward, TProbability> {
     public:
-        using typename MDP<TState, TAction>::State;
-        using typename MDP<TState, TAction>::Action;
-        using typename MDP<TState, TAction>::Reward;
-        using typename MDP<TState, TAction>::Probability;
+        using Base = MDP<TState, TAction, TReward, TProbability>;
+        using typename Base::State;
+        using typename Base::Action;
+        using typename Base::Reward;
+        using typename Base::Probability;
 
-        using typename MDP<TState, TAction>::StateAction;
-        using typename MDP<TState, TAction>::StateRewardProbability;
+        using typename Base::StateAction;
+        using typename Base::StateRewardProbability;
+
+        /// Transition record accepted by add_transitions: [state, action, next state, reward, weight]
+        using Transition = std::tuple<State, Action, State, Reward, Probability>;
 
         /// Constructor accepting list of available actions
         GraphMDP() = default;
@@ -37,33 +65,25 @@ namespace rl::mdp {
         /// \return
         [[nodiscard]]
         std::vector<StateRewardProbability> get_transitions(const State &state, const Action &action) const override {
-            GraphVertex v = m_state_to_vertex.at(state);
-            auto [iter, end] = boost::out_edges(v, m_dynamics);
-
-            // Return the transitions that match the given action
             std::vector<StateRewardProbability> ret;
-            Probability total_probability{0.0};
-            while (iter != end) {
-                if (m_dynamics[*iter].action == action) {
-                    GraphVertex target = boost::target(*iter, m_dynamics);
-                    total_probability += m_dynamics[*iter].probability;
-
-                    ret.push_back(StateRewardProbability{
-                            m_dynamics[target].state,
-                            m_dynamics[*iter].reward,
-                            m_dynamics[*iter].probability
-                    });
-                }
-                iter = std::next(iter);
-            }
-
-            // Normalize probabilities
-            std::transform(ret.begin(), ret.end(), ret.begin(), [total_probability](const auto &srp) {
-                auto [s, r, p] = srp;
-                return StateRewardProbability{s, r, p / total_probability};
+            for_each_transition(state, action, [&ret](const State &s_i, const Reward &r, const Probability &p) {
+                ret.emplace_back(s_i, r, p);
             });
 
-            return std::move(ret);
+            return ret;
+        }
+
+        /// Calls visitor(next_state, reward, probability) for every transition of the State-Action pair,
+        /// without building a transitions list. Returning false from the visitor stops the visit.
+        /// \param state
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_transition(const State &state, const Action &action, Visitor &&visitor) const {
+            visit_out_edges(vertex(state), action,
+                            [this, &visitor](GraphVertex target, const Reward &r, const Probability &p) {
+                                return detail::visit_transition(visitor, m_dynamics[target].state, r, p);
+                            });
         }
 
         /// Adds a transition with the given probability
@@ -86,6 +106,116 @@ namespace rl::mdp {
 
             // Create the new transition
             boost::add_edge(A, B, {action, reward, weight}, m_dynamics);
+            insert_action_edge(A, action, B, reward, weight);
+            this->mark_modified();
+        }
+
+        /// Adds a batch of transitions. The result is the same as calling add_transition for each one in order
+        /// (same vertex ids and probabilities), but storage is reserved up-front, the state dictionary is built
+        /// per block of transitions in parallel (when built with TBB) and every action bucket is normalised once.
+        /// Nothing is added if a transition leaves a terminal state.
+        /// \tparam Range Random access range of tuple-like [state, action, next state, reward, weight], e.g. Transition
+        /// \param transitions
+        template<class Range>
+        void add_transitions(const Range &transitions) {
+            auto first = std::begin(transitions);
+            static_assert(std::is_base_of_v<std::random_access_iterator_tag,
+                                  typename std::iterator_traits<decltype(first)>::iterator_category>,
+                          "add_transitions requires a random access range");
+
+            const auto total = static_cast<size_t>(std::distance(first, std::end(transitions)));
+            if (total == 0) return;
+
+            // Find the states that are not in the graph yet, per block of transitions
+            const size_t total_blocks = (total + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE;
+            std::vector<std::vector<State>> new_states(total_blocks);
+            std::vector<uint8_t> from_terminal(total_blocks, 0);
+            detail::parallel_for(0, total_blocks, 1, [&](size_t block_begin, size_t block_end) {
+                for (size_t block = block_begin; block != block_end; ++block) {
+                    TStateMap seen;
+                    auto add_new_state = [&](const State &s) {
+                        if (m_state_to_vertex.find(s) != m_state_to_vertex.end()) return;
+                        if (seen.try_emplace(s, 0).second) new_states[block].push_back(s);
+                    };
+
+                    const size_t end = std::min(total, (block + 1) * BATCH_BLOCK_SIZE);
+                    for (size_t i = block * BATCH_BLOCK_SIZE; i != end; ++i) {
+                        const auto &[state, action, new_state, reward, weight] = first[i];
+                        if (has_flag(state, TERMINAL_VERTEX)) from_terminal[block] = 1;
+                        add_new_state(state);
+                        add_new_state(new_state);
+                    }
+                }
+            });
+
+            // Cannot add transition to terminal states
+            if (std::find(from_terminal.begin(), from_terminal.end(), 1) != from_terminal.end()) {
+                throw std::invalid_argument("Adding transition to terminal state");
+            }
+
+            // Merge the new states in block order, which gives the same vertex ids as inserting one by one
+            size_t total_new_states = 0;
+            for (const auto &block_states: new_states) total_new_states += block_states.size();
+            reserve(num_states() + total_new_states);
+            for (const auto &block_states: new_states) {
+                for (const auto &s: block_states) get_or_create_vertex(s);
+            }
+            new_states.clear();
+
+            // Resolve the vertices of every transition
+            std::vector<std::pair<GraphVertex, GraphVertex>> endpoints(total);
+            detail::parallel_for(0, total, BATCH_BLOCK_SIZE, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i != end; ++i) {
+                    const auto &[state, action, new_state, reward, weight] = first[i];
+                    endpoints[i] = {vertex(state), vertex(new_state)};
+                }
+            });
+
+            // Count the new edges of every (vertex, action) bucket
+            constexpr size_t total_actions = ActionTraits<Action>::total_actions();
+            std::vector<uint32_t> bucket_cursors(num_states() * total_actions, 0);
+            for (size_t i = 0; i != total; ++i) {
+                size_t action_id = ActionTraits<Action>::id(std::get<1>(first[i]));
+                ++bucket_cursors[endpoints[i].first * total_actions + action_id];
+            }
+
+            // Make room for the new edges at the end of every bucket, turning counts into insert positions
+            std::vector<uint64_t> grown_buckets(num_states(), 0);
+            detail::parallel_for(0, num_states(), BATCH_BLOCK_SIZE, [&](size_t begin, size_t end) {
+                for (size_t v = begin; v != end; ++v) {
+                    grown_buckets[v] = grow_action_buckets(m_action_edges[v], &bucket_cursors[v * total_actions]);
+                }
+            });
+
+            // Fill the buckets in input order, also adding the edges to the graph
+            for (size_t i = 0; i != total; ++i) {
+                const auto &[state, action, new_state, reward, weight] = first[i];
+                auto [A, B] = endpoints[i];
+                size_t action_id = ActionTraits<Action>::id(action);
+
+                boost::add_edge(A, B, {action, reward, weight}, m_dynamics);
+                m_action_edges[A].edges[bucket_cursors[A * total_actions + action_id]++] =
+                        ActionEdge{B, reward, weight, Probability{}};
+            }
+
+            // Normalise the buckets that received edges
+            detail::parallel_for(0, num_states(), BATCH_BLOCK_SIZE, [&](size_t begin, size_t end) {
+                for (size_t v = begin; v != end; ++v) {
+                    for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                        if ((grown_buckets[v] >> action_id) & 1U) normalise_action_bucket(m_action_edges[v], action_id);
+                    }
+                }
+            });
+
+            this->mark_modified();
+        }
+
+        /// Reserves space for the given total amount of states
+        /// \param total_states
+        void reserve(size_t total_states) {
+            if constexpr (detail::has_reserve<TStateMap>::value) m_state_to_vertex.reserve(total_states);
+            m_action_edges.reserve(total_states);
+            m_vertex_flags.reserve(total_states);
         }
 
         /// Calculates the expected reward of a given State-Action pair
@@ -119,18 +249,51 @@ namespace rl::mdp {
             return prob;
         }
 
-        /// Returns a vector with all the possible states that the MDP can contain.
+        /// Returns a vector with all the possible states that the MDP can contain, ordered by vertex.
         /// \return
         std::vector<State> get_states() const override {
             std::vector<State> states;
-            std::transform(m_state_to_vertex.cbegin(), m_state_to_vertex.cend(), std::back_inserter(states),
-                           [](const auto &iter) {
-                               return iter.first;
+            states.reserve(boost::num_vertices(m_dynamics));
+            auto [iter, end] = boost::vertices(m_dynamics);
+            std::transform(iter, end, std::back_inserter(states),
+                           [this](const GraphVertex &v) {
+                               return m_dynamics[v].state;
                            });
 
             return states;
         }
 
+        /// STATE INDEXING ///
+
+        /// Returns the total amount of states
+        /// \return
+        [[nodiscard]]
+        size_t num_states() const { return boost::num_vertices(m_dynamics); }
+
+        /// Returns the dense id of a state, which is its vertex descriptor
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        size_t state_index(const State &state) const { return vertex(state); }
+
+        /// Returns the state with the given dense id
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        const State &state_at(size_t idx) const { return m_dynamics[static_cast<GraphVertex>(idx)].state; }
+
+        /// Same as for_each_transition, using dense state ids: visitor(next_state_id, reward, probability)
+        /// \param state_idx
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_indexed_transition(size_t state_idx, const Action &action, Visitor &&visitor) const {
+            visit_out_edges(static_cast<GraphVertex>(state_idx), action,
+                            [&visitor](GraphVertex target, const Reward &r, const Probability &p) {
+                                return detail::visit_transition(visitor, static_cast<size_t>(target), r, p);
+                            });
+        }
+
         /// Marks a state as a terminal state. This makes all transitions out of this state to point to it again
         /// with the given reward.
         /// \param s
@@ -139,8 +302,9 @@ namespace rl::mdp {
             if (is_terminal_state(s)) return;
 
             // Remove all outgoing transitions and set only transitions to itself
-            auto v = m_state_to_vertex.at(s);
+            auto v = vertex(s);
             boost::clear_out_edges(v, m_dynamics);
+            m_action_edges[v] = VertexActionEdges{};
             for (const auto &a: ActionTraits<Action>::available_actions()) {
                 add_transition(s, a, s, 0.0, 1.0);
             }
@@ -156,64 +320,91 @@ namespace rl::mdp {
                     // Check that the changes do not affect self transitions
                     if(source != target) {
                         m_dynamics[edge].reward = default_reward.value();
+
+                        // Same change in the action buckets of the source
+                        auto& source_edges = m_action_edges[source];
+                        size_t action_id = ActionTraits<Action>::id(m_dynamics[edge].action);
+                        for(auto i = source_edges.offsets[action_id]; i != source_edges.offsets[action_id + 1]; ++i){
+                            if(source_edges.edges[i].target == target) source_edges.edges[i].reward = default_reward.value();
+                        }
                     }
 
                     ++iter;
                 }
             }
 
-            // Add to list of terminal states
-            m_terminal_states.insert(s);
+            // Flag as terminal state
+            m_vertex_flags[v] |= TERMINAL_VERTEX;
+            this->mark_modified();
         }
 
         /// Returns true if the given State is a terminal state.
         /// \param s
         /// \return
         bool is_terminal_state(const State &s) const override {
-            return m_terminal_states.find(s) != m_terminal_states.end();
+            return has_flag(s, TERMINAL_VERTEX);
         }
 
-        /// Returns a list of the terminal states.
+        /// Returns a list of the terminal states, ordered by vertex.
         /// \return
         std::vector<State> get_terminal_states() const override {
-            return {m_terminal_states.begin(), m_terminal_states.end()};
+            return states_with_flag(TERMINAL_VERTEX);
         }
 
-        /// Sets the given state as an initial state
+        /// Sets the given state as an initial state, adding it to the graph if it is not there yet
         /// \param s
         void set_initial_state(const State& s) override{
-            m_initial_states.insert(s);
+            const size_t total_states = num_states();
+            m_vertex_flags[get_or_create_vertex(s)] |= INITIAL_VERTEX;
+
+            // A new state invalidates the tables sized by the state count
+            if (num_states() != total_states) this->mark_modified();
         }
 
         /// Returns if the given state is an initial state
         /// \param s
         /// \return
         bool is_initial_state(const State& s) const override{
-            return m_initial_states.find(s) != m_initial_states.cend();
+            return has_flag(s, INITIAL_VERTEX);
         }
 
-        /// Returns a list with the initial states
+        /// Returns a list with the initial states, ordered by vertex.
         /// \return
         std::vector<State> get_initial_states() const override{
-            return {m_initial_states.begin(), m_initial_states.end()};
+            return states_with_flag(INITIAL_VERTEX);
         }
 
+        /// Returns true if the state with the given dense id is a terminal state
+        /// \param state_idx
+        /// \return
+        [[nodiscard]]
+        bool is_terminal(size_t state_idx) const { return m_vertex_flags[state_idx] & TERMINAL_VERTEX; }
+
+        /// Returns true if the state with the given dense id is an initial state
+        /// \param state_idx
+        /// \return
+        [[nodiscard]]
+        bool is_initial(size_t state_idx) const { return m_vertex_flags[state_idx] & INITIAL_VERTEX; }
+
         /// Returns a list with the available actions for a given state.
         /// \param state
         /// \return
         std::vector<Action> get_actions(const State &state) const override {
-            // Get vertex
-            GraphVertex v = m_state_to_vertex.at(state);
-            std::set<Action> available_actions; // Use a set to avoid duplicates
-            auto [iter, end] = boost::out_edges(v, m_dynamics);
-            std::transform(iter, end, std::inserter(available_actions, available_actions.begin()),
-                           [this](const GraphEdge &e) {
-                               return m_dynamics[e].action;
-                           });
+            uint64_t mask = action_mask(vertex(state));
 
-            return {available_actions.begin(), available_actions.end()};
+            std::vector<Action> available_actions;
+            for (size_t action_id = 0; action_id != ActionTraits<Action>::total_actions(); ++action_id) {
+                if ((mask >> action_id) & 1U) available_actions.push_back(ActionTraits<Action>::from_id(action_id));
+            }
+            return available_actions;
         }
 
+        /// Returns a mask with bit ActionTraits<Action>::id(action) set for every available action of a state
+        /// \param state_idx
+        /// \return
+        [[nodiscard]]
+        uint64_t action_mask(size_t state_idx) const { return m_action_edges[state_idx].mask; }
+
         /// Writes GraphViz output to the given stream
         /// \param os
         void write_graphviz(std::ostream &os) const {
@@ -248,29 +439,157 @@ namespace rl::mdp {
         using GraphVertex = typename Graph::vertex_descriptor;
         using GraphEdge = typename Graph::edge_descriptor;
 
+        // Out-edges of a vertex sorted by action id, with normalised probabilities
+        struct ActionEdge {
+            GraphVertex target;
+            Reward reward;
+            Probability weight, probability;
+        };
+
+        struct VertexActionEdges {
+            std::array<uint32_t, ActionTraits<Action>::total_actions() + 1> offsets{};
+            std::vector<ActionEdge> edges;
+            uint64_t mask{0};
+        };
+
+        static_assert(ActionTraits<Action>::total_actions() <= 64, "Action masks are limited to 64 actions");
+
+        // Transitions per block when building the state dictionary of a batch
+        static constexpr size_t BATCH_BLOCK_SIZE = 1 << 14;
+        static_assert(std::is_convertible_v<typename TStateMap::mapped_type, GraphVertex>,
+                      "The state map must map states to vertex ids");
+
+        // Per-vertex flags
+        enum VertexFlags : uint8_t {
+            TERMINAL_VERTEX = 1,
+            INITIAL_VERTEX = 2
+        };
+
         // Internal data
         Graph m_dynamics;
-        std::map<State, GraphVertex> m_state_to_vertex;
-
-        // Terminal and initial states
-        std::set<State> m_terminal_states;
-        std::set<State> m_initial_states;
+        TStateMap m_state_to_vertex;
+        std::vector<VertexActionEdges> m_action_edges;
+        std::vector<uint8_t> m_vertex_flags;
 
     private:
+        /// Calls visitor(target_vertex, reward, normalized_probability) for the out-edges of a vertex
+        /// that match the given action, stopping when the visitor returns false.
+        /// \param v
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void visit_out_edges(GraphVertex v, const Action &action, Visitor &&visitor) const {
+            const auto& vertex_edges = m_action_edges[v];
+            size_t action_id = ActionTraits<Action>::id(action);
+            for (auto i = vertex_edges.offsets[action_id]; i != vertex_edges.offsets[action_id + 1]; ++i) {
+                const ActionEdge& edge = vertex_edges.edges[i];
+                if (!visitor(edge.target, edge.reward, edge.probability)) return;
+            }
+        }
+
+        /// Inserts an edge at the end of its action bucket and normalises the bucket again
+        /// \param source
+        /// \param action
+        /// \param target
+        /// \param reward
+        /// \param weight
+        void insert_action_edge(GraphVertex source, const Action& action, GraphVertex target,
+                                const Reward& reward, const Probability& weight) {
+            auto& vertex_edges = m_action_edges[source];
+            size_t action_id = ActionTraits<Action>::id(action);
+
+            auto end = vertex_edges.offsets[action_id + 1];
+            vertex_edges.edges.insert(vertex_edges.edges.begin() + end, ActionEdge{target, reward, weight, Probability{}});
+            for (size_t i = action_id + 1; i != vertex_edges.offsets.size(); ++i) ++vertex_edges.offsets[i];
+            vertex_edges.mask |= uint64_t{1} << action_id;
+            normalise_action_bucket(vertex_edges, action_id);
+        }
+
+        /// Makes room for new edges at the end of the action buckets of a vertex
+        /// \param vertex_edges
+        /// \param counts Amount of new edges per action id, replaced by the position where they must be written
+        /// \return Mask of the actions that received room for new edges
+        static uint64_t grow_action_buckets(VertexActionEdges &vertex_edges, uint32_t *counts) {
+            constexpr size_t total_actions = ActionTraits<Action>::total_actions();
+            uint64_t grown = 0;
+            uint32_t total_new = 0;
+            for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                if (counts[action_id] != 0) grown |= uint64_t{1} << action_id;
+                total_new += counts[action_id];
+            }
+            if (grown == 0) return 0;
+
+            // Move the buckets to their new positions, starting from the last one
+            auto &edges = vertex_edges.edges;
+            auto &offsets = vertex_edges.offsets;
+            edges.resize(edges.size() + total_new);
+            uint32_t shift = total_new;
+            for (size_t action_id = total_actions; action_id-- != 0;) {
+                shift -= counts[action_id];
+                uint32_t begin = offsets[action_id], end = offsets[action_id + 1];
+                std::move_backward(edges.begin() + begin, edges.begin() + end, edges.begin() + end + shift);
+
+                offsets[action_id + 1] = end + shift + counts[action_id];
+                counts[action_id] = end + shift;
+            }
+            vertex_edges.mask |= grown;
+            return grown;
+        }
+
+        /// Computes the normalised probabilities of an action bucket from the edge weights
+        /// \param vertex_edges
+        /// \param action_id
+        static void normalise_action_bucket(VertexActionEdges &vertex_edges, size_t action_id) {
+            auto begin = vertex_edges.offsets[action_id], end = vertex_edges.offsets[action_id + 1];
+            Probability total_probability{};
+            for (auto i = begin; i != end; ++i) total_probability += vertex_edges.edges[i].weight;
+            for (auto i = begin; i != end; ++i) {
+                vertex_edges.edges[i].probability = vertex_edges.edges[i].weight / total_probability;
+            }
+        }
+
+        /// Returns the vertex of a state, throws std::out_of_range if the state is not in the graph
+        /// \param s
+        /// \return
+        GraphVertex vertex(const State &s) const {
+            auto iter = m_state_to_vertex.find(s);
+            if (iter == m_state_to_vertex.end()) throw std::out_of_range("State not found in graph");
+            return iter->second;
+        }
+
         /// Gets or creates a new vertex in the graph, maintaining the state-vertex map
         /// \param s
         /// \return
         GraphVertex get_or_create_vertex(const State &s) {
-            auto iter = m_state_to_vertex.find(s);
-            if (iter == m_state_to_vertex.end()) {
+            auto [iter, inserted] = m_state_to_vertex.try_emplace(s, boost::num_vertices(m_dynamics));
+            if (inserted) {
                 // Create a new one
                 GraphVertex v = boost::add_vertex(m_dynamics);
                 m_dynamics[v].state = s;
-                m_state_to_vertex[s] = v;
-                return v;
-            } else {
-                return iter->second;
+                m_action_edges.emplace_back();
+                m_vertex_flags.push_back(0);
             }
+            return iter->second;
+        }
+
+        /// Returns true if the state is in the graph and has the given flag
+        /// \param s
+        /// \param flag
+        /// \return
+        bool has_flag(const State &s, VertexFlags flag) const {
+            auto iter = m_state_to_vertex.find(s);
+            return iter != m_state_to_vertex.end() && (m_vertex_flags[iter->second] & flag);
+        }
+
+        /// Returns the states with the given flag, ordered by vertex
+        /// \param flag
+        /// \return
+        std::vector<State> states_with_flag(VertexFlags flag) const {
+            std::vector<State> states;
+            for (size_t v = 0; v != m_vertex_flags.size(); ++v) {
+                if (m_vertex_flags[v] & flag) states.push_back(m_dynamics[v].state);
+            }
+            return states;
         }
 
     };
@@ -1,47 +1,58 @@
 #ifndef REINFORCEMENT_LEARNING_GRAPH_POLICY_H
 #define REINFORCEMENT_LEARNING_GRAPH_POLICY_H
 
+#include <mdp/graph.h>
+#include <mdp/compiled_mdp.h>
+#include <mdp/linear_solver.h>
+#include <mdp/sweep.h>
+
 namespace rl::mdp {
 
     /// Class to represent an stochastic policy for an MDP
     /// \tparam TState
     /// \tparam TAction
-    template<class TState, class TAction>
-    class GraphMDP_Greedy : rl::mdp::MDPPolicy<TState, TAction> {
+    /// \tparam TReward
+    /// \tparam TProbability
+    template<class TState, class TAction, class TReward = double, class TProbability = double>
+    class GraphMDP_Greedy : rl::mdp::MDPPolicy<TState, TAction, TReward, TProbability> {
     public:
         // Class definitions
-        using typename rl::mdp::MDPPolicy<TState, TAction>::State;
-        using typename rl::mdp::MDPPolicy<TState, TAction>::Action;
-        using typename rl::mdp::MDPPolicy<TState, TAction>::Reward;
-        using typename rl::mdp::MDPPolicy<TState, TAction>::Probability;
-        using typename rl::mdp::MDPPolicy<TState, TAction>::ActionProbability;
+        using Base = rl::mdp::MDPPolicy<TState, TAction, TReward, TProbability>;
+        using typename Base::State;
+        using typename Base::Action;
+        using typename Base::Reward;
+        using typename Base::Probability;
+        using typename Base::ActionProbability;
 
-        using PGraphMDP = std::shared_ptr<rl::mdp::GraphMDP<TState, TAction>>;
+        using PGraphMDP = std::shared_ptr<rl::mdp::GraphMDP<TState, TAction, TReward, TProbability>>;
+        using CompiledGraphMDP = rl::mdp::CompiledMDP<TState, TAction, TReward, TProbability>;
+        using PCompiledGraphMDP = std::shared_ptr<const CompiledGraphMDP>;
 
         /// Default constructor with pointer to graph
         /// \param graph_mdp
         /// \param gamma
-        GraphMDP_Greedy(PGraphMDP graph_mdp, double gamma) : m_graph_mdp(graph_mdp), m_gamma(gamma) {
-            // Add one for each element in the list
-            for (const auto &state: graph_mdp->get_states()) {
-                // Create action probabilities only for non terminal states
+        GraphMDP_Greedy(PGraphMDP graph_mdp, double gamma) : m_gamma(gamma), m_graph_mdp(graph_mdp) {
+            // Tables are indexed by the graph state ids
+            size_t total_states = graph_mdp->num_states();
+            m_value_function.resize(total_states, Reward{});
+            m_next_values.resize(total_states, Reward{});
+            m_action_offsets.reserve(total_states + 1);
+            m_action_offsets.push_back(0);
+
+            for (size_t idx = 0; idx != total_states; ++idx) {
+                const State &state = graph_mdp->state_at(idx);
 
+                // Create action probabilities only for non terminal states
                 if (!graph_mdp->is_terminal_state(state)) {
                     // Calculate initial probability
                     auto available_actions = graph_mdp->get_actions(state);
                     Probability probability = 1.0 / static_cast<Probability>(available_actions.size());
-                    std::vector<ActionProbability> ap_vector;
-                    std::transform(available_actions.begin(), available_actions.end(),
-                                   std::back_inserter(ap_vector),
-                                   [probability](const auto &a) {
-                                       return ActionProbability{a, probability};
-                                   });
-
-                    m_state_action_map[state] = std::move(ap_vector);
+                    for (const auto &action: available_actions) {
+                        m_actions.push_back(action);
+                        m_action_probabilities.push_back(probability);
+                    }
                 }
-
-                // Value function for all states
-                m_value_function[state] = Reward{};
+                m_action_offsets.push_back(m_actions.size());
             }
         }
 
@@ -49,52 +60,55 @@ namespace rl::mdp {
         /// \param state
         /// \return
         std::vector<ActionProbability> get_action_probabilities(const State &state) const override {
-            return m_state_action_map.at(state);
+            size_t idx = m_graph_mdp->state_index(state);
+            size_t begin = m_action_offsets.at(idx), end = m_action_offsets.at(idx + 1);
+            if (begin == end) throw std::out_of_range("Terminal states have no action probabilities");
+
+            std::vector<ActionProbability> action_prob_list;
+            action_prob_list.reserve(end - begin);
+            for (size_t i = begin; i != end; ++i) action_prob_list.emplace_back(m_actions[i], m_action_probabilities[i]);
+            return action_prob_list;
         }
 
         /// Returns the value function result given a state.
         /// \param state
         /// \return
         Reward value_function(const State &state) const override {
-            return m_value_function.at(state);
+            return m_value_function.at(m_graph_mdp->state_index(state));
         }
 
+        /// Returns the amount of states visited by every sweep of policy_evaluation and update_policy
+        /// \return
+        [[nodiscard]]
+        size_t num_states() const { return m_value_function.size(); }
+
         /// Approximates the value function doing a single policy evaluation.
         /// \param epsilon
         /// \return
         double policy_evaluation() override {
-            // Copy value function
-            auto value_function_copy(m_value_function);
+            if (m_evaluation_mode == EvaluationMode::GAUSS_SEIDEL) return gauss_seidel_sweep();
+
+            // The new values are written to the second buffer, which becomes the value function
             Reward delta{};
 
             // Iterate through states
-            for (auto v_iter = value_function_copy.begin(); v_iter != value_function_copy.end(); ++v_iter) {
-                auto [state, value] = *v_iter;
-
-                // Do not iterate for terminal states
-                if (m_graph_mdp->is_terminal_state(state)) continue;
+            for (size_t idx = 0; idx != m_value_function.size(); ++idx) {
+                // Terminal states keep their value
+                if (is_terminal(idx)) {
+                    m_next_values[idx] = m_value_function[idx];
+                    continue;
+                }
 
                 // Calculate new state value
-                Reward new_value{};
-                for (const auto &[action, probability]: m_state_action_map.at(state)) {
-                    auto transitions = m_graph_mdp->get_transitions(state, action);
-                    Reward action_value = std::transform_reduce(transitions.begin(), transitions.end(),
-                                                                Reward{}, std::plus<>(),
-                                                                [this](const auto &srp) {
-                                                                    auto [s_i, r, p] = srp;
-                                                                    return p * (r + m_gamma * m_value_function.at(s_i));
-                                                                });
-
-                    new_value += probability * action_value;
-                }
+                Reward new_value = state_value(idx);
 
                 // Store and check change
-                v_iter->second = new_value;
-                delta = std::max(delta, std::abs(new_value - m_value_function.at(state)));
+                m_next_values[idx] = new_value;
+                delta = std::max(delta, std::abs(new_value - m_value_function[idx]));
             }
 
             // Update the new value function
-            m_value_function = std::move(value_function_copy);
+            m_value_function.swap(m_next_values);
 
             return delta;
         }
@@ -102,68 +116,252 @@ namespace rl::mdp {
         /// Makes the policy greedy according to the value function
         /// \return
         bool update_policy() override {
-            // Store if policy has changed
-            bool policy_changed = false;
+            // The incremental improvements start again from every state
+            m_dirty_states.reset();
+            return improve_all_states() != 0;
+        }
+
+        /// Makes the policy greedy only in the states whose action values may have changed since the last call:
+        /// the states whose value changed more than tolerance, and their predecessors. The first call, and the
+        /// first one after update_policy or a change of the model, improves every state.
+        /// \param tolerance Smaller changes of a value are ignored until they add up to more than tolerance
+        /// \return Amount of states whose policy changed
+        size_t update_policy_incremental(double tolerance = 0.0) {
+            size_t revision = m_compiled ? m_compiled->revision() : m_graph_mdp->revision();
+            if (!m_dirty_states.is_tracking(revision)) {
+                size_t changed_states = improve_all_states();
+                if (m_compiled) {
+                    m_dirty_states.track(*m_compiled, revision, m_value_function);
+                } else {
+                    m_dirty_states.track(*m_graph_mdp, revision, m_value_function);
+                }
+                return changed_states;
+            }
 
-            // Greedify the policy
-            for (auto &[state, action_prob_list]: m_state_action_map) {
-                std::set<Action> max_actions;
-                Reward max_value = -std::numeric_limits<Reward>::infinity();
+            size_t changed_states = 0;
+            for (size_t idx: m_dirty_states.collect(m_value_function, tolerance)) {
+                if (improve_state(idx)) ++changed_states;
+            }
+            return changed_states;
+        }
 
-                // Calculate new state value
-                for (const auto &[action, probability]: action_prob_list) {
-                    auto transitions = m_graph_mdp->get_transitions(state, action);
-                    Reward action_value = std::transform_reduce(
-                            transitions.begin(), transitions.end(),
-                            Reward{}, std::plus<>(),
-                            [this](const auto &srp) {
-                                auto [s_i, r, p] = srp;
-                                auto ret = p * (r + m_gamma * m_value_function.at(s_i));
-                                return ret;
-//                                return p * (r + m_gamma * m_value_function.at(s_i));
-                            });
-
-                    // Check if it is the best action
-                    if (action_value > max_value) {
-                        max_actions.clear();
-                        max_actions.insert(action);
-                        max_value = action_value;
-                    } else if (action_value == max_value) {
-                        max_actions.insert(action);
+        /// Freezes the current graph dynamics into a CompiledMDP used by the following sweeps.
+        /// It must be called again after the graph is modified.
+        void compile_model() {
+            set_compiled_model(std::make_shared<const CompiledGraphMDP>(*m_graph_mdp));
+        }
+
+        /// Sets the compiled model used by the sweeps, nullptr reverts to querying the graph.
+        /// \param compiled Model compiled from a graph with the same states
+        void set_compiled_model(PCompiledGraphMDP compiled) {
+            if (compiled) {
+                // Compiled indices must match the graph state ids
+                if (compiled->num_states() != m_value_function.size())
+                    throw std::invalid_argument("Compiled model does not match the graph states");
+
+                for (size_t idx = 0; idx != compiled->num_states(); ++idx) {
+                    if (compiled->state_at(idx) != m_graph_mdp->state_at(idx))
+                        throw std::invalid_argument("Compiled model states are not ordered as the graph states");
+                }
+            }
+
+            m_compiled = std::move(compiled);
+            m_sweep_revision.reset();
+            m_dirty_states.reset();
+        }
+
+        /// Selects how policy_evaluation updates the value function. GAUSS_SEIDEL updates it in place without
+        /// copying it, visiting the states in the given order.
+        /// \param mode
+        /// \param order Order of the in-place sweeps
+        void set_evaluation_mode(EvaluationMode mode, SweepOrder order = SweepOrder::FORWARD) {
+            m_evaluation_mode = mode;
+            m_sweep_order = order;
+            m_sweep_revision.reset();
+        }
+
+        /// Solves the value function of the current policy, (I - gamma P_pi) v = r_pi, with BiCGSTAB starting
+        /// from the current values instead of approximating it with sweeps. Terminal states keep their value.
+        /// The values are only replaced if the solver converged.
+        /// \param settings
+        /// \return
+        LinearSolverResult evaluate_exact(const LinearSolverSettings &settings = {}) {
+            const size_t total_states = m_value_function.size();
+
+            // The system is solved in double precision for every value type
+            PolicySystemBuilder<double> system(total_states, static_cast<double>(m_gamma));
+            for (size_t idx = 0; idx != total_states; ++idx) {
+                if (is_terminal(idx)) {
+                    system.fixed_row(m_value_function[idx]);
+                    continue;
+                }
+
+                for (size_t i = m_action_offsets[idx]; i != m_action_offsets[idx + 1]; ++i) {
+                    const Action &action = m_actions[i];
+                    const Probability &probability = m_action_probabilities[i];
+                    if (probability == Probability{}) continue;
+
+                    auto add = [&system, weight = static_cast<double>(probability)](size_t s_i, const Reward &r, const Probability &p) {
+                        system.add(s_i, r, weight * p);
+                    };
+                    if (m_compiled) {
+                        auto range = m_compiled->transitions(idx, ActionTraits<Action>::id(action));
+                        for (size_t i = 0; i != range.size; ++i) add(range.successors[i], range.rewards[i], range.probabilities[i]);
+                    } else {
+                        m_graph_mdp->for_each_indexed_transition(idx, action, add);
                     }
                 }
+                system.end_row();
+            }
 
-                // Calculate new probability of actions
-                auto action_prob_list_copy = action_prob_list;
-
-                Probability new_probability = 1.0 / static_cast<Probability>(max_actions.size());
-                std::transform(action_prob_list.begin(), action_prob_list.end(), action_prob_list.begin(),
-                               [&max_actions, new_probability](const auto &action_prob) {
-                                   auto [a, p] = action_prob;
-                                   if (max_actions.find(a) == max_actions.end()) {
-                                       return std::make_pair(a, 0.0);
-                                   } else {
-                                       return std::make_pair(a, new_probability);
-                                   }
-                               });
-
-                if (!policy_changed && action_prob_list != action_prob_list_copy) policy_changed = true;
+            std::vector<double> values(m_value_function.begin(), m_value_function.end());
+            auto result = bicgstab(system.matrix(), system.rhs(), values, settings);
+            if (result.converged) {
+                std::transform(values.begin(), values.end(), m_value_function.begin(),
+                               [](double value) { return static_cast<Reward>(value); });
             }
 
-            return policy_changed;
+            return result;
         }
 
     private:
-        using ActionProbabilityList = std::vector<ActionProbability>;
-        std::map<State, ActionProbabilityList> m_state_action_map;
-        std::map<State, Reward> m_value_function;
-        double m_gamma;
+        // Tables indexed by the graph state ids. The actions of state idx and their probabilities are stored in
+        // [m_action_offsets[idx], m_action_offsets[idx + 1]), terminal states have none.
+        std::vector<size_t> m_action_offsets;
+        std::vector<Action> m_actions;
+        std::vector<Probability> m_action_probabilities;
+
+        // Jacobi sweeps write the new values to m_next_values and swap both buffers
+        std::vector<Reward> m_value_function, m_next_values;
+        Reward m_gamma;
 
         PGraphMDP m_graph_mdp;
+        PCompiledGraphMDP m_compiled;
+
+        // In-place sweeps, the state order is rebuilt when the model changes
+        EvaluationMode m_evaluation_mode{EvaluationMode::JACOBI};
+        SweepOrder m_sweep_order{SweepOrder::FORWARD};
+        std::vector<size_t> m_sweep_states;
+        std::optional<size_t> m_sweep_revision;
+
+        // States improved by update_policy_incremental, and the action values of the state being improved
+        detail::DirtyStates<Reward> m_dirty_states;
+        std::vector<Reward> m_action_values;
+
+        /// Returns true if the state is terminal, using the compiled model if available
+        /// \param idx
+        /// \return
+        bool is_terminal(size_t idx) const {
+            if (m_compiled) return m_compiled->is_terminal(idx);
+            return m_graph_mdp->is_terminal_state(m_graph_mdp->state_at(idx));
+        }
+
+        /// Returns the expected return of taking an action in a state according to the value function
+        /// \param idx
+        /// \param action
+        /// \return
+        Reward action_value(size_t idx, const Action &action) const {
+            Reward value{};
+
+            // Compiled model - iterate over the flat arrays
+            if (m_compiled) {
+                auto range = m_compiled->transitions(idx, ActionTraits<Action>::id(action));
+                for (size_t i = 0; i != range.size; ++i) {
+                    value += range.probabilities[i] * (range.rewards[i] + m_gamma * m_value_function[range.successors[i]]);
+                }
+                return value;
+            }
+
+            m_graph_mdp->for_each_indexed_transition(idx, action, [this, &value](size_t s_i, const Reward &r, const Probability &p) {
+                value += p * (r + m_gamma * m_value_function[s_i]);
+            });
+            return value;
+        }
+
+        /// Makes the policy of every state greedy according to the value function
+        /// \return Amount of states whose policy changed
+        size_t improve_all_states() {
+            size_t changed_states = 0;
+            for (size_t idx = 0; idx != m_value_function.size(); ++idx) {
+                if (improve_state(idx)) ++changed_states;
+            }
+            return changed_states;
+        }
+
+        /// Makes the policy of a state greedy according to the value function
+        /// \param idx
+        /// \return True if the policy of the state changed
+        bool improve_state(size_t idx) {
+            const size_t begin = m_action_offsets[idx], end = m_action_offsets[idx + 1];
+            if (begin == end) return false;
+
+            Reward max_value = -std::numeric_limits<Reward>::infinity();
+            size_t max_actions = 0;
+
+            // Calculate the action values, the buffer is reused by every state
+            m_action_values.clear();
+            for (size_t i = begin; i != end; ++i) {
+                Reward value = action_value(idx, m_actions[i]);
+                m_action_values.push_back(value);
+
+                // Check if it is the best action
+                if (value > max_value) {
+                    max_value = value;
+                    max_actions = 1;
+                } else if (value == max_value) {
+                    ++max_actions;
+                }
+            }
+
+            // Split the probability between the best actions, updating them in place
+            bool policy_changed = false;
+            Probability new_probability = 1.0 / static_cast<Probability>(max_actions);
+            for (size_t i = begin; i != end; ++i) {
+                Probability probability = m_action_values[i - begin] == max_value ? new_probability : Probability{};
+                if (m_action_probabilities[i] != probability) {
+                    m_action_probabilities[i] = probability;
+                    policy_changed = true;
+                }
+            }
+
+            return policy_changed;
+        }
+
+        /// Returns the expected return of a state following the policy, according to the value function
+        /// \param idx
+        /// \return
+        Reward state_value(size_t idx) const {
+            Reward value{};
+            for (size_t i = m_action_offsets[idx]; i != m_action_offsets[idx + 1]; ++i) {
+                value += m_action_probabilities[i] * action_value(idx, m_actions[i]);
+            }
+            return value;
+        }
+
+        /// Updates the value function in place, visiting the states in the sweep order
+        /// \return Largest change of the sweep
+        Reward gauss_seidel_sweep() {
+            // The state order of the active model is rebuilt when it changes
+            size_t revision = m_compiled ? m_compiled->revision() : m_graph_mdp->revision();
+            if (m_sweep_revision != revision) {
+                m_sweep_states = m_compiled ? detail::sweep_order(*m_compiled, m_sweep_order) :
+                                 detail::sweep_order(*m_graph_mdp, m_sweep_order);
+                m_sweep_revision = revision;
+            }
+
+            Reward delta{};
+            for (size_t idx: m_sweep_states) {
+                if (is_terminal(idx)) continue;
+
+                Reward new_value = state_value(idx);
+                delta = std::max(delta, std::abs(new_value - m_value_function[idx]));
+                m_value_function[idx] = new_value;
+            }
+
+            return delta;
+        }
     };
 
 } // Namespace rl::mdp
 
-#include "graph.h"
-
 #endif //REINFORCEMENT_LEARNING_GRAPH_POLICY_H
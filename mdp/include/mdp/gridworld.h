@@ -3,8 +3,12 @@
 
 #include <mdp/mdp.h>
 #include <mdp/actions.h>
+#include <mdp/compiled_mdp.h>
+#include <mdp/linear_solver.h>
+#include <mdp/parallel.h>
+#include <mdp/sweep.h>
+#include <mdp/states.h>
 
-#include <map>
 #include <set>
 #include <tuple>
 #include <random>
@@ -12,6 +16,11 @@
 #include <ostream>
 #include <array>
 #include <memory>
+#include <iterator>
+#include <cstdint>
+#include <string>
+#include <istream>
+#include <unordered_map>
 
 namespace rl::mdp {
     /// Actions for the Gridworld
@@ -41,25 +50,124 @@ namespace rl::mdp {
         /// \return
         auto operator!=(const GridworldState& other) const { return !this->operator==(other); }
     };
+} // namespace rl::mdp
+
+/// Hash for GridworldState, used by the generic StateIndexer
+template<>
+struct std::hash<rl::mdp::GridworldState> {
+    size_t operator()(const rl::mdp::GridworldState& state) const noexcept {
+        return std::hash<size_t>{}(state.row) ^ (std::hash<size_t>{}(state.column) * 0x9E3779B97F4A7C15ULL);
+    }
+};
 
-    /// Represents a grid based MDP with transitions between cells
-    class Gridworld: public MDP<GridworldState, GridworldAction> {
+namespace rl::mdp {
+    /// Maps the cells of a grid to dense ids using row-major order (row * columns + column)
+    class GridworldStateIndexer {
     public:
+        using State = GridworldState;
+
+        /// Creates an indexer for a grid with the given dimensions
+        /// \param rows
+        /// \param columns
+        GridworldStateIndexer(size_t rows, size_t columns): m_rows(rows), m_columns(columns) {}
+
+        /// Returns the amount of cells
+        /// \return
+        [[nodiscard]]
+        size_t size() const noexcept { return m_rows * m_columns; }
+
+        /// Returns the id of the given cell
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        size_t index(const State& state) const noexcept { return state.row * m_columns + state.column; }
+
+        /// Returns the id of the given cell, if it is inside the grid
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        std::optional<size_t> find(const State& state) const noexcept {
+            if (state.row >= m_rows || state.column >= m_columns) return std::nullopt;
+            return index(state);
+        }
+
+        /// Returns the cell with the given id
+        /// \param id
+        /// \return
+        [[nodiscard]]
+        State state(size_t id) const noexcept { return {id / m_columns, id % m_columns}; }
+
+    private:
+        size_t m_rows, m_columns;
+    };
+
+    /// Settings used when loading a Gridworld from a map file
+    struct GridworldMapSettings {
+        /// Penalty of the moves that bump into a wall
+        double wall_penalty{-1.0};
+
+        /// Default in-reward of the goal cells, see Gridworld::set_terminal_state
+        std::optional<double> goal_reward{};
+
+        /// Gray level of the PGM pixels that are initial states, as PGM images cannot use 'S' cells
+        std::optional<size_t> start_level{};
+
+        /// Gray level of the PGM pixels that are goals (terminal states), as PGM images cannot use 'G' cells
+        std::optional<size_t> goal_level{};
+    };
+
+    /// Represents a grid based MDP with transitions between cells. The member functions are compiled in the
+    /// library for double (Gridworld) and float (FloatGridworld) rewards and probabilities.
+    /// \tparam TReward
+    /// \tparam TProbability
+    template<class TReward = double, class TProbability = TReward>
+    class BasicGridworld: public MDP<GridworldState, GridworldAction, TReward, TProbability> {
+    public:
+        using Base = MDP<GridworldState, GridworldAction, TReward, TProbability>;
+        using typename Base::State;
+        using typename Base::Action;
+        using typename Base::Reward;
+        using typename Base::Probability;
+        using typename Base::StateRewardProbability;
+
         /// Creates a new Gridworld with the given amount of rows and columns
         /// \param rows
         /// \param columns
-        Gridworld(size_t rows, size_t columns)
-        : m_rows(rows), m_columns(columns), m_cost_of_living{}, m_bounds_penalty{-1} { }
+        BasicGridworld(size_t rows, size_t columns)
+        : m_rows(rows), m_columns(columns), m_cost_of_living{}, m_bounds_penalty{-1},
+          m_state_flags(rows * columns, 0) { }
+
+        /// Loads a map from a file, see load(std::istream&, const GridworldMapSettings&)
+        /// \param path
+        /// \param settings
+        /// \return
+        static BasicGridworld load(const std::string& path, const GridworldMapSettings& settings = {});
+
+        /// Loads a map in a single pass, without using the per-cell mutators. Two formats are accepted:
+        /// - ASCII maps, one line per row: '#' wall, 'S' initial state, 'G' goal (terminal state),
+        ///   '0'-'9' cell whose cost of living is minus the digit, '.' or ' ' free cell.
+        /// - Binary PGM (P5) images: black pixels are walls, white pixels free cells, and gray pixels have a
+        ///   cost of living between -1 (dark) and 0 (light). Pixels at the start_level or goal_level of the
+        ///   settings are initial states or goals instead.
+        /// \param input
+        /// \param settings
+        /// \return
+        static BasicGridworld load(std::istream& input, const GridworldMapSettings& settings = {});
 
         /// SETTINGS ///
 
         /// Set cost of living parameter.
         /// \param cost_of_living
-        void cost_of_living(Reward cost_of_living){ m_cost_of_living = cost_of_living; }
+        void cost_of_living(Reward cost_of_living){ m_cost_of_living = cost_of_living; this->mark_modified(); }
+
+        /// Set the cost of living of moving into a single cell, used instead of the global one
+        /// \param state
+        /// \param cost_of_living
+        void cost_of_living(const State& state, Reward cost_of_living);
 
         /// Set the out-of-bounds penalty
         /// \param bounds_penalty
-        void bounds_penalty(Reward bounds_penalty){ m_bounds_penalty = bounds_penalty; }
+        void bounds_penalty(Reward bounds_penalty){ m_bounds_penalty = bounds_penalty; this->mark_modified(); }
 
         /// MDP ///
 
@@ -73,6 +181,57 @@ namespace rl::mdp {
         [[nodiscard]]
         size_t get_columns() const { return m_columns; }
 
+        /// Returns the cost of living used by the cells without their own
+        /// \return
+        [[nodiscard]]
+        Reward get_cost_of_living() const { return m_cost_of_living; }
+
+        /// Returns the out-of-bounds penalty
+        /// \return
+        [[nodiscard]]
+        Reward get_bounds_penalty() const { return m_bounds_penalty; }
+
+        /// Returns the reward of moving into a cell with the default dynamics: its wall penalty, terminal in-reward
+        /// or own cost of living if it has one, and the global cost of living otherwise
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        Reward entry_reward(const State& state) const {
+            size_t state_idx = state_index(state);
+            return (m_state_flags[state_idx] & ENTRY_REWARD) != 0 ? m_entry_rewards[state_idx] : m_cost_of_living;
+        }
+
+        /// Returns a row-major mask with 1 for the cells whose four actions move to the neighbouring cell with the
+        /// global cost of living: non-terminal cells off the border without custom transitions, whose neighbours
+        /// are not walls and have no entry reward. Those cells can be backed up as a stencil.
+        /// \return
+        [[nodiscard]]
+        std::vector<uint8_t> default_dynamics_mask() const;
+
+        /// STATE INDEXING ///
+
+        /// Returns an indexer that maps cells to row-major ids
+        /// \return
+        [[nodiscard]]
+        GridworldStateIndexer state_indexer() const { return {m_rows, m_columns}; }
+
+        /// Returns the total amount of states
+        /// \return
+        [[nodiscard]]
+        size_t num_states() const { return m_rows * m_columns; }
+
+        /// Returns the dense id of a state
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        size_t state_index(const State& state) const { return state.row * m_columns + state.column; }
+
+        /// Returns the state with the given dense id
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        State state_at(size_t idx) const { return {idx / m_columns, idx % m_columns}; }
+
         /// Returns the Transition from a state action pair. If there are several states
         /// it returns a non-deterministic one
         /// \param state_action
@@ -80,7 +239,54 @@ namespace rl::mdp {
         [[nodiscard]]
         std::vector<StateRewardProbability> get_transitions(const State &state, const Action &action) const override;
 
-        /// Adds a transition with the given weight (NOTE: This is later normalized to sum 1)
+        /// Calls visitor(next_state, reward, probability) for every transition of the State-Action pair,
+        /// without building a transitions list. Returning false from the visitor stops the visit.
+        /// \param state
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_transition(const State &state, const Action &action, Visitor&& visitor) const {
+            // States outside of the grid only have the default transition
+            const DynamicsCell* cell = state.row < m_rows && state.column < m_columns ?
+                    find_cell(state_index(state), action) : nullptr;
+
+            // Default case - No transitions added for the current state
+            if(cell == nullptr){
+                auto [s_i, r, p] = transition_default(state, action);
+                detail::visit_transition(visitor, s_i, r, p);
+                return;
+            }
+
+            const IndexedTransition* transitions = cell_transitions(*cell);
+            for(size_t i = 0; i != cell->size; ++i){
+                const auto& [s_i, r, p] = transitions[i];
+                if(!detail::visit_transition(visitor, state_at(s_i), r, p)) return;
+            }
+        }
+
+        /// Same as for_each_transition, using dense state ids: visitor(next_state_id, reward, probability)
+        /// \param state_idx
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_indexed_transition(size_t state_idx, const Action &action, Visitor&& visitor) const {
+            const DynamicsCell* cell = find_cell(state_idx, action);
+
+            if(cell == nullptr){
+                auto [s_i, r, p] = transition_default(state_at(state_idx), action);
+                detail::visit_transition(visitor, state_index(s_i), r, p);
+                return;
+            }
+
+            const IndexedTransition* transitions = cell_transitions(*cell);
+            for(size_t i = 0; i != cell->size; ++i){
+                const auto& [s_i, r, p] = transitions[i];
+                if(!detail::visit_transition(visitor, s_i, r, p)) return;
+            }
+        }
+
+        /// Adds a transition with the given weight. The probabilities of the State-Action pair are normalised
+        /// so they sum 1 after every insertion.
         /// \param state
         /// \param action
         /// \param new_state
@@ -143,6 +349,8 @@ namespace rl::mdp {
         void set_initial_state(const State& s) override{
             if(is_wall_state(s) || is_terminal_state(s))
                 throw std::invalid_argument("Terminal or wall states cannot be marked as initial");
+            if(!in_grid(s)) throw std::out_of_range("Initial state must be inside the grid");
+            m_state_flags[state_index(s)] |= INITIAL_STATE;
             m_initial_states.insert(s);
         }
 
@@ -150,9 +358,7 @@ namespace rl::mdp {
         /// \param s
         /// \return
         [[nodiscard]]
-        bool is_initial_state(const State& s) const override{
-            return m_initial_states.find(s) != m_initial_states.cend();
-        }
+        bool is_initial_state(const State& s) const override{ return has_flag(s, INITIAL_STATE); }
 
         /// Returns a list with the initial states
         /// \return
@@ -169,26 +375,82 @@ namespace rl::mdp {
         /// Returns true if the state is a Wall
         /// \param s
         /// \return
-        bool is_wall_state(const State& s) const{
-            return m_wall_states.find(s) != m_wall_states.end();
-        }
+        bool is_wall_state(const State& s) const{ return has_flag(s, WALL_STATE); }
 
         /// Returns aa list with all states marked as walls
         /// \return
         [[nodiscard]]
-        std::vector<State> get_wall_states() const{
-            return {m_wall_states.begin(), m_wall_states.end() };
-        }
+        std::vector<State> get_wall_states() const;
 
 
     private:
-        using DynamicsMap = std::multimap<StateAction, StateRewardProbability>;
-        DynamicsMap m_dynamics;
+        /// Transition stored in the dynamics table, using the dense id of the next state
+        struct IndexedTransition {
+            size_t successor;
+            Reward reward;
+            Probability probability;
+        };
+
+        /// Custom transitions of a State-Action pair. A single transition is stored inline, stochastic pairs
+        /// use a block of the overflow pool. Pairs without transitions use transition_default.
+        struct DynamicsCell {
+            uint32_t size{0};
+            uint32_t capacity{0};
+            size_t overflow{0};
+            Probability total_weight{};
+            IndexedTransition single{};
+        };
+
+        // Cells of the State-Action pairs with custom transitions. Pairs are found by their id,
+        // state_index * total_actions + action_id, in blocks of CELL_BLOCK_SIZE states allocated on the first
+        // custom transition of the block. Block entries are the position of the cell in m_cells plus one, or 0.
+        std::vector<DynamicsCell> m_cells;
+        std::vector<std::vector<uint32_t>> m_cell_blocks;
+        static constexpr size_t CELL_BLOCK_SIZE = 1 << 10;
+        std::vector<IndexedTransition> m_overflow;
+        size_t m_overflow_unused{0};
+
+        // Cells with custom transitions going to each state, used to edit walls and terminals locally
+        std::unordered_map<size_t, std::vector<size_t>> m_incoming;
 
         size_t m_rows, m_columns;
         Reward m_cost_of_living, m_bounds_penalty;
 
-        std::set<State> m_terminal_states, m_initial_states, m_wall_states;
+        /// Flags stored per state
+        enum StateFlags : uint8_t {
+            WALL_STATE = 1,
+            TERMINAL_STATE = 2,
+            INITIAL_STATE = 4,
+            ENTRY_REWARD = 8    //< Moving into the state uses m_entry_rewards instead of the cost of living
+        };
+
+        // Flags indexed by state, and rewards of moving into a cell (wall penalty, terminal in-reward or
+        // per-cell cost of living). The rewards are allocated when first needed.
+        std::vector<uint8_t> m_state_flags;
+        std::vector<Reward> m_entry_rewards;
+
+        // Terminal and initial states are few, so they are also kept as lists
+        std::set<State> m_terminal_states, m_initial_states;
+
+        /// Returns true if the state is inside the grid
+        /// \param s
+        /// \return
+        [[nodiscard]]
+        bool in_grid(const State& s) const { return s.row < m_rows && s.column < m_columns; }
+
+        /// Returns true if the state is in the grid and has the flag
+        /// \param s
+        /// \param flag
+        /// \return
+        [[nodiscard]]
+        bool has_flag(const State& s, StateFlags flag) const {
+            return in_grid(s) && (m_state_flags[state_index(s)] & flag) != 0;
+        }
+
+        /// Sets the reward of moving into a state
+        /// \param state_idx
+        /// \param reward
+        void set_entry_reward(size_t state_idx, Reward reward);
 
         /// Returns the default transition for the state-action pair
         /// \param state
@@ -197,19 +459,118 @@ namespace rl::mdp {
         [[nodiscard]]
         StateRewardProbability transition_default(const State &state, const Action &action) const;
 
-        /// Removes added transitions between states (reverting to default)
-        /// \param source
+        /// Returns the cell of a State-Action pair if it has custom transitions, nullptr otherwise
+        /// \param state_idx
         /// \param action
+        /// \return
+        [[nodiscard]]
+        const DynamicsCell* find_cell(size_t state_idx, const Action& action) const {
+            const DynamicsCell* cell = cell_at(cell_id(state_idx, action));
+            return cell == nullptr || cell->size == 0 ? nullptr : cell;
+        }
+
+        /// Returns the cell of a State-Action pair id, nullptr if it was never allocated
+        /// \param id
+        /// \return
+        [[nodiscard]]
+        const DynamicsCell* cell_at(size_t id) const {
+            constexpr size_t block_cells = CELL_BLOCK_SIZE * ActionTraits<Action>::total_actions();
+            const size_t block = id / block_cells;
+            if(block >= m_cell_blocks.size() || m_cell_blocks[block].empty()) return nullptr;
+
+            uint32_t position = m_cell_blocks[block][id % block_cells];
+            return position == 0 ? nullptr : &m_cells[position - 1];
+        }
+
+        /// Returns the cell of a State-Action pair id, nullptr if it was never allocated
+        /// \param id
+        /// \return
+        DynamicsCell* cell_at(size_t id) {
+            return const_cast<DynamicsCell*>(static_cast<const BasicGridworld*>(this)->cell_at(id));
+        }
+
+        /// Returns the position of a State-Action pair in the dynamics table
+        /// \param state_idx
+        /// \param action
+        /// \return
+        [[nodiscard]]
+        static size_t cell_id(size_t state_idx, const Action& action) {
+            return state_idx * ActionTraits<Action>::total_actions() + ActionTraits<Action>::id(action);
+        }
+
+        /// Returns the cell of a State-Action pair, allocating it if needed
+        /// \param state_idx
+        /// \param action
+        /// \return
+        DynamicsCell& get_cell(size_t state_idx, const Action& action);
+
+        /// Returns the transitions stored in a cell
+        /// \param cell
+        /// \return
+        [[nodiscard]]
+        const IndexedTransition* cell_transitions(const DynamicsCell& cell) const {
+            return cell.size == 1 ? &cell.single : m_overflow.data() + cell.overflow;
+        }
+
+        /// Returns the transitions stored in a cell
+        /// \param cell
+        /// \return
+        IndexedTransition* cell_transitions(DynamicsCell& cell) {
+            return cell.size == 1 ? &cell.single : m_overflow.data() + cell.overflow;
+        }
+
+        /// Registers that the cell has custom transitions going to target
         /// \param target
-        void remove_added_transition(const State& source, const Action& action, const State& target);
+        /// \param cell_id
+        void add_incoming(size_t target, size_t cell_id);
+
+        /// Moves every custom transition going to target to the state given by redirect(source) with the given
+        /// reward. Probabilities are kept. Only the cells with transitions into target are visited, default
+        /// transitions read the state flags instead.
+        /// \tparam Redirect
+        /// \param target
+        /// \param reward
+        /// \param redirect
+        template<class Redirect>
+        void redirect_transitions(size_t target, Reward reward, Redirect&& redirect);
+
+        /// Reallocates the overflow blocks contiguously once most of the pool is unused
+        void compact_overflow();
     };
 
-    class GridworldGreedyPolicy: public MDPPolicy<GridworldState, GridworldAction>{
+    /// Gridworld with double rewards and probabilities
+    using Gridworld = BasicGridworld<double>;
+
+    /// Gridworld with float rewards and probabilities, halving the size of the tables
+    using FloatGridworld = BasicGridworld<float>;
+
+    extern template class BasicGridworld<double>;
+    extern template class BasicGridworld<float>;
+
+    /// Gridworld dynamics compiled into CSR arrays
+    using CompiledGridworld = CompiledMDP<GridworldState, GridworldAction>;
+
+    /// Greedy policy with a flat value function table for a BasicGridworld. Compiled in the library for double
+    /// (GridworldGreedyPolicy) and float (FloatGridworldGreedyPolicy).
+    /// \tparam TReward
+    /// \tparam TProbability
+    template<class TReward = double, class TProbability = TReward>
+    class BasicGridworldGreedyPolicy: public MDPPolicy<GridworldState, GridworldAction, TReward, TProbability>{
     public:
+        using Base = MDPPolicy<GridworldState, GridworldAction, TReward, TProbability>;
+        using typename Base::State;
+        using typename Base::Action;
+        using typename Base::Reward;
+        using typename Base::Probability;
+        using typename Base::ActionProbability;
+
+        using Gridworld = BasicGridworld<TReward, TProbability>;
+        using CompiledGridworld = CompiledMDP<GridworldState, GridworldAction, TReward, TProbability>;
+
         /// Default constructor with rows and columns.
         /// \param rows
         /// \param columns
-        explicit GridworldGreedyPolicy(std::shared_ptr<Gridworld> gridworld, double gamma);
+        explicit BasicGridworldGreedyPolicy(std::shared_ptr<Gridworld> gridworld, double gamma);
 
         /// Return the possible actions and its probabilities based on the current state.
         /// \param state
@@ -231,47 +592,185 @@ namespace rl::mdp {
         /// \return True if the policy changed
         bool update_policy() override;
 
+        /// Makes the policy greedy only in the states whose action values may have changed since the last call:
+        /// the states whose value changed more than tolerance, and their predecessors. The first call, and the
+        /// first one after update_policy or a change of the model, improves every state. It always runs in a
+        /// single thread.
+        /// \param tolerance Smaller changes of a value are ignored until they add up to more than tolerance
+        /// \return Amount of states whose policy changed
+        size_t update_policy_incremental(double tolerance = 0.0);
+
+        /// Selects how policy_evaluation updates the value table. GAUSS_SEIDEL updates it in place without copying
+        /// it, visiting the states in the given order, and always runs in a single thread.
+        /// \param mode
+        /// \param order Order of the in-place sweeps
+        void set_evaluation_mode(EvaluationMode mode, SweepOrder order = SweepOrder::FORWARD);
+
+        /// Solves the value function of the current policy, (I - gamma P_pi) v = r_pi, with BiCGSTAB starting
+        /// from the current table instead of approximating it with sweeps. Terminal states keep their value.
+        /// The table is only replaced if the solver converged, which needs gamma < 1 or a policy that reaches
+        /// a terminal state from every state.
+        /// \param settings
+        /// \return
+        LinearSolverResult evaluate_exact(const LinearSolverSettings& settings = {});
+
         /// Returns the value function result given a state.
         /// \param state
         /// \return
         [[nodiscard]]
         Reward value_function(const State &state) const override;
 
+        /// Returns the value function table
+        /// \return Row-major values of every cell
+        [[nodiscard]]
+        const std::vector<Reward>& get_value_function() const { return m_value_function_table; }
+
+        /// Returns the amount of states visited by every sweep of policy_evaluation and update_policy
+        /// \return
+        [[nodiscard]]
+        size_t num_states() const { return m_value_function_table.size(); }
+
+        /// Replaces the value function table, e.g. to warm start the sweeps. Terminal states keep the given value.
+        /// \param values Row-major values of every cell
+        void set_value_function(std::vector<Reward> values);
+
+        /// Freezes the current gridworld dynamics into a CompiledGridworld used by the following sweeps.
+        /// It must be called again after the gridworld is modified.
+        void compile_model();
+
+        /// Sets the compiled model used by the sweeps, nullptr reverts to querying the gridworld.
+        /// \param compiled Model compiled from a gridworld with the same dimensions
+        void set_compiled_model(std::shared_ptr<const CompiledGridworld> compiled);
+
+        /// Selects how policy_evaluation and update_policy sweep the states. The parallel mode splits the states
+        /// in blocks that run in a task arena, giving the same values, deltas and policies as the sequential one.
+        /// \param mode
+        /// \param max_threads Maximum threads used by the parallel mode, 0 uses every available core
+        void set_execution_mode(ExecutionMode mode, size_t max_threads = 0);
+
+        /// Returns how the sweeps are run
+        /// \return
+        [[nodiscard]]
+        ExecutionMode get_execution_mode() const { return m_execution_mode; }
+
     private:
         std::shared_ptr<Gridworld> m_gridworld;
+        std::shared_ptr<const CompiledGridworld> m_compiled;
         size_t m_rows, m_columns;
-        double m_gamma;
-        std::vector<Probability> m_value_function_table;
+        Reward m_gamma;
+        std::vector<Reward> m_value_function_table;
+
+        // Action probabilities, indexed by state_id * total_actions + action_id
+        std::vector<Probability> m_action_probabilities;
 
-        // Way of representing action-probability pairs
-        using ActionProbabilityMap = std::map<Action, Probability>;
-        std::map<State, ActionProbabilityMap> m_state_action_probability_map;
+        // Parallel sweeps, the arena is shared by the copies of the policy
+        ExecutionMode m_execution_mode{ExecutionMode::SEQUENTIAL};
+        std::shared_ptr<detail::TaskArena> m_arena;
+
+        // In-place sweeps, the FROM_TERMINALS order is rebuilt when the model changes
+        EvaluationMode m_evaluation_mode{EvaluationMode::JACOBI};
+        SweepOrder m_sweep_order{SweepOrder::FORWARD};
+        std::vector<size_t> m_sweep_states;
+        std::optional<size_t> m_sweep_revision;
+
+        // Cells backed up with the stencil kernel in the Jacobi sweeps, rebuilt when the gridworld changes
+        std::vector<uint8_t> m_stencil_mask;
+        std::optional<size_t> m_stencil_revision;
+
+        // States improved by update_policy_incremental
+        detail::DirtyStates<Reward> m_dirty_states;
+
+        // States per block in the parallel sweeps
+        static constexpr size_t SWEEP_BLOCK_SIZE = 1 << 10;
 
         /// Returns a copy a the value from the value function table
         /// \param state
         /// \return
         [[nodiscard]]
-        Probability value_from_table(const State& state) const{ return m_value_function_table[state.row * m_columns + state.column]; };
+        Reward value_from_table(const State& state) const{ return m_value_function_table[state.row * m_columns + state.column]; };
 
         /// Returns a reference to the value function table
         /// \param state
         /// \return
-        Probability& value_from_table(const State& state) { return m_value_function_table[state.row * m_columns + state.column]; };
+        Reward& value_from_table(const State& state) { return m_value_function_table[state.row * m_columns + state.column]; };
+
+        /// Returns true if the state is terminal, using the compiled model if available
+        /// \param state_idx
+        /// \return
+        [[nodiscard]]
+        bool is_terminal(size_t state_idx) const;
+
+        /// Returns the expected return of taking an action in a state according to the value function table
+        /// \param state_idx
+        /// \param action
+        /// \return
+        [[nodiscard]]
+        Reward action_value(size_t state_idx, const Action& action) const;
+
+        /// Returns the expected return of a state following the policy, according to the value function table
+        /// \param state_idx
+        /// \return
+        [[nodiscard]]
+        Reward state_value(size_t state_idx) const;
+
+        /// Updates the value table in place, visiting the states in the sweep order
+        /// \return Largest change of the sweep
+        Reward gauss_seidel_sweep();
+
+        /// Returns the states in the FROM_TERMINALS order, rebuilding it if the model changed
+        /// \return
+        const std::vector<size_t>& sweep_states();
+
+        /// Rebuilds the stencil mask if the gridworld changed. It is left empty when the sweeps use a compiled
+        /// model, which may not follow the default dynamics.
+        void update_stencil_mask();
+
+        /// Evaluates the states in [begin, end) into new_values, reading only the current value table
+        /// \param begin
+        /// \param end
+        /// \param new_values
+        /// \return Largest change of the block
+        Reward evaluate_states(size_t begin, size_t end, std::vector<Reward>& new_values) const;
+
+        /// Makes the policy of every state greedy according to the value table, in the execution mode
+        /// \return Amount of states whose policy changed
+        size_t improve_all_states();
+
+        /// Makes the policy of the states in [begin, end) greedy according to the value table
+        /// \param begin
+        /// \param end
+        /// \return Amount of states whose policy changed
+        size_t improve_states(size_t begin, size_t end);
+
+        /// Makes the policy of a state greedy according to the value table
+        /// \param state_idx
+        /// \return True if the policy of the state changed
+        bool improve_state(size_t state_idx);
     };
 
+    /// Greedy policy for a Gridworld
+    using GridworldGreedyPolicy = BasicGridworldGreedyPolicy<double>;
+
+    /// Greedy policy for a FloatGridworld
+    using FloatGridworldGreedyPolicy = BasicGridworldGreedyPolicy<float>;
+
+    extern template class BasicGridworldGreedyPolicy<double>;
+    extern template class BasicGridworldGreedyPolicy<float>;
+
 } // namespace rl::mdp
 
 /// Outputs the current State
 /// \param os
 /// \param state
 /// \return
-std::ostream &operator<<(std::ostream &os, const rl::mdp::Gridworld::State &state);
+std::ostream &operator<<(std::ostream &os, const rl::mdp::GridworldState &state);
 
 /// Outputs the current policy for a gridworld
 /// \param os
 /// \param greedy_policy
 /// \return
-std::ostream& operator<<(std::ostream& os, const rl::mdp::GridworldGreedyPolicy& greedy_policy);
+template<class TReward, class TProbability>
+std::ostream& operator<<(std::ostream& os, const rl::mdp::BasicGridworldGreedyPolicy<TReward, TProbability>& greedy_policy);
 
 
 
@@ -0,0 +1,209 @@
+#ifndef REINFORCEMENT_LEARNING_LINEAR_SOLVER_H
+#define REINFORCEMENT_LEARNING_LINEAR_SOLVER_H
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+namespace rl::mdp {
+
+    /// Settings of the sparse linear solvers
+    struct LinearSolverSettings {
+        /// Solving stops once ||b - Ax|| <= tolerance * ||b|| (or tolerance if b is zero)
+        double tolerance{1e-10};
+
+        /// Maximum amount of iterations, each one does two matrix-vector products
+        size_t max_iterations{10000};
+    };
+
+    /// Result of a sparse linear solve
+    struct LinearSolverResult {
+        size_t iterations{0};
+
+        /// Relative residual ||b - Ax|| / ||b|| of the returned solution
+        double residual{std::numeric_limits<double>::infinity()};
+
+        /// False if max_iterations was reached or the method broke down, e.g. with a singular system
+        bool converged{false};
+    };
+
+    /// Square sparse matrix in CSR form: the entries of row i are columns[row_offsets[i]], ..., with the values
+    /// at the same positions
+    /// \tparam T
+    template<class T>
+    struct SparseMatrix {
+        std::vector<size_t> row_offsets{0};
+        std::vector<size_t> columns;
+        std::vector<T> values;
+
+        /// Returns the amount of rows
+        /// \return
+        [[nodiscard]]
+        size_t rows() const { return row_offsets.size() - 1; }
+
+        /// Computes y = A x
+        /// \param x
+        /// \param y Resized to the amount of rows
+        void multiply(const std::vector<T> &x, std::vector<T> &y) const {
+            y.resize(rows());
+            for (size_t row = 0; row != rows(); ++row) {
+                T sum{};
+                for (size_t i = row_offsets[row]; i != row_offsets[row + 1]; ++i) sum += values[i] * x[columns[i]];
+                y[row] = sum;
+            }
+        }
+    };
+
+    namespace detail {
+        template<class T>
+        T dot(const std::vector<T> &a, const std::vector<T> &b) {
+            T sum{};
+            for (size_t i = 0; i != a.size(); ++i) sum += a[i] * b[i];
+            return sum;
+        }
+    } // namespace detail
+
+    /// Solves A x = b with the stabilized bi-conjugate gradient method (BiCGSTAB), which handles the
+    /// non-symmetric systems of policy evaluation using only matrix-vector products
+    /// \tparam T
+    /// \param matrix
+    /// \param b
+    /// \param x Initial guess, overwritten with the solution
+    /// \param settings
+    /// \return
+    template<class T>
+    LinearSolverResult bicgstab(const SparseMatrix<T> &matrix, const std::vector<T> &b, std::vector<T> &x,
+                                const LinearSolverSettings &settings = {}) {
+        const size_t n = matrix.rows();
+        if (b.size() != n || x.size() != n) throw std::invalid_argument("System dimensions do not match");
+
+        LinearSolverResult result;
+        T b_norm = std::sqrt(detail::dot(b, b));
+        if (b_norm == T{}) b_norm = T{1};
+
+        // r = b - A x
+        std::vector<T> r(n), v(n, T{}), p(n, T{}), s(n), t(n);
+        matrix.multiply(x, r);
+        for (size_t i = 0; i != n; ++i) r[i] = b[i] - r[i];
+        const std::vector<T> r_hat(r);
+
+        result.residual = static_cast<double>(std::sqrt(detail::dot(r, r)) / b_norm);
+        T rho{1}, alpha{1}, omega{1};
+        while (result.residual > settings.tolerance && result.iterations < settings.max_iterations) {
+            T rho_next = detail::dot(r_hat, r);
+            if (rho_next == T{} || omega == T{}) return result;
+
+            T beta = (rho_next / rho) * (alpha / omega);
+            for (size_t i = 0; i != n; ++i) p[i] = r[i] + beta * (p[i] - omega * v[i]);
+            matrix.multiply(p, v);
+
+            T r_hat_v = detail::dot(r_hat, v);
+            if (r_hat_v == T{}) return result;
+            alpha = rho_next / r_hat_v;
+            for (size_t i = 0; i != n; ++i) s[i] = r[i] - alpha * v[i];
+            ++result.iterations;
+
+            // Half step already converged
+            T s_norm = std::sqrt(detail::dot(s, s));
+            if (s_norm / b_norm <= settings.tolerance) {
+                for (size_t i = 0; i != n; ++i) x[i] += alpha * p[i];
+                result.residual = static_cast<double>(s_norm / b_norm);
+                break;
+            }
+
+            matrix.multiply(s, t);
+            T t_t = detail::dot(t, t);
+            if (t_t == T{}) return result;
+            omega = detail::dot(t, s) / t_t;
+
+            for (size_t i = 0; i != n; ++i) {
+                x[i] += alpha * p[i] + omega * s[i];
+                r[i] = s[i] - omega * t[i];
+            }
+            rho = rho_next;
+            result.residual = static_cast<double>(std::sqrt(detail::dot(r, r)) / b_norm);
+        }
+
+        result.converged = std::isfinite(result.residual) && result.residual <= settings.tolerance;
+        return result;
+    }
+
+    /// Builds the system (I - gamma P_pi) v = r_pi of a policy one row per state, merging the transitions of
+    /// every action into the same successor
+    /// \tparam T
+    template<class T>
+    class PolicySystemBuilder {
+    public:
+        /// \param total_states
+        /// \param gamma
+        PolicySystemBuilder(size_t total_states, T gamma) : m_gamma(gamma) {
+            m_matrix.row_offsets.reserve(total_states + 1);
+            m_rhs.reserve(total_states);
+        }
+
+        /// Adds a transition of the current row, already weighted by the probability of its action
+        /// \param successor
+        /// \param reward
+        /// \param probability
+        void add(size_t successor, T reward, T probability) {
+            if (probability == T{}) return;
+            m_entries.emplace_back(successor, -m_gamma * probability);
+            m_row_rhs += probability * reward;
+        }
+
+        /// Ends the row of the next state with the transitions added since the last row
+        void end_row() {
+            const size_t row = m_rhs.size();
+            m_entries.emplace_back(row, T{1});
+            std::sort(m_entries.begin(), m_entries.end(),
+                      [](const auto &a, const auto &b) { return a.first < b.first; });
+
+            for (const auto &[column, value]: m_entries) {
+                if (m_matrix.columns.size() != m_matrix.row_offsets.back() && m_matrix.columns.back() == column) {
+                    m_matrix.values.back() += value;
+                } else {
+                    m_matrix.columns.push_back(column);
+                    m_matrix.values.push_back(value);
+                }
+            }
+            m_matrix.row_offsets.push_back(m_matrix.columns.size());
+            m_rhs.push_back(m_row_rhs);
+
+            m_entries.clear();
+            m_row_rhs = T{};
+        }
+
+        /// Ends the row of the next state fixing its value, used for terminal states
+        /// \param value
+        void fixed_row(T value) {
+            m_entries.clear();
+            m_row_rhs = value;
+            end_row();
+        }
+
+        /// Returns the matrix I - gamma P_pi
+        /// \return
+        [[nodiscard]]
+        const SparseMatrix<T> &matrix() const { return m_matrix; }
+
+        /// Returns the expected rewards r_pi
+        /// \return
+        [[nodiscard]]
+        const std::vector<T> &rhs() const { return m_rhs; }
+
+    private:
+        T m_gamma;
+        SparseMatrix<T> m_matrix;
+        std::vector<T> m_rhs;
+
+        // Entries and expected reward of the current row
+        std::vector<std::pair<size_t, T>> m_entries;
+        T m_row_rhs{};
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_LINEAR_SOLVER_H
@@ -2,14 +2,62 @@
 #define REINFORCEMENT_LEARNING_MDP_H
 
 #include <tuple>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <random>
 #include <optional>
 #include <algorithm>
 #include <stdexcept>
+#include <type_traits>
+
+#include <boost/core/span.hpp>
+#include <mdp/alias_table.h>
 
 namespace rl::mdp{
+    namespace detail {
+        /// Detects MDPs that can sample a transition directly, without building the transition list
+        template<class MDP, class = void>
+        struct has_sample_transition : std::false_type {};
+
+        template<class MDP>
+        struct has_sample_transition<MDP, std::void_t<decltype(std::declval<const MDP&>().sample_transition(
+                std::declval<const typename MDP::State&>(),
+                std::declval<const typename MDP::Action&>(),
+                std::declval<typename MDP::Probability>()))>> : std::true_type {};
+
+        /// Visitor type used to detect for_each_indexed_transition
+        template<class MDP>
+        struct IndexedTransitionVisitor {
+            void operator()(size_t, const typename MDP::Reward&, const typename MDP::Probability&) const {}
+        };
+
+        /// Detects MDPs with dense state indexing hooks (num_states, state_index, state_at, for_each_indexed_transition)
+        template<class MDP, class = void>
+        struct has_state_index : std::false_type {};
+
+        template<class MDP>
+        struct has_state_index<MDP, std::void_t<
+                decltype(std::declval<const MDP&>().num_states()),
+                decltype(std::declval<const MDP&>().state_index(std::declval<const typename MDP::State&>())),
+                decltype(std::declval<const MDP&>().state_at(size_t{})),
+                decltype(std::declval<const MDP&>().for_each_indexed_transition(
+                        size_t{}, std::declval<const typename MDP::Action&>(),
+                        std::declval<IndexedTransitionVisitor<MDP>>()))>> : std::true_type {};
+
+        /// Calls a transition visitor. Visitors may return bool, where false stops the visit.
+        /// \return True if the visit should continue
+        template<class Visitor, class State, class Reward, class Probability>
+        bool visit_transition(Visitor& visitor, const State& state, const Reward& reward, const Probability& probability) {
+            if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const State&, const Reward&, const Probability&>, bool>) {
+                return visitor(state, reward, probability);
+            } else {
+                visitor(state, reward, probability);
+                return true;
+            }
+        }
+    } // namespace detail
+
     template <class TState, class TAction, class TReward=double, class TProbability=double>
     class MDP{
     public:
@@ -36,6 +84,19 @@ namespace rl::mdp{
         [[nodiscard]]
         virtual std::vector<StateRewardProbability> get_transitions(const State& state, const Action& action) const = 0;
 
+        /// Calls visitor(next_state, reward, probability) for every transition of a State-Action pair. If the
+        /// visitor returns bool, returning false stops the visit. Concrete MDPs hide this version with one that
+        /// does not build the transitions list, so it should be called through the concrete type.
+        /// \param state
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_transition(const State& state, const Action& action, Visitor&& visitor) const {
+            for (const auto& [s_i, r, p]: get_transitions(state, action)) {
+                if (!detail::visit_transition(visitor, s_i, r, p)) return;
+            }
+        }
+
         /// Adds a transition with the given probability
         /// \param state
         /// \param action
@@ -110,6 +171,18 @@ namespace rl::mdp{
 
         static Probability srp_probability(const StateRewardProbability& srp){ return std::get<2>(srp); }
         static Probability& srp_probability(StateRewardProbability& srp){ return std::get<2>(srp); }
+
+        /// Returns a counter that changes every time the dynamics are modified, used to invalidate caches.
+        /// \return
+        [[nodiscard]]
+        size_t revision() const { return m_revision; }
+
+    protected:
+        /// Marks the dynamics as modified
+        void mark_modified() { ++m_revision; }
+
+    private:
+        size_t m_revision{0};
     };
 
     /// Defines an agent to traverse an MDP
@@ -186,6 +259,31 @@ namespace rl::mdp{
         virtual ~MDPPolicy() = default;
     };
 
+    /// How MDPEnvironment samples the next state
+    enum class SamplingMode {
+        LINEAR, //< Accumulate the transition probabilities until reaching a uniform sample
+        ALIAS   //< Use precomputed alias tables, sampling in O(1). Requires the state indexing hooks.
+    };
+
+    /// How policies run their sweeps over the states
+    enum class ExecutionMode {
+        SEQUENTIAL, //< A single thread in state order
+        PARALLEL    //< State blocks split across threads, with the same results as SEQUENTIAL
+    };
+
+    /// How policy evaluation updates the value function
+    enum class EvaluationMode {
+        JACOBI,      //< Every state is backed up with the values of the previous sweep, kept in a copy of the table
+        GAUSS_SEIDEL //< Values are updated in place, so later states in the sweep already use the new values
+    };
+
+    /// Order in which an in-place policy evaluation visits the states
+    enum class SweepOrder {
+        FORWARD,       //< Increasing state ids (row-major in a Gridworld)
+        REVERSE,       //< Decreasing state ids
+        FROM_TERMINALS //< Breadth first from the terminal states, following the transitions backwards
+    };
+
     /// Environment using an MDP as source of information
     /// \tparam MDP
     template<class MDP>
@@ -202,12 +300,19 @@ namespace rl::mdp{
         /// Create the environment with the given MDP
         /// \param mdp
         /// \param seed Seed for the random generator, use 0 for a random one
-        explicit MDPEnvironment(std::shared_ptr<MDP> mdp, RandomEngine::result_type seed = 0):
-        m_mdp(mdp), m_random_engine(seed), m_random_distribution(0.0){
+        /// \param sampling_mode How the next state is sampled on each step
+        explicit MDPEnvironment(std::shared_ptr<MDP> mdp, RandomEngine::result_type seed = 0,
+                                SamplingMode sampling_mode = SamplingMode::LINEAR):
+        m_mdp(mdp), m_random_engine(seed), m_random_distribution(0.0), m_sampling_mode(sampling_mode){
             // Check if a new seed is necessary
             if(seed == 0){
                 m_random_engine.seed(std::random_device{}());
             }
+
+            // Alias tables are indexed by state
+            if(sampling_mode == SamplingMode::ALIAS && !detail::has_state_index<MDP>::value){
+                throw std::invalid_argument("Alias sampling requires an MDP with state indexing");
+            }
         }
 
         /// Starts the environment and returns the initial state
@@ -229,6 +334,10 @@ namespace rl::mdp{
                             m_random_engine);
             }
 
+            if constexpr (detail::has_state_index<MDP>::value) {
+                if(m_sampling_mode == SamplingMode::ALIAS) m_last_state_index = m_mdp->state_index(m_last_state);
+            }
+
             return m_last_state;
         }
 
@@ -239,20 +348,41 @@ namespace rl::mdp{
         [[nodiscard]]
         virtual std::tuple<State, Reward, bool> step(const Action &action){
             // Initialize probability
-            Probability accumulated_probability = 0;
             Probability target_probability = m_random_distribution(m_random_engine);
 
-            // Get transitions from the MDP
-            auto transitions = m_mdp->get_transitions(m_last_state, action);
-            for(const auto& [s_i, r, p]: transitions){
-                accumulated_probability += p;
-                if(accumulated_probability >= target_probability){
-                    m_last_state = s_i;
-                    return std::make_tuple(s_i, r, m_mdp->is_terminal_state(s_i));
-                }
+            if constexpr (detail::has_state_index<MDP>::value) {
+                if(m_sampling_mode == SamplingMode::ALIAS) return step_alias(action, target_probability);
             }
 
-            throw std::range_error("Transition probability does not sum 1.0");
+            if constexpr (detail::has_sample_transition<MDP>::value) {
+                // Models with precomputed cumulative probabilities sample without building the transition list
+                auto [s_i, r, is_terminal] = m_mdp->sample_transition(m_last_state, action, target_probability);
+                m_last_state = s_i;
+                return std::make_tuple(s_i, r, is_terminal);
+            } else {
+                // Visit the transitions from the MDP until the target probability is reached
+                Probability accumulated_probability = 0;
+                bool found = false;
+                State next_state{};
+                Reward reward{};
+                m_mdp->for_each_transition(m_last_state, action,
+                                           [&](const State& s_i, const Reward& r, const Probability& p){
+                    accumulated_probability += p;
+                    if(accumulated_probability >= target_probability){
+                        next_state = s_i;
+                        reward = r;
+                        found = true;
+                    }
+                    return !found;
+                });
+
+                if(found){
+                    m_last_state = next_state;
+                    return std::make_tuple(next_state, reward, m_mdp->is_terminal_state(next_state));
+                }
+
+                throw std::range_error("Transition probability does not sum 1.0");
+            }
         }
 
         /// Virtual destructor
@@ -264,9 +394,251 @@ namespace rl::mdp{
 
         RandomEngine m_random_engine;
         std::uniform_real_distribution<Probability> m_random_distribution;
+
+        // Alias sampling
+        SamplingMode m_sampling_mode;
+        size_t m_last_state_index{0};
+        AliasTable<Action, Reward, Probability> m_alias_table;
+        std::optional<size_t> m_alias_revision;
+        std::vector<bool> m_is_terminal;
+
+        /// Makes a step using the alias tables, rebuilding them if the MDP was modified
+        /// \param action
+        /// \param target_probability
+        /// \return Tuple with [next state, reward of current action, bool is_final]
+        std::tuple<State, Reward, bool> step_alias(const Action& action, Probability target_probability){
+            if(m_alias_revision != m_mdp->revision()){
+                m_alias_table.build(*m_mdp);
+                m_is_terminal.resize(m_mdp->num_states());
+                for(size_t idx = 0; idx != m_is_terminal.size(); ++idx){
+                    m_is_terminal[idx] = m_mdp->is_terminal_state(m_mdp->state_at(idx));
+                }
+                m_alias_revision = m_mdp->revision();
+            }
+
+            size_t action_id = ActionTraits<Action>::id(action);
+            if(!m_alias_table.has_transitions(m_last_state_index, action_id)){
+                throw std::range_error("Transition probability does not sum 1.0");
+            }
+
+            auto [next_index, reward] = m_alias_table.sample(m_last_state_index, action_id, target_probability);
+            m_last_state_index = next_index;
+            m_last_state = m_mdp->state_at(next_index);
+            return std::make_tuple(m_last_state, reward, static_cast<bool>(m_is_terminal[next_index]));
+        }
     };
 
 
+    /// Runs N independent episodes over the same MDP, stored as structure of arrays (state indices,
+    /// random engines, done flags, episode returns) so all of them advance in a single call to step().
+    /// Finished episodes are restarted automatically from an initial state. Transitions are sampled
+    /// with alias tables, so the MDP must provide the state indexing hooks.
+    /// \tparam MDP
+    template<class MDP>
+    class VectorMDPEnvironment {
+    public:
+        // DEFINITIONS
+        using State = typename MDP::State;
+        using Action = typename MDP::Action;
+        using Reward = typename MDP::Reward;
+        using Probability = typename MDP::Probability;
+
+        using RandomEngine = std::default_random_engine;
+
+        static_assert(detail::has_state_index<MDP>::value, "VectorMDPEnvironment requires an MDP with state indexing");
+
+        /// Create the environments with the given MDP
+        /// \param mdp
+        /// \param num_environments Amount of episodes that run in parallel
+        /// \param seed Seed for the random generators, use 0 for a random one
+        VectorMDPEnvironment(std::shared_ptr<MDP> mdp, size_t num_environments, RandomEngine::result_type seed = 0):
+        m_mdp(std::move(mdp)), m_random_distribution(0.0),
+        m_state_indices(num_environments, 0), m_rewards(num_environments), m_dones(num_environments, 0),
+        m_episode_returns(num_environments), m_episode_steps(num_environments, 0),
+        m_final_state_indices(num_environments, 0), m_completed_returns(num_environments),
+        m_completed_steps(num_environments, 0) {
+            // Each environment gets its own engine, seeded from a single source
+            RandomEngine seeder(seed == 0 ? std::random_device{}() : seed);
+            m_random_engines.reserve(num_environments);
+            for(size_t env = 0; env != num_environments; ++env){
+                m_random_engines.emplace_back(seeder());
+            }
+        }
+
+        /// Returns the number of environments
+        /// \return
+        [[nodiscard]]
+        size_t size() const { return m_state_indices.size(); }
+
+        /// Starts the episodes of all the environments
+        void start(){
+            update_model();
+            update_initial_states();
+            for(size_t env = 0; env != size(); ++env) reset_episode(env);
+        }
+
+        /// Starts a new episode in a single environment, discarding the current one
+        /// \param env
+        void start(size_t env){
+            update_model();
+            update_initial_states();
+            reset_episode(env);
+        }
+
+        /// Starts a new episode in a single environment from the initial states read by the last start,
+        /// discarding the current one. The MDP is not read again, so episodes can be cut while stepping.
+        /// \param env
+        void restart(size_t env){
+            if(m_initial_state_indices.empty()) throw std::logic_error("Environments have not been started");
+            reset_episode(env);
+        }
+
+        /// Makes a step in every environment, using actions[env] as the action of each one. Environments that
+        /// reach a terminal state are marked as done and restarted, the finished episode is available through
+        /// final_state_index, completed_returns and completed_steps.
+        /// \param actions
+        void step(boost::span<const Action> actions){
+            if(actions.size() != size()) throw std::invalid_argument("One action per environment is required");
+            if(m_initial_state_indices.empty()) throw std::logic_error("Environments have not been started");
+            update_model();
+
+            for(size_t env = 0; env != size(); ++env){
+                size_t action_id = ActionTraits<Action>::id(actions[env]);
+                if(!m_alias_table.has_transitions(m_state_indices[env], action_id)){
+                    throw std::range_error("Transition probability does not sum 1.0");
+                }
+
+                Probability target_probability = m_random_distribution(m_random_engines[env]);
+                auto [next_index, reward] = m_alias_table.sample(m_state_indices[env], action_id, target_probability);
+
+                m_rewards[env] = reward;
+                m_episode_returns[env] += reward;
+                ++m_episode_steps[env];
+                m_dones[env] = m_is_terminal[next_index];
+
+                if(m_dones[env]){
+                    // Keep the finished episode and start a new one
+                    m_final_state_indices[env] = next_index;
+                    m_completed_returns[env] = m_episode_returns[env];
+                    m_completed_steps[env] = m_episode_steps[env];
+                    reset_episode(env);
+                } else {
+                    m_state_indices[env] = next_index;
+                }
+            }
+        }
+
+        /// Returns the current state of an environment
+        /// \param env
+        /// \return
+        [[nodiscard]]
+        State state(size_t env) const { return m_mdp->state_at(m_state_indices[env]); }
+
+        /// Returns the terminal state reached by an environment in the last step, valid if it is done
+        /// \param env
+        /// \return
+        [[nodiscard]]
+        State final_state(size_t env) const { return m_mdp->state_at(m_final_state_indices[env]); }
+
+        /// Returns the current state index of every environment
+        /// \return
+        [[nodiscard]]
+        const std::vector<size_t>& state_indices() const { return m_state_indices; }
+
+        /// Returns the rewards obtained in the last step
+        /// \return
+        [[nodiscard]]
+        const std::vector<Reward>& rewards() const { return m_rewards; }
+
+        /// Returns 1 for the environments whose episode finished in the last step
+        /// \return
+        [[nodiscard]]
+        const std::vector<uint8_t>& dones() const { return m_dones; }
+
+        /// Returns the accumulated reward of the running episodes
+        /// \return
+        [[nodiscard]]
+        const std::vector<Reward>& episode_returns() const { return m_episode_returns; }
+
+        /// Returns the steps taken in the running episodes
+        /// \return
+        [[nodiscard]]
+        const std::vector<size_t>& episode_steps() const { return m_episode_steps; }
+
+        /// Returns the index of the terminal state reached by each environment, valid where done
+        /// \return
+        [[nodiscard]]
+        const std::vector<size_t>& final_state_indices() const { return m_final_state_indices; }
+
+        /// Returns the total reward of the last finished episode of each environment
+        /// \return
+        [[nodiscard]]
+        const std::vector<Reward>& completed_returns() const { return m_completed_returns; }
+
+        /// Returns the total steps of the last finished episode of each environment
+        /// \return
+        [[nodiscard]]
+        const std::vector<size_t>& completed_steps() const { return m_completed_steps; }
+
+    private:
+        std::shared_ptr<MDP> m_mdp;
+
+        // Cached model
+        AliasTable<Action, Reward, Probability> m_alias_table;
+        std::optional<size_t> m_alias_revision;
+        std::vector<uint8_t> m_is_terminal;
+        std::vector<size_t> m_initial_state_indices;
+
+        // Environments
+        std::vector<RandomEngine> m_random_engines;
+        std::uniform_real_distribution<Probability> m_random_distribution;
+        std::vector<size_t> m_state_indices;
+        std::vector<Reward> m_rewards;
+        std::vector<uint8_t> m_dones;
+        std::vector<Reward> m_episode_returns;
+        std::vector<size_t> m_episode_steps;
+
+        // Last finished episodes
+        std::vector<size_t> m_final_state_indices;
+        std::vector<Reward> m_completed_returns;
+        std::vector<size_t> m_completed_steps;
+
+        /// Rebuilds the alias tables and cached flags if the MDP was modified
+        void update_model(){
+            if(m_alias_revision == m_mdp->revision()) return;
+
+            m_alias_table.build(*m_mdp);
+            m_is_terminal.resize(m_mdp->num_states());
+            for(size_t idx = 0; idx != m_is_terminal.size(); ++idx){
+                m_is_terminal[idx] = m_mdp->is_terminal_state(m_mdp->state_at(idx));
+            }
+            m_alias_revision = m_mdp->revision();
+        }
+
+        /// Reads the initial states of the MDP, used when restarting finished episodes
+        void update_initial_states(){
+            m_initial_state_indices.clear();
+            for(const auto& s: m_mdp->get_initial_states()){
+                m_initial_state_indices.push_back(m_mdp->state_index(s));
+            }
+            if(m_initial_state_indices.empty()) throw std::invalid_argument("MDP has not initial states");
+        }
+
+        /// Places the environment in an initial state and clears the episode counters
+        /// \param env
+        void reset_episode(size_t env){
+            if(m_initial_state_indices.size() == 1){
+                m_state_indices[env] = m_initial_state_indices.front();
+            } else {
+                std::uniform_int_distribution<size_t> initial_distribution(0, m_initial_state_indices.size() - 1);
+                m_state_indices[env] = m_initial_state_indices[initial_distribution(m_random_engines[env])];
+            }
+
+            m_episode_returns[env] = Reward{};
+            m_episode_steps[env] = 0;
+        }
+    };
+
     /// Represents an experiment of an Agent traversing an Environment
     /// \tparam Environment
     /// \tparam Agent
@@ -330,6 +702,66 @@ namespace rl::mdp{
             return results;
         }
 
+        /// Performs episodes in a VectorMDPEnvironment until total_episodes have finished. agents[env] drives
+        /// environment env, so the agents must not be shared between environments. Episodes are cut at
+        /// max_steps like in do_episode.
+        /// \tparam VectorEnvironment
+        /// \param environment
+        /// \param agents One agent per environment
+        /// \param total_episodes
+        /// \return Results of the episodes in the order they finished
+        template<class VectorEnvironment>
+        std::vector<EpisodeResults> do_episodes(std::shared_ptr<VectorEnvironment> environment,
+                                                const std::vector<std::shared_ptr<Agent>>& agents,
+                                                size_t total_episodes){
+            if(agents.size() != environment->size())
+                throw std::invalid_argument("One agent per environment is required");
+
+            std::vector<EpisodeResults> results;
+            results.reserve(total_episodes);
+            if(total_episodes == 0 || agents.empty()) return results;
+
+            // Initialize environments
+            environment->start();
+            std::vector<Action> actions(agents.size());
+            for(size_t env = 0; env != agents.size(); ++env){
+                actions[env] = agents[env]->start(environment->state(env));
+            }
+
+            while(results.size() < total_episodes){
+                environment->step(actions);
+
+                const auto& rewards = environment->rewards();
+                const auto& dones = environment->dones();
+                for(size_t env = 0; env != agents.size(); ++env){
+                    EpisodeResults episode;
+                    if(dones[env]){
+                        // Environment has already been restarted
+                        agents[env]->end(rewards[env]);
+
+                        episode.last_state = environment->final_state(env);
+                        episode.total_reward = environment->completed_returns()[env];
+                        episode.total_steps = environment->completed_steps()[env];
+                        episode.reached_terminal_state = true;
+                    } else {
+                        actions[env] = agents[env]->step(rewards[env], environment->state(env));
+                        if(environment->episode_steps()[env] < m_max_steps) continue;
+
+                        // Maximum steps reached
+                        episode.last_state = environment->state(env);
+                        episode.total_reward = environment->episode_returns()[env];
+                        episode.total_steps = environment->episode_steps()[env];
+                        environment->restart(env);
+                    }
+
+                    if(results.size() < total_episodes) results.push_back(episode);
+                    actions[env] = agents[env]->start(environment->state(env));
+                }
+            }
+
+            return results;
+        }
+
         /// Default destructor
         virtual ~MDPExperiment() = default;
 
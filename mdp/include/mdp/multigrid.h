@@ -0,0 +1,269 @@
+#ifndef REINFORCEMENT_LEARNING_MULTIGRID_H
+#define REINFORCEMENT_LEARNING_MULTIGRID_H
+
+#include <mdp/mdp.h>
+#include <mdp/gridworld.h>
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+#include <array>
+#include <tuple>
+
+namespace rl::mdp {
+
+    /// Settings of BasicGridworldMultigridSolver
+    struct MultigridSettings {
+        /// Levels are coarsened while both dimensions are above min_size
+        size_t min_size{16};
+
+        /// Maximum amount of levels, including the original gridworld
+        std::optional<size_t> max_levels{};
+
+        /// Value iteration of every level stops once the largest change of a sweep is under epsilon
+        double epsilon{1e-6};
+
+        /// Maximum amount of sweeps of every level
+        size_t max_sweeps{100000};
+
+        /// Execution mode of the policies of every level, see BasicGridworldGreedyPolicy::set_execution_mode
+        ExecutionMode execution_mode{ExecutionMode::SEQUENTIAL};
+
+        /// Evaluation mode of the policies of every level, see BasicGridworldGreedyPolicy::set_evaluation_mode.
+        /// In-place sweeps from the terminals carry the values across the whole level in a single sweep, once
+        /// the warm start gives the greedy policy its final directions.
+        EvaluationMode evaluation_mode{EvaluationMode::GAUSS_SEIDEL};
+        SweepOrder sweep_order{SweepOrder::FROM_TERMINALS};
+    };
+
+    /// Solves a large Gridworld with value iteration from coarse to fine levels. Every level aggregates the 2x2
+    /// blocks of the previous one, so rewards travel twice as far per sweep. A coarse step stands for two fine
+    /// steps: it uses gamma^2 and (1 + gamma) times the rewards of the moves. Blocks are walls if at least half of
+    /// their cells are walls, so thin walls are kept, and terminal if any cell is terminal. Custom transitions
+    /// only exist in the original gridworld. The values of each level, interpolated between the centers of the
+    /// blocks, are the starting values of the next finer one, which only has to correct the approximation.
+    /// With Jacobi sweeps the corrections still travel one cell per sweep, so the default in-place sweeps from
+    /// the terminals save the most sweeps.
+    /// \tparam TReward
+    /// \tparam TProbability
+    template<class TReward = double, class TProbability = TReward>
+    class BasicGridworldMultigridSolver {
+    public:
+        using Gridworld = BasicGridworld<TReward, TProbability>;
+        using Policy = BasicGridworldGreedyPolicy<TReward, TProbability>;
+        using State = typename Gridworld::State;
+        using Reward = typename Gridworld::Reward;
+        using Duration = std::chrono::duration<double, std::milli>;
+
+        /// Statistics of the value iteration of a level
+        struct LevelStatistics {
+            size_t rows{0}, columns{0};
+            double gamma{0};
+            size_t sweeps{0};
+            double residual{std::numeric_limits<double>::infinity()};
+            Duration solve_time{};
+        };
+
+        /// Result of a solve
+        struct Result {
+            /// Greedy policy of the original gridworld, with its values
+            std::shared_ptr<Policy> policy;
+
+            /// Statistics of every level, from the coarsest to the original gridworld
+            std::vector<LevelStatistics> levels;
+
+            /// True if the value iteration of the original gridworld reached epsilon
+            bool converged{false};
+        };
+
+        /// Builds the coarse levels of a gridworld
+        /// \param gridworld
+        /// \param gamma
+        /// \param settings
+        BasicGridworldMultigridSolver(std::shared_ptr<Gridworld> gridworld, double gamma,
+                                      const MultigridSettings &settings = {})
+                : m_settings(settings) {
+            if (!gridworld) throw std::invalid_argument("Gridworld cannot be null");
+
+            m_levels.push_back(std::move(gridworld));
+            m_gammas.push_back(gamma);
+            while (m_levels.back()->get_rows() > m_settings.min_size &&
+                   m_levels.back()->get_columns() > m_settings.min_size &&
+                   (!m_settings.max_levels || m_levels.size() < m_settings.max_levels.value())) {
+                m_levels.push_back(coarsen(*m_levels.back(), m_gammas.back()));
+                m_gammas.push_back(m_gammas.back() * m_gammas.back());
+            }
+        }
+
+        /// Returns the gridworld of every level, starting from the original one
+        /// \return
+        [[nodiscard]]
+        const std::vector<std::shared_ptr<Gridworld>> &get_levels() const { return m_levels; }
+
+        /// Solves every level from the coarsest one, warm starting the finer levels
+        /// \return
+        Result solve() const {
+            Result result;
+            std::vector<Reward> values;
+
+            for (size_t level = m_levels.size(); level-- != 0;) {
+                const auto &gridworld = m_levels[level];
+                auto policy = std::make_shared<Policy>(gridworld, m_gammas[level]);
+                policy->set_execution_mode(m_settings.execution_mode);
+                policy->set_evaluation_mode(m_settings.evaluation_mode, m_settings.sweep_order);
+                if (!values.empty()) policy->set_value_function(prolongate(*m_levels[level + 1], *gridworld, values));
+
+                LevelStatistics statistics;
+                statistics.rows = gridworld->get_rows();
+                statistics.columns = gridworld->get_columns();
+                statistics.gamma = m_gammas[level];
+
+                // Value iteration, evaluating the greedy policy of the last values
+                auto start = Clock::now();
+                while (statistics.sweeps < m_settings.max_sweeps) {
+                    policy->update_policy();
+                    statistics.residual = policy->policy_evaluation();
+                    ++statistics.sweeps;
+                    if (statistics.residual < m_settings.epsilon) break;
+                }
+                policy->update_policy();
+                statistics.solve_time = Clock::now() - start;
+
+                values = policy->get_value_function();
+                result.levels.push_back(statistics);
+                result.policy = std::move(policy);
+            }
+            result.converged = result.levels.back().residual < m_settings.epsilon;
+
+            return result;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        MultigridSettings m_settings;
+        std::vector<std::shared_ptr<Gridworld>> m_levels;
+        std::vector<double> m_gammas;
+
+        /// Aggregates the 2x2 blocks of a gridworld
+        /// \param fine
+        /// \param gamma Discount of the fine level
+        /// \return
+        static std::shared_ptr<Gridworld> coarsen(const Gridworld &fine, double gamma) {
+            const size_t rows = (fine.get_rows() + 1) / 2, columns = (fine.get_columns() + 1) / 2;
+            const auto scale = static_cast<Reward>(1.0 + gamma);
+
+            auto coarse = std::make_shared<Gridworld>(rows, columns);
+            coarse->cost_of_living(scale * fine.get_cost_of_living());
+            coarse->bounds_penalty(scale * fine.get_bounds_penalty());
+
+            // Walls and terminals are set once the costs of living are set, as they use their own in-rewards
+            std::vector<std::pair<State, Reward>> walls, terminals;
+            for (size_t row = 0; row != rows; ++row) {
+                for (size_t column = 0; column != columns; ++column) {
+                    size_t cells = 0, wall_cells = 0, terminal_cells = 0;
+                    Reward wall_reward{}, terminal_reward{}, open_reward{};
+                    bool own_cost = false;
+
+                    for (size_t fine_row = 2 * row; fine_row != std::min(2 * row + 2, fine.get_rows()); ++fine_row) {
+                        for (size_t fine_column = 2 * column; fine_column != std::min(2 * column + 2, fine.get_columns()); ++fine_column) {
+                            State cell{fine_row, fine_column};
+                            Reward reward = fine.entry_reward(cell);
+                            ++cells;
+
+                            if (fine.is_wall_state(cell)) {
+                                ++wall_cells;
+                                wall_reward += reward;
+                            } else if (fine.is_terminal_state(cell)) {
+                                ++terminal_cells;
+                                terminal_reward += reward;
+                            } else {
+                                open_reward += reward;
+                                own_cost = own_cost || reward != fine.get_cost_of_living();
+                            }
+                        }
+                    }
+
+                    // Every coarse move stands for two fine moves, entering a terminal block is a move and the
+                    // terminal in-reward
+                    State state{row, column};
+                    if (terminal_cells != 0) {
+                        terminals.emplace_back(state, fine.get_cost_of_living() +
+                                                      static_cast<Reward>(gamma) * terminal_reward / static_cast<Reward>(terminal_cells));
+                    } else if (2 * wall_cells >= cells) {
+                        walls.emplace_back(state, scale * wall_reward / static_cast<Reward>(wall_cells));
+                    } else if (own_cost) {
+                        coarse->cost_of_living(state, scale * open_reward / static_cast<Reward>(cells - wall_cells));
+                    }
+                }
+            }
+
+            for (const auto &[state, reward]: walls) coarse->set_wall_state(state, reward);
+            for (const auto &[state, reward]: terminals) coarse->set_terminal_state(state, reward);
+
+            return coarse;
+        }
+
+        /// Interpolates the values of the coarse cells bilinearly between the centers of the blocks, skipping
+        /// coarse walls. Terminal blocks contribute their in-reward, as their own values are fixed, and terminal
+        /// cells keep a zero value.
+        /// \param coarse
+        /// \param fine
+        /// \param values Row-major values of the coarse level
+        /// \return Row-major values of the fine level
+        static std::vector<Reward> prolongate(const Gridworld &coarse, const Gridworld &fine,
+                                              const std::vector<Reward> &values) {
+            auto block_value = [&](const State &block) {
+                return coarse.is_terminal_state(block) ? coarse.entry_reward(block) : values[coarse.state_index(block)];
+            };
+
+            // Two closest block centers along one dimension and the weight of the first one
+            auto neighbours = [](size_t fine_position, size_t blocks) {
+                if (fine_position == 0) return std::make_tuple(size_t{0}, size_t{0}, 1.0);
+                size_t first = (fine_position - 1) / 2;
+                size_t second = std::min(first + 1, blocks - 1);
+                return std::make_tuple(first, second, fine_position % 2 == 0 ? 0.25 : 0.75);
+            };
+
+            std::vector<Reward> fine_values(fine.num_states(), Reward{});
+            for (size_t idx = 0; idx != fine.num_states(); ++idx) {
+                State cell = fine.state_at(idx);
+                if (fine.is_terminal_state(cell)) continue;
+
+                auto [row_0, row_1, row_weight] = neighbours(cell.row, coarse.get_rows());
+                auto [column_0, column_1, column_weight] = neighbours(cell.column, coarse.get_columns());
+                const std::array<std::pair<State, double>, 4> corners{{
+                        {{row_0, column_0}, row_weight * column_weight},
+                        {{row_0, column_1}, row_weight * (1.0 - column_weight)},
+                        {{row_1, column_0}, (1.0 - row_weight) * column_weight},
+                        {{row_1, column_1}, (1.0 - row_weight) * (1.0 - column_weight)}}};
+
+                double value = 0.0, total_weight = 0.0;
+                for (const auto &[block, weight]: corners) {
+                    if (weight == 0.0 || coarse.is_wall_state(block)) continue;
+                    value += weight * static_cast<double>(block_value(block));
+                    total_weight += weight;
+                }
+
+                // Cells surrounded by coarse walls use their own block
+                fine_values[idx] = total_weight > 0.0 ? static_cast<Reward>(value / total_weight) :
+                                   block_value(State{cell.row / 2, cell.column / 2});
+            }
+            return fine_values;
+        }
+    };
+
+    /// Multigrid solver for a Gridworld
+    using GridworldMultigridSolver = BasicGridworldMultigridSolver<double>;
+
+    /// Multigrid solver for a FloatGridworld
+    using FloatGridworldMultigridSolver = BasicGridworldMultigridSolver<float>;
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_MULTIGRID_H
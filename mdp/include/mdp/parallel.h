@@ -0,0 +1,98 @@
+#ifndef REINFORCEMENT_LEARNING_PARALLEL_H
+#define REINFORCEMENT_LEARNING_PARALLEL_H
+
+#include <cstddef>
+#include <utility>
+
+#ifdef MDP_USE_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/task_arena.h>
+#endif
+
+namespace rl::mdp::detail {
+
+    /// Calls func(begin_i, end_i) over consecutive blocks of [begin, end). The blocks run in parallel when the
+    /// library is built with TBB (MDP_USE_TBB) and sequentially otherwise, so func must only write to data
+    /// owned by its block.
+    /// \tparam Function
+    /// \param begin
+    /// \param end
+    /// \param grain_size Minimum size of a block
+    /// \param func
+    template<class Function>
+    void parallel_for(size_t begin, size_t end, size_t grain_size, Function &&func) {
+        if (begin >= end) return;
+#ifdef MDP_USE_TBB
+        tbb::parallel_for(tbb::blocked_range<size_t>(begin, end, grain_size),
+                          [&func](const tbb::blocked_range<size_t> &range) { func(range.begin(), range.end()); });
+#else
+        (void) grain_size;
+        func(begin, end);
+#endif
+    }
+
+    /// Reduces func(begin_i, end_i, init) over consecutive blocks of [begin, end), combining the partial results
+    /// with combine. Blocks run in parallel with TBB, so the result is only deterministic when combine is
+    /// associative and commutative (e.g. max or logical or).
+    /// \tparam T
+    /// \tparam Function
+    /// \tparam Combine
+    /// \param begin
+    /// \param end
+    /// \param grain_size Minimum size of a block
+    /// \param identity Neutral value of combine
+    /// \param func
+    /// \param combine
+    /// \return
+    template<class T, class Function, class Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain_size, T identity, Function &&func, Combine &&combine) {
+        if (begin >= end) return identity;
+#ifdef MDP_USE_TBB
+        return tbb::parallel_reduce(
+                tbb::blocked_range<size_t>(begin, end, grain_size), identity,
+                [&func](const tbb::blocked_range<size_t> &range, T init) { return func(range.begin(), range.end(), init); },
+                combine);
+#else
+        (void) grain_size;
+        (void) combine;
+        return func(begin, end, identity);
+#endif
+    }
+
+    /// Limits the threads used by the parallel algorithms called inside execute. Without TBB it just calls
+    /// the function.
+    class TaskArena {
+    public:
+        /// \param max_threads Maximum number of threads, 0 uses every available core
+        explicit TaskArena(size_t max_threads = 0)
+#ifdef MDP_USE_TBB
+                : m_arena(max_threads == 0 ? tbb::task_arena::automatic : static_cast<int>(max_threads))
+#endif
+        {
+            (void) max_threads;
+        }
+
+        /// Runs func inside the arena and returns its result
+        /// \tparam Function
+        /// \param func
+        /// \return
+        template<class Function>
+        auto execute(Function &&func) {
+#ifdef MDP_USE_TBB
+            return m_arena.execute(std::forward<Function>(func));
+#else
+            return func();
+#endif
+        }
+
+    private:
+#ifdef MDP_USE_TBB
+        tbb::task_arena m_arena;
+#endif
+    };
+
+} // namespace rl::mdp::detail
+
+#endif //REINFORCEMENT_LEARNING_PARALLEL_H
@@ -0,0 +1,110 @@
+#ifndef REINFORCEMENT_LEARNING_POLICY_ITERATION_H
+#define REINFORCEMENT_LEARNING_POLICY_ITERATION_H
+
+#include <mdp/mdp.h>
+
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+namespace rl::mdp {
+
+    /// Settings of PolicyIteration
+    struct PolicyIterationSettings {
+        /// Evaluation sweeps between improvement steps (k of modified policy iteration). 1 gives value iteration,
+        /// and larger values approach policy iteration with a full evaluation.
+        size_t evaluation_sweeps{10};
+
+        /// The evaluation of a policy stops early once a sweep changes the values less than epsilon. The policy
+        /// is converged when it is stable and its last sweep is under epsilon.
+        double epsilon{1e-6};
+
+        /// Maximum amount of improvement steps
+        size_t max_improvements{10000};
+    };
+
+    /// Alternates policy_evaluation and update_policy of a policy until it is stable. The policy keeps its value
+    /// table between the phases and between runs, so every evaluation is warm started from the previous one.
+    /// \tparam Policy Any policy with policy_evaluation, update_policy and num_states, e.g. GridworldGreedyPolicy
+    template<class Policy>
+    class PolicyIteration {
+    public:
+        using Duration = std::chrono::duration<double, std::milli>;
+
+        /// Work done by a phase
+        struct PhaseStatistics {
+            /// Sweeps over the states (evaluation sweeps or improvement steps)
+            size_t sweeps{0};
+
+            /// Single state backups of the sweeps. Every sweep visits all the states of the policy, so a sweep
+            /// counts num_states backups, including the terminal states that keep their value.
+            size_t backups{0};
+
+            Duration time{};
+        };
+
+        /// Result of a run
+        struct Result {
+            size_t improvements{0};
+
+            /// True if the policy is stable and its values converged
+            bool converged{false};
+
+            /// Largest change of the last evaluation sweep
+            double residual{std::numeric_limits<double>::infinity()};
+
+            PhaseStatistics evaluation, improvement;
+        };
+
+        /// \param policy Policy improved in place
+        /// \param settings
+        explicit PolicyIteration(Policy &policy, const PolicyIterationSettings &settings = {})
+                : m_policy(policy), m_settings(settings) {
+            if (m_settings.evaluation_sweeps == 0)
+                throw std::invalid_argument("At least one evaluation sweep per improvement is required");
+        }
+
+        /// Runs evaluation and improvement steps until the policy converges or max_improvements is reached
+        /// \return
+        Result run() {
+            Result result;
+
+            while (result.improvements < m_settings.max_improvements) {
+                // Evaluation, starting from the values of the previous policy
+                auto start = Clock::now();
+                for (size_t sweep = 0; sweep != m_settings.evaluation_sweeps; ++sweep) {
+                    result.residual = m_policy.policy_evaluation();
+                    ++result.evaluation.sweeps;
+                    if (result.residual < m_settings.epsilon) break;
+                }
+                result.evaluation.time += Clock::now() - start;
+
+                // Improvement
+                start = Clock::now();
+                bool policy_changed = m_policy.update_policy();
+                ++result.improvement.sweeps;
+                ++result.improvements;
+                result.improvement.time += Clock::now() - start;
+
+                if (!policy_changed && result.residual < m_settings.epsilon) {
+                    result.converged = true;
+                    break;
+                }
+            }
+
+            const size_t total_states = m_policy.num_states();
+            result.evaluation.backups = result.evaluation.sweeps * total_states;
+            result.improvement.backups = result.improvement.sweeps * total_states;
+            return result;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Policy &m_policy;
+        PolicyIterationSettings m_settings;
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_POLICY_ITERATION_H
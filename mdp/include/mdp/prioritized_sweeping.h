@@ -0,0 +1,213 @@
+#ifndef REINFORCEMENT_LEARNING_PRIORITIZED_SWEEPING_H
+#define REINFORCEMENT_LEARNING_PRIORITIZED_SWEEPING_H
+
+#include <mdp/mdp.h>
+#include <mdp/actions.h>
+#include <mdp/compiled_mdp.h>
+#include <mdp/sweep.h>
+
+#include <queue>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <cmath>
+#include <utility>
+
+namespace rl::mdp {
+
+    /// Settings of PrioritizedSweepingSolver
+    struct PrioritizedSweepingSettings {
+        /// States whose Bellman residual is not above theta are not queued. Once the queue is empty every residual
+        /// is at most theta.
+        double theta{1e-6};
+
+        /// Maximum amount of single state backups
+        std::optional<size_t> max_backups{};
+    };
+
+    /// Solves an MDP backing up one state at a time, always the one with the largest Bellman residual. After a
+    /// backup only the predecessors of the state can change, so only their residuals are computed again, using
+    /// a reverse-edge index of the compiled model. It converges to the same values as value iteration.
+    /// \tparam MDP Any MDP with ordered states, or a CompiledMDP
+    template<class MDP>
+    class PrioritizedSweepingSolver {
+    public:
+        using State = typename MDP::State;
+        using Action = typename MDP::Action;
+        using Reward = typename MDP::Reward;
+        using Probability = typename MDP::Probability;
+
+        using Compiled = CompiledMDP<State, Action, Reward, Probability>;
+        using Duration = std::chrono::duration<double, std::milli>;
+
+        /// Result of a solve, tables are indexed by the state indices of the compiled model
+        struct Result {
+            std::shared_ptr<const Compiled> model;
+
+            /// Value of every state
+            std::vector<Reward> values;
+
+            /// Greedy action of every state according to the final values. Terminal states and states without
+            /// actions keep the first action.
+            std::vector<Action> policy;
+
+            /// Single state backups done, and residuals computed to update the queue
+            size_t backups{0}, residual_updates{0};
+
+            /// True if the queue was emptied, false if max_backups was reached first
+            bool converged{false};
+
+            /// Time spent compiling the model and the index, and running the backups
+            Duration setup_time{}, solve_time{};
+
+            /// Returns the value of a state
+            /// \param state
+            /// \return
+            [[nodiscard]]
+            Reward value(const State& state) const { return values[model->state_index(state)]; }
+
+            /// Returns the greedy action of a state
+            /// \param state
+            /// \return
+            [[nodiscard]]
+            Action action(const State& state) const { return policy[model->state_index(state)]; }
+        };
+
+        /// Compiles the given MDP and builds its predecessor index
+        /// \param mdp
+        /// \param gamma
+        PrioritizedSweepingSolver(const MDP& mdp, double gamma) : m_gamma(gamma) {
+            auto start = Clock::now();
+            m_model = std::make_shared<const Compiled>(mdp);
+            m_predecessors = detail::predecessor_index(*m_model);
+            m_setup_time = Clock::now() - start;
+        }
+
+        /// Uses a model that is already compiled
+        /// \param compiled
+        /// \param gamma
+        PrioritizedSweepingSolver(std::shared_ptr<const Compiled> compiled, double gamma)
+                : m_model(std::move(compiled)), m_gamma(gamma) {
+            if (!m_model) throw std::invalid_argument("Compiled model cannot be null");
+
+            auto start = Clock::now();
+            m_predecessors = detail::predecessor_index(*m_model);
+            m_setup_time = Clock::now() - start;
+        }
+
+        /// Returns the compiled model used by the backups
+        /// \return
+        [[nodiscard]]
+        std::shared_ptr<const Compiled> get_model() const { return m_model; }
+
+        /// Runs prioritized sweeping from zero values
+        /// \param settings
+        /// \return
+        Result solve(const PrioritizedSweepingSettings& settings = {}) const {
+            return solve(std::vector<Reward>(m_model->num_states(), Reward{}), settings);
+        }
+
+        /// Runs prioritized sweeping from the given values
+        /// \param initial_values Values indexed by the compiled state indices
+        /// \param settings
+        /// \return
+        Result solve(std::vector<Reward> initial_values, const PrioritizedSweepingSettings& settings) const {
+            if (initial_values.size() != m_model->num_states())
+                throw std::invalid_argument("Initial values must have a value per state");
+
+            Result result;
+            result.model = m_model;
+            result.setup_time = m_setup_time;
+            result.values = std::move(initial_values);
+            result.policy.assign(m_model->num_states(), ActionTraits<Action>::from_id(0));
+
+            auto start = Clock::now();
+
+            // Max-heap of [priority, state]. Entries whose priority is not the current one of the state are stale.
+            std::vector<Reward> priorities(m_model->num_states(), Reward{});
+            std::priority_queue<std::pair<Reward, size_t>> queue;
+            auto update_priority = [&](size_t idx) {
+                ++result.residual_updates;
+                Reward residual = std::abs(best_backup(result.values, idx).first - result.values[idx]);
+                if (residual > settings.theta && residual != priorities[idx]) queue.emplace(residual, idx);
+                priorities[idx] = residual;
+            };
+
+            for (size_t idx = 0; idx != m_model->num_states(); ++idx) {
+                if (!m_model->is_terminal(idx)) update_priority(idx);
+            }
+
+            while (!queue.empty()) {
+                if (settings.max_backups && result.backups >= settings.max_backups.value()) break;
+
+                auto [priority, idx] = queue.top();
+                queue.pop();
+                if (priority != priorities[idx]) continue;
+
+                // Back up the state, only its own residual (through self transitions) and the ones of its
+                // predecessors change
+                result.values[idx] = best_backup(result.values, idx).first;
+                priorities[idx] = Reward{};
+                ++result.backups;
+
+                update_priority(idx);
+                m_predecessors.for_each(idx, update_priority);
+            }
+            result.converged = queue.empty();
+
+            // Greedy policy of the final values
+            for (size_t idx = 0; idx != m_model->num_states(); ++idx) {
+                if (m_model->is_terminal(idx)) continue;
+
+                size_t action_id = best_backup(result.values, idx).second;
+                if (action_id != m_model->num_actions()) result.policy[idx] = ActionTraits<Action>::from_id(action_id);
+            }
+            result.solve_time = Clock::now() - start;
+
+            return result;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        std::shared_ptr<const Compiled> m_model;
+        detail::PredecessorIndex m_predecessors;
+        Reward m_gamma;
+        Duration m_setup_time{};
+
+        /// Returns the value of the best action of a state and its id. States without actions keep their value
+        /// and return num_actions as the action id.
+        /// \param values
+        /// \param idx
+        /// \return
+        std::pair<Reward, size_t> best_backup(const std::vector<Reward>& values, size_t idx) const {
+            const size_t total_actions = m_model->num_actions();
+            Reward best_value = -std::numeric_limits<Reward>::infinity();
+            size_t best_action = total_actions;
+
+            for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                auto range = m_model->transitions(idx, action_id);
+                if (range.empty()) continue;
+
+                Reward value{};
+                for (size_t i = 0; i != range.size; ++i) {
+                    value += range.probabilities[i] * (range.rewards[i] + m_gamma * values[range.successors[i]]);
+                }
+
+                if (value > best_value) {
+                    best_value = value;
+                    best_action = action_id;
+                }
+            }
+
+            if (best_action == total_actions) return {values[idx], total_actions};
+            return {best_value, best_action};
+        }
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_PRIORITIZED_SWEEPING_H
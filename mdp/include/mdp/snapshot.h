@@ -0,0 +1,102 @@
+#ifndef REINFORCEMENT_LEARNING_SNAPSHOT_H
+#define REINFORCEMENT_LEARNING_SNAPSHOT_H
+
+#include <array>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace rl::mdp {
+
+    /// Header of the binary snapshot of a CompiledMDP. All the values are little-endian and every array
+    /// starts at a 64 byte aligned offset from the beginning of the file, so a mapped file can be used in place.
+    ///
+    /// Arrays, in file order:
+    /// - states: num_states State values (trivially copyable)
+    /// - state_order: num_states uint64, state ids sorted by state, used to look up state ids
+    /// - flags: num_states uint8, see SnapshotFlags
+    /// - offsets: num_states * num_actions + 1 uint64, CSR row offsets by (state id, action id)
+    /// - successors: num_transitions uint64
+    /// - rewards: num_transitions Reward values
+    /// - probabilities, cumulative: num_transitions Probability values each
+    struct SnapshotHeader {
+        static constexpr std::array<char, 8> MAGIC{'R', 'L', 'M', 'D', 'P', 'S', 'N', 'P'};
+        static constexpr uint32_t VERSION = 1;
+
+        std::array<char, 8> magic;
+        uint32_t version;
+
+        // Sizes of the stored types, checked when loading
+        uint32_t state_size, reward_size, probability_size;
+
+        uint64_t num_states, num_actions, num_transitions;
+
+        // Offsets of the arrays from the beginning of the file
+        uint64_t states, state_order, flags, offsets, successors, rewards, probabilities, cumulative;
+
+        // Total size of the file
+        uint64_t file_size;
+    };
+
+    /// Flags stored per state in a snapshot
+    enum SnapshotFlags : uint8_t {
+        SNAPSHOT_TERMINAL = 1,
+        SNAPSHOT_INITIAL = 2,
+        SNAPSHOT_WALL = 4
+    };
+
+    /// Read-only view of a whole file, memory mapped when the platform allows it
+    class MappedFile {
+    public:
+        /// Maps the given file, throws std::runtime_error if it cannot be opened
+        /// \param path
+        explicit MappedFile(const std::string& path);
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// Unmaps the file
+        ~MappedFile();
+
+        /// Returns the beginning of the file contents
+        /// \return
+        [[nodiscard]]
+        const std::byte* data() const noexcept { return m_data; }
+
+        /// Returns the size of the file
+        /// \return
+        [[nodiscard]]
+        size_t size() const noexcept { return m_size; }
+
+    private:
+        const std::byte* m_data{nullptr};
+        size_t m_size{0};
+
+        // Fallback storage when the file cannot be mapped
+        std::unique_ptr<std::byte[]> m_buffer;
+        bool m_mapped{false};
+    };
+
+    namespace detail {
+        /// Returns true when running on a little-endian platform
+        /// \return
+        inline bool is_little_endian() noexcept {
+            const uint16_t value = 1;
+            return *reinterpret_cast<const uint8_t*>(&value) == 1;
+        }
+
+        /// Alignment of the arrays in a snapshot
+        constexpr uint64_t SNAPSHOT_ALIGNMENT = 64;
+
+        /// Rounds an offset up to the snapshot alignment
+        /// \param offset
+        /// \return
+        constexpr uint64_t snapshot_align(uint64_t offset) noexcept {
+            return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+        }
+    } // namespace detail
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_SNAPSHOT_H
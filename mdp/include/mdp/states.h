@@ -0,0 +1,209 @@
+#ifndef REINFORCEMENT_LEARNING_STATES_H
+#define REINFORCEMENT_LEARNING_STATES_H
+
+#include <tuple>
+#include <limits>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+
+namespace rl::mdp {
+    /// Maps states to dense ids in the range [0, size()), so values can be stored in flat tables.
+    /// The generic indexer assigns a new id the first time a state is seen. Models with a natural layout
+    /// provide their own indexers with the same interface (e.g. GridworldStateIndexer), and expose
+    /// state_index/state_at/num_states hooks that use it.
+    /// \tparam StateType
+    template<class StateType, class Hash = std::hash<StateType>>
+    class StateIndexer {
+    public:
+        using State = StateType;
+
+        /// Returns the amount of states that have an id
+        /// \return
+        [[nodiscard]]
+        size_t size() const noexcept { return m_states.size(); }
+
+        /// Returns the id of the state, assigning a new one if it hasn't been seen
+        /// \param state
+        /// \return
+        size_t index(const State& state) {
+            auto [iter, inserted] = m_state_to_index.try_emplace(state, m_states.size());
+            if (inserted) m_states.push_back(state);
+            return iter->second;
+        }
+
+        /// Returns the id of the state, if it has been seen
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        std::optional<size_t> find(const State& state) const {
+            auto iter = m_state_to_index.find(state);
+            if (iter == m_state_to_index.end()) return std::nullopt;
+            return iter->second;
+        }
+
+        /// Returns the state with the given id
+        /// \param id
+        /// \return
+        [[nodiscard]]
+        const State& state(size_t id) const { return m_states[id]; }
+
+    private:
+        std::unordered_map<State, size_t, Hash> m_state_to_index;
+        std::vector<State> m_states;
+    };
+
+    /// Insert-only hash map from states to values using open addressing with linear probing. Entries are kept
+    /// densely in insertion order and the probing table only stores entry ids, so iteration is a vector walk and
+    /// a lookup touches a single cache line in the common case. Erasing is not supported.
+    /// Implements the subset of the std::unordered_map interface used by the state dictionaries of the models.
+    /// \tparam Key
+    /// \tparam Value
+    /// \tparam Hash
+    template<class Key, class Value, class Hash = std::hash<Key>>
+    class HashedStateMap {
+    public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key, Value>;
+        using hasher = Hash;
+        using iterator = typename std::vector<value_type>::iterator;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        explicit HashedStateMap(const Hash& hash = Hash()) : m_hash(hash) {}
+
+        [[nodiscard]]
+        size_t size() const noexcept { return m_entries.size(); }
+
+        [[nodiscard]]
+        bool empty() const noexcept { return m_entries.empty(); }
+
+        iterator begin() noexcept { return m_entries.begin(); }
+        iterator end() noexcept { return m_entries.end(); }
+        const_iterator begin() const noexcept { return m_entries.begin(); }
+        const_iterator end() const noexcept { return m_entries.end(); }
+
+        /// Prepares the map to hold the given amount of entries without rehashing
+        /// \param count
+        void reserve(size_t count) {
+            m_entries.reserve(count);
+            m_hashes.reserve(count);
+            if (count > capacity()) rehash(table_size_for(count));
+        }
+
+        /// Removes all the entries
+        void clear() noexcept {
+            m_entries.clear();
+            m_hashes.clear();
+            std::fill(m_slots.begin(), m_slots.end(), EMPTY_SLOT);
+        }
+
+        /// Finds the entry of a key
+        /// \param key
+        /// \return Iterator to the entry or end()
+        iterator find(const Key& key) {
+            size_t id = find_id(key, m_hash(key));
+            return id == EMPTY_SLOT ? end() : begin() + static_cast<std::ptrdiff_t>(id);
+        }
+
+        const_iterator find(const Key& key) const {
+            size_t id = find_id(key, m_hash(key));
+            return id == EMPTY_SLOT ? end() : begin() + static_cast<std::ptrdiff_t>(id);
+        }
+
+        /// Returns the value of a key, throws std::out_of_range if it is not in the map
+        /// \param key
+        /// \return
+        const Value& at(const Key& key) const {
+            auto iter = find(key);
+            if (iter == end()) throw std::out_of_range("State not found");
+            return iter->second;
+        }
+
+        Value& at(const Key& key) {
+            auto iter = find(key);
+            if (iter == end()) throw std::out_of_range("State not found");
+            return iter->second;
+        }
+
+        /// Inserts a new entry if the key is not in the map
+        /// \param key
+        /// \param args Arguments to construct the value
+        /// \return Pair with [iterator to the entry, true if inserted]
+        template<class... Args>
+        std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+            size_t hash = m_hash(key);
+            size_t id = find_id(key, hash);
+            if (id != EMPTY_SLOT) return {begin() + static_cast<std::ptrdiff_t>(id), false};
+
+            // Keep the load factor under 1/2
+            if (2 * (m_entries.size() + 1) > m_slots.size()) rehash(table_size_for(m_entries.size() + 1));
+
+            id = m_entries.size();
+            m_entries.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+            m_hashes.push_back(hash);
+            m_slots[free_slot(hash)] = id;
+            return {begin() + static_cast<std::ptrdiff_t>(id), true};
+        }
+
+        Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    private:
+        static constexpr size_t EMPTY_SLOT = std::numeric_limits<size_t>::max();
+
+        Hash m_hash;
+        std::vector<value_type> m_entries;
+        std::vector<size_t> m_hashes;   // Hash of every entry, to rehash without calling the hasher
+        std::vector<size_t> m_slots;    // Entry ids, size is a power of two
+
+        [[nodiscard]]
+        size_t capacity() const noexcept { return m_slots.size() / 2; }
+
+        /// Smallest power of two table that holds count entries under the maximum load factor
+        static size_t table_size_for(size_t count) {
+            size_t size = 16;
+            while (size < 2 * count) size *= 2;
+            return size;
+        }
+
+        /// Mixes the hash so identity hashes (e.g. integers) spread over the table
+        [[nodiscard]]
+        size_t home_slot(size_t hash) const noexcept {
+            uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+            return static_cast<size_t>(mixed ^ (mixed >> 32)) & (m_slots.size() - 1);
+        }
+
+        [[nodiscard]]
+        size_t find_id(const Key& key, size_t hash) const {
+            if (m_slots.empty()) return EMPTY_SLOT;
+
+            const size_t mask = m_slots.size() - 1;
+            for (size_t slot = home_slot(hash);; slot = (slot + 1) & mask) {
+                size_t id = m_slots[slot];
+                if (id == EMPTY_SLOT) return EMPTY_SLOT;
+                if (m_hashes[id] == hash && m_entries[id].first == key) return id;
+            }
+        }
+
+        [[nodiscard]]
+        size_t free_slot(size_t hash) const {
+            const size_t mask = m_slots.size() - 1;
+            size_t slot = home_slot(hash);
+            while (m_slots[slot] != EMPTY_SLOT) slot = (slot + 1) & mask;
+            return slot;
+        }
+
+        void rehash(size_t table_size) {
+            m_slots.assign(table_size, EMPTY_SLOT);
+            for (size_t id = 0; id != m_entries.size(); ++id) m_slots[free_slot(m_hashes[id])] = id;
+        }
+    };
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_STATES_H
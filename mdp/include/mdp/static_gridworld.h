@@ -0,0 +1,617 @@
+#ifndef REINFORCEMENT_LEARNING_STATIC_GRIDWORLD_H
+#define REINFORCEMENT_LEARNING_STATIC_GRIDWORLD_H
+
+#include <mdp/mdp.h>
+#include <mdp/actions.h>
+#include <mdp/gridworld.h>
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace rl::mdp {
+
+    /// Gridworld whose dimensions are known at compile time. The per-cell data is stored in std::array and the
+    /// neighbour of a cell is constexpr arithmetic, so default transitions need no runtime bounds checks.
+    /// It has the same dynamics and interface as Gridworld (walls, terminals, per-cell costs of living and
+    /// custom transitions), so it works with MDPEnvironment, CompiledMDP and the agents.
+    /// Large grids should be allocated on the heap (e.g. std::make_shared).
+    /// \tparam Rows
+    /// \tparam Columns
+    template<size_t Rows, size_t Columns>
+    class StaticGridworld : public MDP<GridworldState, GridworldAction> {
+    public:
+        static_assert(Rows > 0 && Columns > 0, "StaticGridworld needs at least one cell");
+
+        using Actions = ActionTraits<GridworldAction>;
+        static constexpr size_t TOTAL_STATES = Rows * Columns;
+        static constexpr size_t TOTAL_ACTIONS = Actions::total_actions();
+
+        StaticGridworld() {
+            m_state_flags.fill(0);
+            m_entry_rewards.fill(Reward{});
+        }
+
+        /// SETTINGS ///
+
+        /// Set cost of living parameter.
+        /// \param cost_of_living
+        void cost_of_living(Reward cost_of_living){ m_cost_of_living = cost_of_living; mark_modified(); }
+
+        /// Set the cost of living of moving into a single cell, used instead of the global one
+        /// \param state
+        /// \param cost_of_living
+        void cost_of_living(const State& state, Reward cost_of_living) {
+            if(!in_grid(state)) throw std::out_of_range("State must be inside the grid");
+            if(is_wall_state(state) || is_terminal_state(state))
+                throw std::invalid_argument("Wall and terminal states use their own in-reward");
+
+            set_entry_reward(state_index(state), cost_of_living);
+            mark_modified();
+        }
+
+        /// Set the out-of-bounds penalty
+        /// \param bounds_penalty
+        void bounds_penalty(Reward bounds_penalty){ m_bounds_penalty = bounds_penalty; mark_modified(); }
+
+        /// MDP ///
+
+        /// Returns the number of rows
+        /// \return
+        static constexpr size_t get_rows() { return Rows; }
+
+        /// Returns the number of columns
+        /// \return
+        static constexpr size_t get_columns() { return Columns; }
+
+        /// STATE INDEXING ///
+
+        /// Returns an indexer that maps cells to row-major ids
+        /// \return
+        [[nodiscard]]
+        GridworldStateIndexer state_indexer() const { return {Rows, Columns}; }
+
+        /// Returns the total amount of states
+        /// \return
+        static constexpr size_t num_states() { return TOTAL_STATES; }
+
+        /// Returns the dense id of a state
+        /// \param state
+        /// \return
+        static constexpr size_t state_index(const State& state) { return state.row * Columns + state.column; }
+
+        /// Returns the state with the given dense id
+        /// \param idx
+        /// \return
+        static State state_at(size_t idx) { return {idx / Columns, idx % Columns}; }
+
+        /// Returns the cell reached by moving from a cell with the given action, without walls or terminals
+        /// \param state_idx
+        /// \param action_id
+        /// \return
+        static constexpr size_t neighbour(size_t state_idx, size_t action_id) {
+            const size_t row = state_idx / Columns, column = state_idx % Columns;
+            switch(Actions::from_id(action_id)) {
+                case Action::LEFT: return column == 0 ? state_idx : state_idx - 1;
+                case Action::UP: return row == 0 ? state_idx : state_idx - Columns;
+                case Action::RIGHT: return column == Columns - 1 ? state_idx : state_idx + 1;
+                case Action::DOWN: return row == Rows - 1 ? state_idx : state_idx + Columns;
+            }
+            return state_idx;
+        }
+
+        /// Returns the transitions from a State-Action pair
+        /// \param state
+        /// \param action
+        /// \return
+        [[nodiscard]]
+        std::vector<StateRewardProbability> get_transitions(const State &state, const Action &action) const override {
+            std::vector<StateRewardProbability> transitions;
+            for_each_transition(state, action, [&transitions](const State& s_i, const Reward& r, const Probability& p){
+                transitions.emplace_back(s_i, r, p);
+            });
+            return transitions;
+        }
+
+        /// Calls visitor(next_state, reward, probability) for every transition of the State-Action pair,
+        /// without building a transitions list. Returning false from the visitor stops the visit.
+        /// \param state
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_transition(const State &state, const Action &action, Visitor&& visitor) const {
+            if(!in_grid(state)) throw std::out_of_range("State must be inside the grid");
+            for_each_indexed_transition(state_index(state), action,
+                                        [&visitor](size_t s_i, const Reward& r, const Probability& p){
+                return detail::visit_transition(visitor, state_at(s_i), r, p);
+            });
+        }
+
+        /// Same as for_each_transition, using dense state ids: visitor(next_state_id, reward, probability)
+        /// \param state_idx
+        /// \param action
+        /// \param visitor
+        template<class Visitor>
+        void for_each_indexed_transition(size_t state_idx, const Action &action, Visitor&& visitor) const {
+            const CustomCell* cell = find_cell(state_idx, Actions::id(action));
+            if(cell == nullptr){
+                auto [s_i, r] = default_transition(state_idx, Actions::id(action));
+                detail::visit_transition(visitor, s_i, r, Probability{1.0});
+                return;
+            }
+
+            for(const auto& [s_i, r, p]: cell->transitions){
+                if(!detail::visit_transition(visitor, s_i, r, p)) return;
+            }
+        }
+
+        /// Returns the default transition of a State-Action pair as [next state id, reward]
+        /// \param state_idx
+        /// \param action_id
+        /// \return
+        [[nodiscard]]
+        std::pair<size_t, Reward> default_transition(size_t state_idx, size_t action_id) const {
+            const uint8_t flags = m_state_flags[state_idx];
+
+            // Terminal states only return to themselves
+            if((flags & TERMINAL_STATE) != 0){
+                return {state_idx, (flags & ENTRY_REWARD) != 0 ? m_entry_rewards[state_idx] : Reward{}};
+            }
+
+            // Walls revert to the current state with their penalty
+            const size_t next_idx = neighbour(state_idx, action_id);
+            const uint8_t next_flags = m_state_flags[next_idx];
+            if((next_flags & WALL_STATE) != 0) return {state_idx, m_entry_rewards[next_idx]};
+
+            // Moving into the same cell means we are at the edge
+            if(next_idx == state_idx) return {state_idx, m_bounds_penalty};
+            return {next_idx, (next_flags & ENTRY_REWARD) != 0 ? m_entry_rewards[next_idx] : m_cost_of_living};
+        }
+
+        /// Returns true if the State-Action pair uses transitions added with add_transition
+        /// \param state_idx
+        /// \param action_id
+        /// \return
+        [[nodiscard]]
+        bool has_custom_transitions(size_t state_idx, size_t action_id) const {
+            return find_cell(state_idx, action_id) != nullptr;
+        }
+
+        /// Adds a transition with the given weight. The probabilities of the State-Action pair are normalised
+        /// so they sum 1 after every insertion.
+        /// \param state
+        /// \param action
+        /// \param new_state
+        /// \param reward
+        /// \param weight
+        void add_transition(const State &state,
+                            const Action &action,
+                            const State &new_state,
+                            const Reward &reward,
+                            const Probability &weight) override {
+            if(is_terminal_state(state)) throw std::invalid_argument("Adding transition to terminal state");
+            if(!in_grid(state) || !in_grid(new_state))
+                throw std::out_of_range("Transition states must be inside the grid");
+            if(weight < 0.0) throw std::invalid_argument("Transition weights cannot be negative");
+
+            CustomCell& cell = m_custom[cell_id(state_index(state), Actions::id(action))];
+            Probability total_weight = cell.total_weight + weight;
+            Probability scale = total_weight > 0.0 ? cell.total_weight / total_weight : 0.0;
+            for(auto& transition: cell.transitions) transition.probability *= scale;
+
+            cell.transitions.push_back({state_index(new_state), reward, total_weight > 0.0 ? weight / total_weight : 0.0});
+            cell.total_weight = total_weight;
+            mark_modified();
+        }
+
+        /// Returns the expected reward of the State-Action pair, 0 for default transitions as in Gridworld
+        /// \param state
+        /// \param action
+        /// \return
+        [[nodiscard]]
+        Reward expected_reward(const State &state, const Action &action) const override {
+            const CustomCell* cell = find_cell(state_index(state), Actions::id(action));
+            if(cell == nullptr) return 0.0;
+
+            Reward expected_reward{};
+            for(const auto& transition: cell->transitions) expected_reward += transition.reward * transition.probability;
+            return expected_reward;
+        }
+
+        /// Returns probability of going to a state from a state-action pair.
+        /// \param from_state
+        /// \param action
+        /// \param to_state
+        /// \return
+        [[nodiscard]]
+        Probability state_transition_probability(const State &from_state, const Action &action,
+                                                 const State &to_state) const override {
+            if(!in_grid(to_state)) return 0.0;
+
+            Probability probability{};
+            const size_t to_idx = state_index(to_state);
+            for_each_indexed_transition(state_index(from_state), action,
+                                        [to_idx, &probability](size_t s_i, const Reward&, const Probability& p){
+                if(s_i == to_idx) probability += p;
+            });
+            return probability;
+        }
+
+        /// Returns a vector with all the possible states that the MDP can contain.
+        /// \return
+        [[nodiscard]]
+        std::vector<State> get_states() const override {
+            std::vector<State> states;
+            states.reserve(TOTAL_STATES);
+            for(size_t idx = 0; idx != TOTAL_STATES; ++idx) states.push_back(state_at(idx));
+            return states;
+        }
+
+        /// Returns a list with the available actions for a given state.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        std::vector<Action> get_actions([[maybe_unused]] const State &state) const override {
+            const auto& actions = Actions::available_actions();
+            return {actions.begin(), actions.end()};
+        }
+
+        /// Marks a state as a terminal state. This makes all transitions out of this state to point to it again
+        /// with reward zero.
+        /// \param s_term State to mark as terminal
+        /// \param default_reward Reward to use as default in-reward
+        void set_terminal_state(const State& s_term, std::optional<Reward> default_reward) override {
+            if(is_initial_state(s_term) || is_wall_state(s_term))
+                throw std::invalid_argument("Initial or wall states cannot be marked as terminal");
+            if(is_terminal_state(s_term)) return;
+            if(!in_grid(s_term)) throw std::out_of_range("Terminal state must be inside the grid");
+
+            // The default transition of terminal states returns to the same state
+            const size_t term_idx = state_index(s_term);
+            for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id) m_custom.erase(cell_id(term_idx, action_id));
+            m_state_flags[term_idx] |= TERMINAL_STATE;
+
+            // Set in-reward as default reward for transitions coming to this state
+            if(default_reward){
+                set_entry_reward(term_idx, default_reward.value());
+                redirect_transitions(term_idx, default_reward.value(), [term_idx](size_t){ return term_idx; });
+            }
+            mark_modified();
+        }
+
+        /// Returns true if the given State is a terminal state.
+        /// \param s
+        /// \return
+        [[nodiscard]]
+        bool is_terminal_state(const State& s) const override { return has_flag(s, TERMINAL_STATE); }
+
+        /// Returns true if the state with the given dense id is a terminal state
+        /// \param state_idx
+        /// \return
+        [[nodiscard]]
+        bool is_terminal(size_t state_idx) const { return (m_state_flags[state_idx] & TERMINAL_STATE) != 0; }
+
+        /// Returns a list of the terminal states.
+        /// \return
+        [[nodiscard]]
+        std::vector<State> get_terminal_states() const override { return states_with_flag(TERMINAL_STATE); }
+
+        /// Sets the given state as an initial state
+        /// \param s
+        void set_initial_state(const State& s) override{
+            if(is_wall_state(s) || is_terminal_state(s))
+                throw std::invalid_argument("Terminal or wall states cannot be marked as initial");
+            if(!in_grid(s)) throw std::out_of_range("Initial state must be inside the grid");
+            m_state_flags[state_index(s)] |= INITIAL_STATE;
+        }
+
+        /// Returns if the given state is an initial state
+        /// \param s
+        /// \return
+        [[nodiscard]]
+        bool is_initial_state(const State& s) const override{ return has_flag(s, INITIAL_STATE); }
+
+        /// Returns a list with the initial states
+        /// \return
+        [[nodiscard]]
+        std::vector<State> get_initial_states() const override{ return states_with_flag(INITIAL_STATE); }
+
+        /// Sets a states as wall. Meaning all transitions to this revert to previous state with the given penalty.
+        /// \param wall
+        /// \param penalty
+        void set_wall_state(const State& wall, Reward penalty) {
+            if(is_terminal_state(wall) || is_initial_state(wall))
+                throw std::invalid_argument("Terminal states cannot be walls");
+            if(is_wall_state(wall)) return;
+            if(!in_grid(wall)) throw std::out_of_range("Wall state must be inside the grid");
+
+            const size_t wall_idx = state_index(wall);
+            m_state_flags[wall_idx] |= WALL_STATE;
+            set_entry_reward(wall_idx, penalty);
+
+            // Added transitions going to the wall also revert to the previous state
+            redirect_transitions(wall_idx, penalty, [](size_t source){ return source; });
+            mark_modified();
+        }
+
+        /// Returns true if the state is a Wall
+        /// \param s
+        /// \return
+        [[nodiscard]]
+        bool is_wall_state(const State& s) const { return has_flag(s, WALL_STATE); }
+
+        /// Returns a list with all states marked as walls
+        /// \return
+        [[nodiscard]]
+        std::vector<State> get_wall_states() const { return states_with_flag(WALL_STATE); }
+
+    private:
+        /// Transition added with add_transition, using the dense id of the next state
+        struct IndexedTransition {
+            size_t successor;
+            Reward reward;
+            Probability probability;
+        };
+
+        /// Custom transitions of a State-Action pair
+        struct CustomCell {
+            Probability total_weight{};
+            std::vector<IndexedTransition> transitions;
+        };
+
+        /// Flags stored per state
+        enum StateFlags : uint8_t {
+            WALL_STATE = 1,
+            TERMINAL_STATE = 2,
+            INITIAL_STATE = 4,
+            ENTRY_REWARD = 8    //< Moving into the state uses m_entry_rewards instead of the cost of living
+        };
+
+        std::array<uint8_t, TOTAL_STATES> m_state_flags;
+        std::array<Reward, TOTAL_STATES> m_entry_rewards;
+        Reward m_cost_of_living{}, m_bounds_penalty{-1};
+
+        // Custom transitions indexed by state_index * total_actions + action_id. Benchmark maps usually have none.
+        std::unordered_map<size_t, CustomCell> m_custom;
+
+        static constexpr bool in_grid(const State& s) { return s.row < Rows && s.column < Columns; }
+
+        static constexpr size_t cell_id(size_t state_idx, size_t action_id) {
+            return state_idx * TOTAL_ACTIONS + action_id;
+        }
+
+        [[nodiscard]]
+        bool has_flag(const State& s, StateFlags flag) const {
+            return in_grid(s) && (m_state_flags[state_index(s)] & flag) != 0;
+        }
+
+        [[nodiscard]]
+        const CustomCell* find_cell(size_t state_idx, size_t action_id) const {
+            if(m_custom.empty()) return nullptr;
+            auto iter = m_custom.find(cell_id(state_idx, action_id));
+            return iter == m_custom.end() || iter->second.transitions.empty() ? nullptr : &iter->second;
+        }
+
+        [[nodiscard]]
+        std::vector<State> states_with_flag(StateFlags flag) const {
+            std::vector<State> states;
+            for(size_t idx = 0; idx != TOTAL_STATES; ++idx){
+                if((m_state_flags[idx] & flag) != 0) states.push_back(state_at(idx));
+            }
+            return states;
+        }
+
+        void set_entry_reward(size_t state_idx, Reward reward) {
+            m_entry_rewards[state_idx] = reward;
+            m_state_flags[state_idx] |= ENTRY_REWARD;
+        }
+
+        /// Moves every custom transition going to target to the state given by redirect(source) with the given reward
+        template<class Redirect>
+        void redirect_transitions(size_t target, Reward reward, Redirect&& redirect) {
+            for(auto& [id, cell]: m_custom){
+                for(auto& transition: cell.transitions){
+                    if(transition.successor == target){
+                        transition.successor = redirect(id / TOTAL_ACTIONS);
+                        transition.reward = reward;
+                    }
+                }
+            }
+        }
+    };
+
+    /// Greedy policy for a StaticGridworld. The default transitions of the grid are kept in a per-(state, action)
+    /// stencil of successor ids and rewards with compile-time sizes, so the sweeps are fixed-length loops that the
+    /// compiler can unroll and vectorise. Pairs with custom transitions are evaluated through the model.
+    /// Values match GridworldGreedyPolicy on the same map. Large grids should be allocated on the heap.
+    /// \tparam Rows
+    /// \tparam Columns
+    template<size_t Rows, size_t Columns>
+    class StaticGridworldGreedyPolicy : public MDPPolicy<GridworldState, GridworldAction> {
+    public:
+        using Gridworld = StaticGridworld<Rows, Columns>;
+        using Actions = ActionTraits<GridworldAction>;
+        static constexpr size_t TOTAL_STATES = Gridworld::TOTAL_STATES;
+        static constexpr size_t TOTAL_ACTIONS = Gridworld::TOTAL_ACTIONS;
+
+        /// Creates an uniform policy for the gridworld
+        /// \param gridworld
+        /// \param gamma
+        StaticGridworldGreedyPolicy(std::shared_ptr<Gridworld> gridworld, double gamma)
+        : m_gridworld(std::move(gridworld)), m_gamma(gamma) {
+            m_value_function_table.fill(Reward{});
+            m_action_probabilities.fill(Probability{1} / static_cast<Probability>(TOTAL_ACTIONS));
+        }
+
+        /// Return the possible actions and its probabilities based on the current state.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        std::vector<ActionProbability> get_action_probabilities(const State &state) const override {
+            const size_t first = Gridworld::state_index(state) * TOTAL_ACTIONS;
+            std::vector<ActionProbability> action_probability;
+            action_probability.reserve(TOTAL_ACTIONS);
+            for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id){
+                action_probability.emplace_back(Actions::from_id(action_id), m_action_probabilities[first + action_id]);
+            }
+            return action_probability;
+        }
+
+        /// Returns the value function result given a state.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        Reward value_function(const State &state) const override {
+            return m_value_function_table[Gridworld::state_index(state)];
+        }
+
+        /// Returns the amount of states visited by every sweep of policy_evaluation and update_policy
+        /// \return
+        [[nodiscard]]
+        static constexpr size_t num_states() { return TOTAL_STATES; }
+
+        /// Returns the gridworld associated to the policy.
+        /// \return
+        [[nodiscard]]
+        std::shared_ptr<Gridworld> get_gridworld() const { return m_gridworld; }
+
+        /// Approximates the value function doing a single policy evaluation.
+        /// \return Largest change of the value function
+        double policy_evaluation() override {
+            update_stencil();
+
+            // Stencil sweep over every state, terminal states keep their value
+            for(size_t idx = 0; idx != TOTAL_STATES; ++idx){
+                Reward expected_value{};
+                for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id){
+                    const size_t k = idx * TOTAL_ACTIONS + action_id;
+                    expected_value += (m_rewards[k] + m_gamma * m_value_function_table[m_successors[k]])
+                            * m_action_probabilities[k];
+                }
+                m_next_value_function_table[idx] = m_terminal[idx] ? m_value_function_table[idx] : expected_value;
+            }
+
+            // States with custom transitions
+            for(size_t idx: m_custom_states){
+                Reward expected_value{};
+                for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id){
+                    Probability probability = m_action_probabilities[idx * TOTAL_ACTIONS + action_id];
+                    if(probability == 0.0) continue;
+                    expected_value += action_value(idx, action_id) * probability;
+                }
+                m_next_value_function_table[idx] = expected_value;
+            }
+
+            Reward delta{};
+            for(size_t idx = 0; idx != TOTAL_STATES; ++idx){
+                delta = std::max(delta, std::abs(m_value_function_table[idx] - m_next_value_function_table[idx]));
+                m_value_function_table[idx] = m_next_value_function_table[idx];
+            }
+
+            return delta;
+        }
+
+        /// Makes the policy greedy according to the value function
+        /// \return True if the policy changed
+        bool update_policy() override {
+            update_stencil();
+            bool policy_changed = false;
+
+            for(size_t idx = 0; idx != TOTAL_STATES; ++idx){
+                std::array<Reward, TOTAL_ACTIONS> action_values{};
+                for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id){
+                    action_values[action_id] = action_value(idx, action_id);
+                }
+
+                Reward best_action_reward = -std::numeric_limits<Reward>::infinity();
+                size_t best_actions = 0;
+                for(const Reward& value: action_values){
+                    if(value > best_action_reward){
+                        best_action_reward = value;
+                        best_actions = 1;
+                    } else if(value == best_action_reward){
+                        ++best_actions;
+                    }
+                }
+
+                Probability new_probability = 1.0 / static_cast<Probability>(best_actions);
+                for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id){
+                    Probability p = action_values[action_id] == best_action_reward ? new_probability : 0.0;
+                    Probability& current = m_action_probabilities[idx * TOTAL_ACTIONS + action_id];
+                    if(current != p){
+                        current = p;
+                        policy_changed = true;
+                    }
+                }
+            }
+
+            return policy_changed;
+        }
+
+    private:
+        std::shared_ptr<Gridworld> m_gridworld;
+        double m_gamma;
+
+        std::array<Reward, TOTAL_STATES> m_value_function_table, m_next_value_function_table;
+        std::array<Probability, TOTAL_STATES * TOTAL_ACTIONS> m_action_probabilities;
+
+        // Default transitions as [successor id, reward] per (state, action), rebuilt when the model changes
+        std::array<uint32_t, TOTAL_STATES * TOTAL_ACTIONS> m_successors;
+        std::array<Reward, TOTAL_STATES * TOTAL_ACTIONS> m_rewards;
+        std::array<bool, TOTAL_STATES> m_terminal, m_custom;
+        std::vector<size_t> m_custom_states;
+        std::optional<size_t> m_stencil_revision;
+
+        static_assert(TOTAL_STATES <= std::numeric_limits<uint32_t>::max(), "Too many states for the stencil");
+
+        /// Rebuilds the stencil if the gridworld changed since the last sweep
+        void update_stencil() {
+            if(m_stencil_revision == m_gridworld->revision()) return;
+
+            m_custom_states.clear();
+            for(size_t idx = 0; idx != TOTAL_STATES; ++idx){
+                m_terminal[idx] = m_gridworld->is_terminal(idx);
+                m_custom[idx] = false;
+                for(size_t action_id = 0; action_id != TOTAL_ACTIONS; ++action_id){
+                    const size_t k = idx * TOTAL_ACTIONS + action_id;
+                    if(m_gridworld->has_custom_transitions(idx, action_id)){
+                        m_custom[idx] = true;
+                        m_successors[k] = static_cast<uint32_t>(idx);
+                        m_rewards[k] = Reward{};
+                    } else {
+                        auto [successor, reward] = m_gridworld->default_transition(idx, action_id);
+                        m_successors[k] = static_cast<uint32_t>(successor);
+                        m_rewards[k] = reward;
+                    }
+                }
+                if(m_custom[idx]) m_custom_states.push_back(idx);
+            }
+
+            m_stencil_revision = m_gridworld->revision();
+        }
+
+        /// Returns the expected return of taking an action in a state according to the value function table
+        [[nodiscard]]
+        Reward action_value(size_t state_idx, size_t action_id) const {
+            if(!m_custom[state_idx] || !m_gridworld->has_custom_transitions(state_idx, action_id)){
+                const size_t k = state_idx * TOTAL_ACTIONS + action_id;
+                return m_rewards[k] + m_gamma * m_value_function_table[m_successors[k]];
+            }
+
+            Reward value{};
+            m_gridworld->for_each_indexed_transition(state_idx, Actions::from_id(action_id),
+                                                     [this, &value](size_t s_i, const Reward& r, const Probability& p){
+                value += p * (r + m_gamma * m_value_function_table[s_i]);
+            });
+            return value;
+        }
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_STATIC_GRIDWORLD_H
@@ -0,0 +1,161 @@
+#ifndef REINFORCEMENT_LEARNING_STENCIL_H
+#define REINFORCEMENT_LEARNING_STENCIL_H
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define MDP_STENCIL_SSE2
+#endif
+
+namespace rl::mdp::detail {
+
+    /// Backs up a run of grid cells whose four actions (LEFT, UP, RIGHT, DOWN in action id order) move to the
+    /// neighbouring cell with the same reward:
+    ///     new_values[i] = sum_a (reward + gamma * values[neighbour_a(i)]) * probabilities[4 * i + a]
+    /// for i in [begin, begin + count). The cells must not be on the border of the grid. Products are added in
+    /// action id order, so the results are the same as backing up each cell through its transitions.
+    /// \tparam T
+    /// \param values Row-major value table
+    /// \param columns
+    /// \param probabilities Action probabilities indexed by cell * 4 + action id
+    /// \param reward
+    /// \param gamma
+    /// \param begin First cell of the run
+    /// \param count
+    /// \param new_values
+    /// \return Largest absolute change of the run
+    template<class T>
+    T stencil_backup_scalar(const T *values, size_t columns, const T *probabilities, T reward, T gamma,
+                            size_t begin, size_t count, T *new_values) {
+        T delta{};
+        for (size_t i = begin; i != begin + count; ++i) {
+            const T *p = probabilities + 4 * i;
+            T value{};
+            value += (reward + gamma * values[i - 1]) * p[0];
+            value += (reward + gamma * values[i - columns]) * p[1];
+            value += (reward + gamma * values[i + 1]) * p[2];
+            value += (reward + gamma * values[i + columns]) * p[3];
+
+            new_values[i] = value;
+            delta = std::max(delta, std::abs(values[i] - value));
+        }
+        return delta;
+    }
+
+    /// See stencil_backup_scalar, uses SSE/AVX when available
+    template<class T>
+    T stencil_backup(const T *values, size_t columns, const T *probabilities, T reward, T gamma,
+                     size_t begin, size_t count, T *new_values) {
+        return stencil_backup_scalar(values, columns, probabilities, reward, gamma, begin, count, new_values);
+    }
+
+#ifdef MDP_STENCIL_SSE2
+    /// Double precision, 4 cells per step with AVX and 2 with SSE2
+    template<>
+    inline double stencil_backup<double>(const double *values, size_t columns, const double *probabilities,
+                                         double reward, double gamma, size_t begin, size_t count,
+                                         double *new_values) {
+        size_t i = begin;
+        const size_t end = begin + count;
+        double delta = 0.0;
+
+#ifdef __AVX__
+        const __m256d r4 = _mm256_set1_pd(reward), g4 = _mm256_set1_pd(gamma);
+        const __m256d abs_mask4 = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+        __m256d delta4 = _mm256_setzero_pd();
+        for (; i + 4 <= end; i += 4) {
+            // Transpose the probabilities of 4 cells into one vector per action
+            __m256d c0 = _mm256_loadu_pd(probabilities + 4 * i);
+            __m256d c1 = _mm256_loadu_pd(probabilities + 4 * i + 4);
+            __m256d c2 = _mm256_loadu_pd(probabilities + 4 * i + 8);
+            __m256d c3 = _mm256_loadu_pd(probabilities + 4 * i + 12);
+            __m256d t0 = _mm256_unpacklo_pd(c0, c1), t1 = _mm256_unpackhi_pd(c0, c1);
+            __m256d t2 = _mm256_unpacklo_pd(c2, c3), t3 = _mm256_unpackhi_pd(c2, c3);
+            __m256d p0 = _mm256_permute2f128_pd(t0, t2, 0x20), p1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+            __m256d p2 = _mm256_permute2f128_pd(t0, t2, 0x31), p3 = _mm256_permute2f128_pd(t1, t3, 0x31);
+
+            __m256d value = _mm256_setzero_pd();
+            value = _mm256_add_pd(value, _mm256_mul_pd(_mm256_add_pd(r4, _mm256_mul_pd(g4, _mm256_loadu_pd(values + i - 1))), p0));
+            value = _mm256_add_pd(value, _mm256_mul_pd(_mm256_add_pd(r4, _mm256_mul_pd(g4, _mm256_loadu_pd(values + i - columns))), p1));
+            value = _mm256_add_pd(value, _mm256_mul_pd(_mm256_add_pd(r4, _mm256_mul_pd(g4, _mm256_loadu_pd(values + i + 1))), p2));
+            value = _mm256_add_pd(value, _mm256_mul_pd(_mm256_add_pd(r4, _mm256_mul_pd(g4, _mm256_loadu_pd(values + i + columns))), p3));
+
+            _mm256_storeu_pd(new_values + i, value);
+            __m256d change = _mm256_and_pd(_mm256_sub_pd(_mm256_loadu_pd(values + i), value), abs_mask4);
+            delta4 = _mm256_max_pd(delta4, change);
+        }
+
+        alignas(32) double lanes4[4];
+        _mm256_store_pd(lanes4, delta4);
+        delta = std::max({delta, lanes4[0], lanes4[1], lanes4[2], lanes4[3]});
+#endif
+
+        const __m128d r2 = _mm_set1_pd(reward), g2 = _mm_set1_pd(gamma);
+        const __m128d abs_mask2 = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+        __m128d delta2 = _mm_setzero_pd();
+        for (; i + 2 <= end; i += 2) {
+            // Cell i has actions [0, 1] in c0 and [2, 3] in c1, cell i + 1 in c2 and c3
+            __m128d c0 = _mm_loadu_pd(probabilities + 4 * i), c1 = _mm_loadu_pd(probabilities + 4 * i + 2);
+            __m128d c2 = _mm_loadu_pd(probabilities + 4 * i + 4), c3 = _mm_loadu_pd(probabilities + 4 * i + 6);
+            __m128d p0 = _mm_unpacklo_pd(c0, c2), p1 = _mm_unpackhi_pd(c0, c2);
+            __m128d p2 = _mm_unpacklo_pd(c1, c3), p3 = _mm_unpackhi_pd(c1, c3);
+
+            __m128d value = _mm_setzero_pd();
+            value = _mm_add_pd(value, _mm_mul_pd(_mm_add_pd(r2, _mm_mul_pd(g2, _mm_loadu_pd(values + i - 1))), p0));
+            value = _mm_add_pd(value, _mm_mul_pd(_mm_add_pd(r2, _mm_mul_pd(g2, _mm_loadu_pd(values + i - columns))), p1));
+            value = _mm_add_pd(value, _mm_mul_pd(_mm_add_pd(r2, _mm_mul_pd(g2, _mm_loadu_pd(values + i + 1))), p2));
+            value = _mm_add_pd(value, _mm_mul_pd(_mm_add_pd(r2, _mm_mul_pd(g2, _mm_loadu_pd(values + i + columns))), p3));
+
+            _mm_storeu_pd(new_values + i, value);
+            __m128d change = _mm_and_pd(_mm_sub_pd(_mm_loadu_pd(values + i), value), abs_mask2);
+            delta2 = _mm_max_pd(delta2, change);
+        }
+
+        alignas(16) double lanes2[2];
+        _mm_store_pd(lanes2, delta2);
+        delta = std::max({delta, lanes2[0], lanes2[1]});
+
+        return std::max(delta, stencil_backup_scalar(values, columns, probabilities, reward, gamma, i, end - i, new_values));
+    }
+
+    /// Single precision, 4 cells per step
+    template<>
+    inline float stencil_backup<float>(const float *values, size_t columns, const float *probabilities,
+                                       float reward, float gamma, size_t begin, size_t count, float *new_values) {
+        size_t i = begin;
+        const size_t end = begin + count;
+
+        const __m128 r4 = _mm_set1_ps(reward), g4 = _mm_set1_ps(gamma);
+        const __m128 abs_mask4 = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 delta4 = _mm_setzero_ps();
+        for (; i + 4 <= end; i += 4) {
+            // Transpose the probabilities of 4 cells into one vector per action
+            __m128 p0 = _mm_loadu_ps(probabilities + 4 * i), p1 = _mm_loadu_ps(probabilities + 4 * i + 4);
+            __m128 p2 = _mm_loadu_ps(probabilities + 4 * i + 8), p3 = _mm_loadu_ps(probabilities + 4 * i + 12);
+            _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+            __m128 value = _mm_setzero_ps();
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_add_ps(r4, _mm_mul_ps(g4, _mm_loadu_ps(values + i - 1))), p0));
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_add_ps(r4, _mm_mul_ps(g4, _mm_loadu_ps(values + i - columns))), p1));
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_add_ps(r4, _mm_mul_ps(g4, _mm_loadu_ps(values + i + 1))), p2));
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_add_ps(r4, _mm_mul_ps(g4, _mm_loadu_ps(values + i + columns))), p3));
+
+            _mm_storeu_ps(new_values + i, value);
+            __m128 change = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(values + i), value), abs_mask4);
+            delta4 = _mm_max_ps(delta4, change);
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, delta4);
+        float delta = std::max({lanes[0], lanes[1], lanes[2], lanes[3]});
+
+        return std::max(delta, stencil_backup_scalar(values, columns, probabilities, reward, gamma, i, end - i, new_values));
+    }
+#endif
+
+} // namespace rl::mdp::detail
+
+#endif //REINFORCEMENT_LEARNING_STENCIL_H
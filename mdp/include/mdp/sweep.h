@@ -0,0 +1,183 @@
+#ifndef REINFORCEMENT_LEARNING_SWEEP_H
+#define REINFORCEMENT_LEARNING_SWEEP_H
+
+#include <mdp/mdp.h>
+
+#include <vector>
+#include <cmath>
+#include <numeric>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+
+namespace rl::mdp::detail {
+
+    /// Predecessors of every state in CSR form: the states with a transition into state s are
+    /// predecessors[offsets[s]], ..., predecessors[offsets[s + 1] - 1], without repetitions nor s itself
+    struct PredecessorIndex {
+        std::vector<size_t> offsets;
+        std::vector<size_t> predecessors;
+
+        /// Calls func(predecessor) for every predecessor of a state
+        /// \tparam Function
+        /// \param state
+        /// \param func
+        template<class Function>
+        void for_each(size_t state, Function &&func) const {
+            for (size_t i = offsets[state]; i != offsets[state + 1]; ++i) func(predecessors[i]);
+        }
+    };
+
+    /// Builds the reverse-edge index of a model. Terminal states are not predecessors of any state, as their
+    /// transitions only return to themselves.
+    /// \tparam Model MDP with the state indexing hooks and for_each_indexed_transition
+    /// \param model
+    /// \return
+    template<class Model>
+    PredecessorIndex predecessor_index(const Model &model) {
+        const size_t total_states = model.num_states();
+
+        // Edges as [successor, predecessor] pairs
+        std::vector<std::pair<size_t, size_t>> edges;
+        for (size_t idx = 0; idx != total_states; ++idx) {
+            const auto &state = model.state_at(idx);
+            if (model.is_terminal_state(state)) continue;
+
+            const size_t first_edge = edges.size();
+            for (const auto &action: model.get_actions(state)) {
+                model.for_each_indexed_transition(idx, action, [&edges, idx](size_t s_i, const auto &, const auto &p) {
+                    if (s_i != idx && p > 0) edges.emplace_back(s_i, idx);
+                });
+            }
+
+            // Several actions usually reach the same successor
+            std::sort(edges.begin() + static_cast<std::ptrdiff_t>(first_edge), edges.end());
+            edges.erase(std::unique(edges.begin() + static_cast<std::ptrdiff_t>(first_edge), edges.end()), edges.end());
+        }
+
+        PredecessorIndex index;
+        index.offsets.assign(total_states + 1, 0);
+        for (const auto &edge: edges) ++index.offsets[edge.first + 1];
+        std::partial_sum(index.offsets.begin(), index.offsets.end(), index.offsets.begin());
+
+        index.predecessors.resize(edges.size());
+        std::vector<size_t> cursors(index.offsets.begin(), index.offsets.end() - 1);
+        for (const auto &[successor, predecessor]: edges) index.predecessors[cursors[successor]++] = predecessor;
+
+        return index;
+    }
+
+    /// Tracks the states whose greedy actions may have changed since the last policy improvement. The action
+    /// values of a state only depend on the values of its successors, so these are the states whose value moved
+    /// more than a tolerance from the value used by the last improvement, and their predecessors.
+    /// \tparam Value
+    template<class Value>
+    class DirtyStates {
+    public:
+        /// Returns true if the values of an improvement of every state are stored for the model revision
+        /// \param revision
+        /// \return
+        [[nodiscard]]
+        bool is_tracking(size_t revision) const { return m_revision == revision; }
+
+        /// Forgets the stored values, e.g. after the states were improved without the tracker
+        void reset() {
+            m_revision.reset();
+            m_predecessor_revision.reset();
+        }
+
+        /// Stores the values used by an improvement of every state
+        /// \tparam Model MDP with the state indexing hooks and for_each_indexed_transition
+        /// \param model
+        /// \param revision Revision of the model
+        /// \param values
+        template<class Model>
+        void track(const Model &model, size_t revision, const std::vector<Value> &values) {
+            if (m_predecessor_revision != revision) {
+                m_predecessors = predecessor_index(model);
+                m_predecessor_revision = revision;
+            }
+            m_values = values;
+            m_flags.assign(values.size(), 0);
+            m_revision = revision;
+        }
+
+        /// Returns the states to improve, storing the values that made them dirty
+        /// \param values
+        /// \param tolerance Changes up to tolerance are ignored, they add up until they exceed it
+        /// \return States without repetitions
+        const std::vector<size_t> &collect(const std::vector<Value> &values, double tolerance) {
+            auto mark = [this](size_t idx) {
+                if (m_flags[idx]) return;
+                m_flags[idx] = 1;
+                m_states.push_back(idx);
+            };
+
+            m_states.clear();
+            for (size_t idx = 0; idx != values.size(); ++idx) {
+                if (static_cast<double>(std::abs(values[idx] - m_values[idx])) <= tolerance) continue;
+
+                m_values[idx] = values[idx];
+                mark(idx);
+                m_predecessors.for_each(idx, mark);
+            }
+
+            for (size_t idx: m_states) m_flags[idx] = 0;
+            return m_states;
+        }
+
+    private:
+        std::optional<size_t> m_revision, m_predecessor_revision;
+        PredecessorIndex m_predecessors;
+        std::vector<Value> m_values;
+        std::vector<uint8_t> m_flags;
+        std::vector<size_t> m_states;
+    };
+
+    /// Returns the dense state ids of a model in the given sweep order. FROM_TERMINALS visits the states breadth
+    /// first from the terminal states, following the transitions backwards, and leaves the states that cannot
+    /// reach a terminal state at the end in id order.
+    /// \tparam Model MDP with the state indexing hooks and for_each_indexed_transition
+    /// \param model
+    /// \param order
+    /// \return
+    template<class Model>
+    std::vector<size_t> sweep_order(const Model &model, SweepOrder order) {
+        const size_t total_states = model.num_states();
+        std::vector<size_t> states(total_states);
+
+        if (order != SweepOrder::FROM_TERMINALS) {
+            std::iota(states.begin(), states.end(), size_t{0});
+            if (order == SweepOrder::REVERSE) std::reverse(states.begin(), states.end());
+            return states;
+        }
+
+        // Breadth first search from the terminal states
+        PredecessorIndex index = predecessor_index(model);
+        std::vector<uint8_t> visited(total_states, 0);
+        states.clear();
+        for (size_t idx = 0; idx != total_states; ++idx) {
+            if (!model.is_terminal_state(model.state_at(idx))) continue;
+            visited[idx] = 1;
+            states.push_back(idx);
+        }
+
+        for (size_t head = 0; head != states.size(); ++head) {
+            index.for_each(states[head], [&](size_t predecessor) {
+                if (visited[predecessor]) return;
+                visited[predecessor] = 1;
+                states.push_back(predecessor);
+            });
+        }
+
+        // States without a path to a terminal state
+        for (size_t idx = 0; idx != total_states; ++idx) {
+            if (!visited[idx]) states.push_back(idx);
+        }
+
+        return states;
+    }
+
+} // namespace rl::mdp::detail
+
+#endif //REINFORCEMENT_LEARNING_SWEEP_H
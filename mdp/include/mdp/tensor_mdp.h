@@ -0,0 +1,269 @@
+#ifndef REINFORCEMENT_LEARNING_TENSOR_MDP_H
+#define REINFORCEMENT_LEARNING_TENSOR_MDP_H
+
+#include <mdp/mdp.h>
+#include <mdp/actions.h>
+
+// xtensor 0.26 moved the headers into subdirectories
+#if __has_include(<xtensor/containers/xtensor.hpp>)
+#include <xtensor/containers/xtensor.hpp>
+#include <xtensor/core/xmath.hpp>
+#else
+#include <xtensor/xtensor.hpp>
+#include <xtensor/xmath.hpp>
+#endif
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+namespace rl::mdp {
+
+    /// Dense export of the dynamics of an MDP for matrix-form Bellman updates. With S states and A actions it
+    /// holds the transition tensor P(s, a, s') with shape (S, A, S) and the expected reward tensor R(s, a) with
+    /// shape (S, A). Memory grows with S * S * A, so it is meant for small and medium MDPs.
+    /// States are indexed in the order returned by get_states() and actions use ActionTraits<TAction>::id.
+    /// Probabilities are normalised so they sum 1.0 for every available State-Action pair. Terminal states have
+    /// no available actions, so their rows of P and R are zero.
+    /// \tparam TState
+    /// \tparam TAction
+    template<class TState, class TAction>
+    class TensorMDP {
+    public:
+        using State = TState;
+        using Action = TAction;
+        using Actions = ActionTraits<TAction>;
+        using StateIndex = size_t;
+
+        /// Exports the given MDP
+        /// \param mdp
+        template<class Model, std::enable_if_t<std::is_base_of_v<
+                MDP<TState, TAction, typename Model::Reward, typename Model::Probability>, Model>, int> = 0>
+        explicit TensorMDP(const Model& mdp) : m_states(mdp.get_states()) {
+            const size_t total_states = m_states.size();
+            const size_t total_actions = Actions::total_actions();
+
+            m_state_order.resize(total_states);
+            std::iota(m_state_order.begin(), m_state_order.end(), StateIndex{0});
+            std::sort(m_state_order.begin(), m_state_order.end(),
+                      [this](StateIndex a, StateIndex b) { return m_states[a] < m_states[b]; });
+
+            m_transitions = xt::zeros<double>({total_states, total_actions, total_states});
+            m_rewards = xt::zeros<double>({total_states, total_actions});
+            m_available = xt::zeros<bool>({total_states, total_actions});
+            m_terminal = xt::zeros<bool>({total_states});
+
+            for (StateIndex idx = 0; idx != total_states; ++idx) {
+                const State& state = m_states[idx];
+                if (mdp.is_terminal_state(state)) {
+                    m_terminal(idx) = true;
+                    continue;
+                }
+
+                for (const auto& action: mdp.get_actions(state)) {
+                    const size_t action_id = Actions::id(action);
+                    auto srp_list = mdp.get_transitions(state, action);
+                    double total_probability = 0.0;
+                    for (const auto& srp: srp_list) total_probability += static_cast<double>(std::get<2>(srp));
+                    if (srp_list.empty() || total_probability <= 0.0) continue;
+
+                    m_available(idx, action_id) = true;
+                    for (const auto& [s_i, r, p]: srp_list) {
+                        double probability = static_cast<double>(p) / total_probability;
+                        m_transitions(idx, action_id, state_index(s_i)) += probability;
+                        m_rewards(idx, action_id) += probability * static_cast<double>(r);
+                    }
+                }
+            }
+        }
+
+        /// Returns the number of states
+        /// \return
+        [[nodiscard]]
+        size_t num_states() const { return m_states.size(); }
+
+        /// Returns the index of a state. Throws std::out_of_range if the state was not exported.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        StateIndex state_index(const State& state) const {
+            auto iter = std::lower_bound(m_state_order.begin(), m_state_order.end(), state,
+                                         [this](StateIndex idx, const State& s) { return m_states[idx] < s; });
+            if (iter == m_state_order.end() || state < m_states[*iter])
+                throw std::out_of_range("State is not part of the tensor MDP");
+            return *iter;
+        }
+
+        /// Returns the state represented by the given index
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        const State& state_at(StateIndex idx) const { return m_states[idx]; }
+
+        /// Returns the states in index order
+        /// \return
+        [[nodiscard]]
+        const std::vector<State>& states() const { return m_states; }
+
+        /// Returns the transition tensor P(s, a, s')
+        /// \return
+        [[nodiscard]]
+        const xt::xtensor<double, 3>& transitions() const { return m_transitions; }
+
+        /// Returns the expected reward tensor R(s, a)
+        /// \return
+        [[nodiscard]]
+        const xt::xtensor<double, 2>& rewards() const { return m_rewards; }
+
+        /// Returns true if the action has transitions in the state
+        /// \param idx
+        /// \param action_id
+        /// \return
+        [[nodiscard]]
+        bool is_available(StateIndex idx, size_t action_id) const { return m_available(idx, action_id); }
+
+        /// Returns true if the state is terminal
+        /// \param idx
+        /// \return
+        [[nodiscard]]
+        bool is_terminal(StateIndex idx) const { return m_terminal(idx); }
+
+    private:
+        std::vector<State> m_states;
+        std::vector<StateIndex> m_state_order;
+
+        xt::xtensor<double, 3> m_transitions;
+        xt::xtensor<double, 2> m_rewards;
+        xt::xtensor<bool, 2> m_available;
+        xt::xtensor<bool, 1> m_terminal;
+    };
+
+    /// Greedy policy over a TensorMDP. Each sweep evaluates the action values of every state at once as
+    /// Q = R + gamma * sum_s'(P * V) and V = sum_a(pi * Q), instead of walking the transitions of each state.
+    /// \tparam TState
+    /// \tparam TAction
+    template<class TState, class TAction>
+    class TensorGreedyPolicy : public MDPPolicy<TState, TAction> {
+    public:
+        using Base = MDPPolicy<TState, TAction>;
+        using typename Base::State;
+        using typename Base::Action;
+        using typename Base::Reward;
+        using typename Base::Probability;
+        using typename Base::ActionProbability;
+
+        using Model = TensorMDP<TState, TAction>;
+        using Actions = ActionTraits<TAction>;
+
+        /// Starts with a uniform policy over the available actions and a zero value function
+        /// \param tensor_mdp
+        /// \param gamma
+        TensorGreedyPolicy(std::shared_ptr<const Model> tensor_mdp, double gamma) :
+                m_mdp(std::move(tensor_mdp)), m_gamma(gamma) {
+            const size_t total_states = m_mdp->num_states();
+            const size_t total_actions = Actions::total_actions();
+            m_values = xt::zeros<double>({total_states});
+            m_policy = xt::zeros<double>({total_states, total_actions});
+
+            for (size_t idx = 0; idx != total_states; ++idx) {
+                size_t available = 0;
+                for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                    available += m_mdp->is_available(idx, action_id);
+                }
+                for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                    if (m_mdp->is_available(idx, action_id)) {
+                        m_policy(idx, action_id) = 1.0 / static_cast<double>(available);
+                    }
+                }
+            }
+        }
+
+        /// Return the possible actions and its probabilities based on the current state.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        std::vector<ActionProbability> get_action_probabilities(const State& state) const override {
+            const size_t idx = m_mdp->state_index(state);
+            std::vector<ActionProbability> action_probability;
+            action_probability.reserve(Actions::total_actions());
+            for (size_t action_id = 0; action_id != Actions::total_actions(); ++action_id) {
+                action_probability.emplace_back(Actions::from_id(action_id), m_policy(idx, action_id));
+            }
+            return action_probability;
+        }
+
+        /// Approximates the value function doing a single synchronous sweep.
+        /// \return Largest change of the value function
+        double policy_evaluation() override {
+            xt::xtensor<double, 1> values = xt::sum(m_policy * action_values(), {1});
+            double delta = xt::amax(xt::abs(values - m_values))();
+            m_values = std::move(values);
+            return delta;
+        }
+
+        /// Makes the policy greedy according to the value function, splitting ties evenly
+        /// \return True if the policy changed
+        bool update_policy() override {
+            const xt::xtensor<double, 2> q = action_values();
+            const size_t total_actions = Actions::total_actions();
+            bool policy_changed = false;
+
+            for (size_t idx = 0; idx != m_mdp->num_states(); ++idx) {
+                double best_value = -std::numeric_limits<double>::infinity();
+                size_t best_actions = 0;
+                for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                    if (!m_mdp->is_available(idx, action_id)) continue;
+                    if (q(idx, action_id) > best_value) {
+                        best_value = q(idx, action_id);
+                        best_actions = 1;
+                    } else if (q(idx, action_id) == best_value) {
+                        ++best_actions;
+                    }
+                }
+                if (best_actions == 0) continue;
+
+                for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                    double p = m_mdp->is_available(idx, action_id) && q(idx, action_id) == best_value
+                               ? 1.0 / static_cast<double>(best_actions) : 0.0;
+                    if (m_policy(idx, action_id) != p) {
+                        m_policy(idx, action_id) = p;
+                        policy_changed = true;
+                    }
+                }
+            }
+
+            return policy_changed;
+        }
+
+        /// Returns the value function result given a state.
+        /// \param state
+        /// \return
+        [[nodiscard]]
+        Reward value_function(const State& state) const override { return m_values(m_mdp->state_index(state)); }
+
+        /// Returns the value function in state index order
+        /// \return
+        [[nodiscard]]
+        const xt::xtensor<double, 1>& values() const { return m_values; }
+
+    private:
+        std::shared_ptr<const Model> m_mdp;
+        double m_gamma;
+        xt::xtensor<double, 1> m_values;
+        xt::xtensor<double, 2> m_policy;
+
+        /// Returns Q(s, a) for the current value function. V broadcasts over the successor axis of P.
+        /// \return
+        [[nodiscard]]
+        xt::xtensor<double, 2> action_values() const {
+            return m_mdp->rewards() + m_gamma * xt::sum(m_mdp->transitions() * m_values, {2});
+        }
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_TENSOR_MDP_H
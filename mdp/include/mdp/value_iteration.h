@@ -0,0 +1,227 @@
+#ifndef REINFORCEMENT_LEARNING_VALUE_ITERATION_H
+#define REINFORCEMENT_LEARNING_VALUE_ITERATION_H
+
+#include <mdp/mdp.h>
+#include <mdp/actions.h>
+#include <mdp/compiled_mdp.h>
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
+
+namespace rl::mdp {
+
+    /// Stopping criteria of ValueIterationSolver. Solving stops as soon as any of the set criteria is met.
+    struct StoppingCriteria {
+        /// Largest change of a sweep (sup norm of V_k+1 - V_k) under which the values are considered converged
+        std::optional<double> epsilon{1e-6};
+
+        /// Span seminorm of V_k+1 - V_k (largest minus smallest change) under which the greedy policy is stable.
+        /// It converges when the values only drift by a constant, e.g. with gamma = 1.
+        std::optional<double> span{};
+
+        /// Maximum amount of sweeps
+        std::optional<size_t> max_iterations{};
+
+        /// Wall-clock budget of the sweeps, checked after every sweep
+        std::optional<std::chrono::duration<double>> time_budget{};
+    };
+
+    /// Criterion that stopped a ValueIterationSolver
+    enum class StopReason {
+        EPSILON,
+        SPAN,
+        MAX_ITERATIONS,
+        TIME_BUDGET
+    };
+
+    /// Solves an MDP with value iteration over its compiled CSR arrays. Every sweep fuses the max backup with the
+    /// greedy step, so the greedy policy is available without an extra pass over the transitions.
+    /// \tparam MDP Any MDP with ordered states, or a CompiledMDP passed through the shared_ptr constructor
+    template<class MDP>
+    class ValueIterationSolver {
+    public:
+        using State = typename MDP::State;
+        using Action = typename MDP::Action;
+        using Reward = typename MDP::Reward;
+        using Probability = typename MDP::Probability;
+
+        using Compiled = CompiledMDP<State, Action, Reward, Probability>;
+        using Duration = std::chrono::duration<double, std::milli>;
+
+        /// Result of a solve, tables are indexed by the state indices of the compiled model
+        struct Result {
+            std::shared_ptr<const Compiled> model;
+
+            /// Value of every state
+            std::vector<Reward> values;
+
+            /// Greedy action of every state according to the values of the last sweep. Terminal states and
+            /// states without actions keep the first action.
+            std::vector<Action> policy;
+
+            size_t iterations{0};
+            double residual{std::numeric_limits<double>::infinity()};
+            double span{std::numeric_limits<double>::infinity()};
+            StopReason stop_reason{StopReason::EPSILON};
+
+            /// Time spent compiling the model and running the sweeps
+            Duration setup_time{}, solve_time{};
+
+            /// Returns the value of a state
+            /// \param state
+            /// \return
+            [[nodiscard]]
+            Reward value(const State& state) const { return values[model->state_index(state)]; }
+
+            /// Returns the greedy action of a state
+            /// \param state
+            /// \return
+            [[nodiscard]]
+            Action action(const State& state) const { return policy[model->state_index(state)]; }
+        };
+
+        /// Compiles the given MDP. Compiled models cannot be copied, use the shared_ptr constructor for them.
+        /// \param mdp
+        /// \param gamma
+        ValueIterationSolver(const MDP& mdp, double gamma) : m_gamma(gamma) {
+            auto start = Clock::now();
+            m_model = std::make_shared<const Compiled>(mdp);
+            m_setup_time = Clock::now() - start;
+        }
+
+        /// Uses a model that is already compiled
+        /// \param compiled
+        /// \param gamma
+        ValueIterationSolver(std::shared_ptr<const Compiled> compiled, double gamma)
+                : m_model(std::move(compiled)), m_gamma(gamma) {
+            if (!m_model) throw std::invalid_argument("Compiled model cannot be null");
+        }
+
+        /// Returns the compiled model used by the sweeps
+        /// \return
+        [[nodiscard]]
+        std::shared_ptr<const Compiled> get_model() const { return m_model; }
+
+        /// Runs value iteration from zero values until a stopping criterion is met
+        /// \param criteria
+        /// \return
+        Result solve(const StoppingCriteria& criteria = {}) const {
+            return solve(std::vector<Reward>(m_model->num_states(), Reward{}), criteria);
+        }
+
+        /// Runs value iteration from the given values until a stopping criterion is met
+        /// \param initial_values Values indexed by the compiled state indices
+        /// \param criteria
+        /// \return
+        Result solve(std::vector<Reward> initial_values, const StoppingCriteria& criteria) const {
+            if (initial_values.size() != m_model->num_states())
+                throw std::invalid_argument("Initial values must have a value per state");
+            if (!criteria.epsilon && !criteria.span && !criteria.max_iterations && !criteria.time_budget)
+                throw std::invalid_argument("At least one stopping criterion is required");
+
+            Result result;
+            result.model = m_model;
+            result.setup_time = m_setup_time;
+            result.values = std::move(initial_values);
+            result.policy.assign(m_model->num_states(), ActionTraits<Action>::from_id(0));
+
+            // Sweeps swap between the two tables, so they do not allocate
+            std::vector<Reward> next_values(result.values);
+            auto start = Clock::now();
+            while (true) {
+                auto [max_change, min_change] = sweep(result.values, next_values, result.policy);
+                result.values.swap(next_values);
+                ++result.iterations;
+                result.residual = static_cast<double>(std::max(std::abs(max_change), std::abs(min_change)));
+                result.span = static_cast<double>(max_change - min_change);
+
+                if (criteria.epsilon && result.residual < criteria.epsilon.value()) {
+                    result.stop_reason = StopReason::EPSILON;
+                    break;
+                }
+                if (criteria.span && result.span < criteria.span.value()) {
+                    result.stop_reason = StopReason::SPAN;
+                    break;
+                }
+                if (criteria.max_iterations && result.iterations >= criteria.max_iterations.value()) {
+                    result.stop_reason = StopReason::MAX_ITERATIONS;
+                    break;
+                }
+                if (criteria.time_budget && Clock::now() - start >= criteria.time_budget.value()) {
+                    result.stop_reason = StopReason::TIME_BUDGET;
+                    break;
+                }
+            }
+            result.solve_time = Clock::now() - start;
+
+            return result;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        std::shared_ptr<const Compiled> m_model;
+        Reward m_gamma;
+        Duration m_setup_time{};
+
+        /// Backs up every state with the best action, storing the new values and the greedy actions
+        /// \param values
+        /// \param next_values
+        /// \param policy
+        /// \return Largest and smallest change of the sweep
+        std::pair<Reward, Reward> sweep(const std::vector<Reward>& values, std::vector<Reward>& next_values,
+                                        std::vector<Action>& policy) const {
+            const size_t total_actions = m_model->num_actions();
+            Reward max_change = -std::numeric_limits<Reward>::infinity();
+            Reward min_change = std::numeric_limits<Reward>::infinity();
+
+            for (size_t idx = 0; idx != values.size(); ++idx) {
+                Reward best_value = values[idx];
+                if (!m_model->is_terminal(idx)) {
+                    best_value = -std::numeric_limits<Reward>::infinity();
+                    size_t best_action = total_actions;
+
+                    for (size_t action_id = 0; action_id != total_actions; ++action_id) {
+                        auto range = m_model->transitions(idx, action_id);
+                        if (range.empty()) continue;
+
+                        Reward value{};
+                        for (size_t i = 0; i != range.size; ++i) {
+                            value += range.probabilities[i] * (range.rewards[i] + m_gamma * values[range.successors[i]]);
+                        }
+
+                        if (value > best_value) {
+                            best_value = value;
+                            best_action = action_id;
+                        }
+                    }
+
+                    // States without actions keep their value
+                    if (best_action == total_actions) {
+                        best_value = values[idx];
+                    } else {
+                        policy[idx] = ActionTraits<Action>::from_id(best_action);
+                    }
+                }
+
+                next_values[idx] = best_value;
+                Reward change = best_value - values[idx];
+                max_change = std::max(max_change, change);
+                min_change = std::min(min_change, change);
+            }
+
+            // Empty models
+            if (values.empty()) return {Reward{}, Reward{}};
+            return {max_change, min_change};
+        }
+    };
+
+} // namespace rl::mdp
+
+#endif //REINFORCEMENT_LEARNING_VALUE_ITERATION_H
@@ -1,4 +1,5 @@
 #include <mdp/gridworld.h>
+#include <mdp/value_iteration.h>
 #include <mdp/agents.h>
 
 #include <fmt/core.h>
@@ -85,18 +86,37 @@ void run_basic_experiment(const std::shared_ptr<Gridworld>& gridworld,
                    plot_data).label(experiment_name);
 }
 
-int main(){
-    // Create Gridworld
-    auto gridworld = std::make_shared<Gridworld>(4, 4);
+int main(int argc, char** argv){
+    // Create Gridworld, optionally loading the map given as argument. PGM maps also need the gray levels of the
+    // start and goal pixels: run-gridworld-agents map.pgm start_level goal_level
+    std::shared_ptr<Gridworld> gridworld;
+    if(argc > 1){
+        rl::mdp::GridworldMapSettings settings;
+        settings.goal_reward = 1.0;
+        if(argc > 3){
+            settings.start_level = std::stoul(argv[2]);
+            settings.goal_level = std::stoul(argv[3]);
+        }
+        gridworld = std::make_shared<Gridworld>(Gridworld::load(argv[1], settings));
+
+        // Episodes need somewhere to start and end
+        if(gridworld->get_initial_states().empty() || gridworld->get_terminal_states().empty()){
+            std::cerr << "Map needs at least one initial state and one goal\n";
+            return 1;
+        }
+    } else {
+        gridworld = std::make_shared<Gridworld>(4, 4);
+        gridworld->set_initial_state({0, 0});
+        gridworld->set_terminal_state({3, 3}, 1.0);
+    }
 //    gridworld->cost_of_living(-1.0);
     gridworld->bounds_penalty(-1.0);
-    gridworld->set_initial_state({0, 0});
-    gridworld->set_terminal_state({3, 3}, 1.0);
 
-    rl::mdp::GridworldGreedyPolicy policy(gridworld, 1.0);
-    while(policy.policy_evaluation() > 0.0001);
-    fmt::print("Expected value from initial state: {:.2f}\n\n",
-               policy.value_function({0, 0}));
+    rl::mdp::StoppingCriteria criteria;
+    criteria.epsilon = 0.0001;
+    auto solution = rl::mdp::ValueIterationSolver<Gridworld>(*gridworld, 1.0).solve(criteria);
+    fmt::print("Optimal value from initial state: {:.2f} ({:d} iterations)\n\n",
+               solution.value(gridworld->get_initial_states().front()), solution.iterations);
 
     // Create plot
     plt::Plot plot;
@@ -1,4 +1,5 @@
 #include "mdp/gridworld.h"
+#include "mdp/value_iteration.h"
 
 #include <memory>
 #include <iostream>
@@ -45,15 +46,37 @@ int main(){
     print_value_function(gridworld, policy);
 
     std::cout << "\nInf evaluation\n";
-    int n = 0;
-    while(policy.policy_evaluation() >= 0.0001 && n++ < 1000){
-        policy.policy_evaluation();
-    }
+    int n = 1;
+    while(policy.policy_evaluation() >= 0.0001 && n < 1000) ++n;
     policy.update_policy();
     fmt::print("...after {:d} iterations\n", n);
     std::cout << policy << std::endl;
     print_value_function(gridworld, policy);
 
+    std::cout << "\nExact evaluation\n";
+    GridworldGreedyPolicy exact_policy(gridworld, 1.0);
+    size_t improvements = 0;
+    do {
+        exact_policy.evaluate_exact();
+        ++improvements;
+    } while(exact_policy.update_policy() && improvements < 100);
+    fmt::print("...after {:d} improvements\n", improvements);
+    print_value_function(gridworld, exact_policy);
+
+    std::cout << "\nValue iteration\n";
+    ValueIterationSolver<Gridworld> solver(*gridworld, 1.0);
+    StoppingCriteria criteria;
+    criteria.epsilon = 0.0001;
+    criteria.max_iterations = 1000;
+    auto result = solver.solve(criteria);
+    fmt::print("...after {:d} iterations ({:.3f} ms)\n", result.iterations, result.solve_time.count());
+    for (size_t i = 0; i < gridworld->get_rows(); ++i) {
+        for (size_t j = 0; j < gridworld->get_columns(); ++j) {
+            fmt::print("{: .2f} ", result.value(GridworldState{i, j}));
+        }
+        fmt::print("\n");
+    }
+
     return 0;
 }
 
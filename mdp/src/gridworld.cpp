@@ -1,47 +1,38 @@
 #include <mdp/gridworld.h>
 #include <mdp/actions.h>
+#include <mdp/stencil.h>
 
 #include <numeric>
+#include <type_traits>
 #include <algorithm>
 #include <stdexcept>
 #include <iterator>
 #include <set>
+#include <string>
+#include <cctype>
+#include <fstream>
 #include "SFML/Graphics/RenderTarget.hpp"
 
 using namespace rl::mdp;
 
-std::vector<Gridworld::StateRewardProbability> Gridworld::get_transitions(const Gridworld::State &state, const Gridworld::Action &action) const {
-    StateAction stateAction{state, action};
-    size_t number_transitions = m_dynamics.count(stateAction);
-
-    // Default case - No actions found for current state
-    if(number_transitions == 0){
-        return { transition_default(state, action) };
-    }
-
-    // Deterministic case
-    if (number_transitions == 1) {
-        auto element_iter = m_dynamics.find(stateAction);
-        return {element_iter->second};
-    }
-
-    // Non-deterministic case
-    auto [start_iter, end_iter] = m_dynamics.equal_range(StateAction{state, action});
-    auto total_probability = std::accumulate(start_iter, end_iter, 0.0, [](const auto& val, const auto& iter){
-        return val + srp_probability(iter.second);
-    });
-
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::get_transitions(const State &state, const Action &action) const -> std::vector<StateRewardProbability> {
     std::vector<StateRewardProbability> srp_list;
-    std::transform(start_iter, end_iter, std::back_inserter(srp_list), [total_probability](const auto& iter){
-        StateRewardProbability new_srp{iter.second};
-        srp_probability(new_srp) /= total_probability;
-        return new_srp;
+    for_each_transition(state, action, [&srp_list](const State& s_i, const Reward& r, const Probability& p){
+        srp_list.emplace_back(s_i, r, p);
     });
     return srp_list;
 }
 
-Gridworld::StateRewardProbability
-Gridworld::transition_default(const Gridworld::State &state, const Gridworld::Action &action) const {
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::transition_default(const State &state, const Action &action) const -> StateRewardProbability {
+    // Terminal states only return to themselves
+    if(is_terminal_state(state)){
+        size_t state_idx = state_index(state);
+        Reward reward = (m_state_flags[state_idx] & ENTRY_REWARD) != 0 ? m_entry_rewards[state_idx] : Reward{};
+        return StateRewardProbability{state, reward, 1.0};
+    }
+
     StateRewardProbability srp;
 
     // Select according to action
@@ -72,91 +63,121 @@ Gridworld::transition_default(const Gridworld::State &state, const Gridworld::Ac
             break;
     }
 
+    // Walls revert to the current state with their penalty
+    const State& next_state = Base::srp_state(srp);
+    if(in_grid(next_state)){
+        size_t next_idx = state_index(next_state);
+        uint8_t flags = m_state_flags[next_idx];
+        if((flags & WALL_STATE) != 0){
+            return StateRewardProbability{state, m_entry_rewards[next_idx], 1.0};
+        }
+        if((flags & ENTRY_REWARD) != 0 && state != next_state){
+            Base::srp_reward(srp) = m_entry_rewards[next_idx];
+        }
+    }
+
     // If the new-state == the given state it means we are at the edge
     // so the reward is the out-of-bounds penalty
-    if( state == srp_state(srp)){
-        srp_reward(srp) = m_bounds_penalty;
+    if( state == Base::srp_state(srp)){
+        Base::srp_reward(srp) = m_bounds_penalty;
     }
 
     return srp;
 }
 
-void Gridworld::add_transition(const Gridworld::State &state, const Gridworld::Action &action,
-                               const Gridworld::State &new_state, const Gridworld::Reward &reward,
-                               const Gridworld::Probability &weight) {
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::add_transition(const State &state, const Action &action,
+                                                         const State &new_state, const Reward &reward,
+                                                         const Probability &weight) {
     // Check if it is a terminal state
     if(is_terminal_state(state)) throw std::invalid_argument("Adding transition to terminal state");
+    if(state.row >= m_rows || state.column >= m_columns || new_state.row >= m_rows || new_state.column >= m_columns)
+        throw std::out_of_range("Transition states must be inside the grid");
+    if(weight < 0.0) throw std::invalid_argument("Transition weights cannot be negative");
+
+    DynamicsCell& cell = get_cell(state_index(state), action);
+    IndexedTransition transition{state_index(new_state), reward, weight};
+    add_incoming(transition.successor, cell_id(state_index(state), action));
+
+    // Normalise the probabilities with the new total weight
+    Probability total_weight = cell.total_weight + weight;
+    Probability scale = total_weight > 0 ? cell.total_weight / total_weight : Probability{};
+    transition.probability = total_weight > 0 ? weight / total_weight : Probability{};
+    cell.total_weight = total_weight;
+
+    if(cell.size == 0){
+        cell.single = transition;
+        cell.size = 1;
+    } else {
+        if(cell.size == cell.capacity || cell.size == 1){
+            // Move the transitions to a larger block at the end of the pool
+            uint32_t capacity = std::max<uint32_t>(4, 2 * cell.size);
+            size_t overflow = m_overflow.size();
+            m_overflow.resize(overflow + capacity);
+            std::copy_n(cell_transitions(cell), cell.size, m_overflow.begin() + static_cast<std::ptrdiff_t>(overflow));
+
+            m_overflow_unused += cell.capacity;
+            cell.overflow = overflow;
+            cell.capacity = capacity;
+        }
+        m_overflow[cell.overflow + cell.size] = transition;
+        ++cell.size;
+    }
 
-    StateAction state_action{state, action};
-    StateRewardProbability transition_probability{new_state, reward, weight};
+    IndexedTransition* transitions = cell_transitions(cell);
+    for(size_t i = 0; i + 1 < cell.size; ++i) transitions[i].probability *= scale;
 
-    m_dynamics.emplace(state_action, transition_probability);
+    if(m_overflow_unused > m_overflow.size() / 2) compact_overflow();
+    this->mark_modified();
 }
 
-Gridworld::Reward Gridworld::expected_reward(const GridworldState &state, const GridworldAction &action) const {
-    StateAction state_action{state, action};
-    auto transition_count = m_dynamics.count(state_action);
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::expected_reward(const State &state, const Action &action) const -> Reward {
+    const DynamicsCell* cell = find_cell(state_index(state), action);
 
     // Default reward
-    if(transition_count == 0){
+    if(cell == nullptr){
         return 0.0;
     }
 
-    // Deterministic
-    if(transition_count == 1){
-        auto transition = m_dynamics.find(state_action);
-        return srp_reward(transition->second);
+    // Probabilities are already normalised
+    const IndexedTransition* transitions = cell_transitions(*cell);
+    Reward expected_reward{};
+    for(size_t i = 0; i != cell->size; ++i){
+        expected_reward += transitions[i].reward * transitions[i].probability;
     }
 
-    // Non-deterministic
-    Reward total_probability{};
-    auto [start_iter, end_iter] = m_dynamics.equal_range(StateAction{state, action});
-    Reward expected_reward = std::accumulate(start_iter, end_iter, 0.0,
-                    [&total_probability](const auto& value, const auto& iter_value){
-                        total_probability += srp_probability(iter_value.second);
-        return value + srp_probability(iter_value.second) * srp_reward(iter_value.second);
-    });
-
-    return expected_reward / total_probability;
+    return expected_reward;
 }
 
-Gridworld::Probability Gridworld::state_transition_probability(const GridworldState &from_state,
-                                               const GridworldAction &action,
-                                               const GridworldState &to_state) const {
-    // Get all transitions from state-action pair
-    auto [start_iter, end_iter] = m_dynamics.equal_range(StateAction{from_state, action});
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::state_transition_probability(const State &from_state,
+                                                                       const Action &action,
+                                                                       const State &to_state) const -> Probability {
+    const DynamicsCell* cell = find_cell(state_index(from_state), action);
 
     // Check if it is a default probability or set state
     // ... default
-    if(start_iter == m_dynamics.end()) {
+    if(cell == nullptr) {
         auto [default_state, default_reward, default_probability] = transition_default(from_state, action);
-        if (default_state == to_state) {
-            return 1.0;
-        } else {
-            return 0.0;
-        }
+        return default_state == to_state ? Probability{1} : Probability{};
     }
 
     // ... set
-    Probability total_probability = 0.0, to_state_probability = 0.0;
-    for(auto iter = start_iter; iter != end_iter; ++iter){
-        StateRewardProbability srp = iter->second;
+    if(to_state.row >= m_rows || to_state.column >= m_columns) return 0.0;
+    size_t to_index = state_index(to_state);
 
-        if(srp_state(srp) == to_state){
-            to_state_probability += srp_probability(srp);
-        }
-        total_probability += srp_probability(srp);
+    const IndexedTransition* transitions = cell_transitions(*cell);
+    Probability to_state_probability = 0.0;
+    for(size_t i = 0; i != cell->size; ++i){
+        if(transitions[i].successor == to_index) to_state_probability += transitions[i].probability;
     }
 
-    // Calculate final probability
-    if(total_probability != 0.0){
-        return to_state_probability / total_probability;
-    } else {
-        return 0.0;
-    }
+    return to_state_probability;
 }
 
-std::vector<Gridworld::State> Gridworld::get_states() const {
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::get_states() const -> std::vector<State> {
     // Create the states vector and return
     std::vector<State> states;
     states.reserve(get_rows() * get_columns());
@@ -170,147 +191,413 @@ std::vector<Gridworld::State> Gridworld::get_states() const {
     return states;
 }
 
-std::vector<Gridworld::Action> Gridworld::get_actions(const GridworldState &state) const {
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::get_actions(const State &state) const -> std::vector<Action> {
     const auto& actions = ActionTraits<Action>::available_actions();
     return {actions.begin(), actions.end()};
 }
 
-void Gridworld::set_terminal_state(const GridworldState &s_term, std::optional<Reward> default_reward) {
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::set_terminal_state(const State &s_term, std::optional<Reward> default_reward) {
     // Validate
     if(is_initial_state(s_term) || is_wall_state(s_term))
         throw std::invalid_argument("Initial or wall states cannot be marked as terminal");
 
     // Check if it is already added
     if(is_terminal_state(s_term)) return;
+    if(!in_grid(s_term)) throw std::out_of_range("Terminal state must be inside the grid");
 
-    // Remove all transitions coming from this state, and add a single one that returns to the same state
+    // Remove all transitions coming from this state, the default transition of terminal states
+    // returns to the same state
+    size_t term_idx = state_index(s_term);
     for(const auto& action: ActionTraits<Action>::available_actions()){
-        auto [start, end] = m_dynamics.equal_range(StateAction{s_term, action});
-        m_dynamics.erase(start, end);
-
-        add_transition(s_term, action, s_term, 0.0, 1.0);
+        if(DynamicsCell* cell = cell_at(cell_id(term_idx, action))){
+            m_overflow_unused += cell->capacity;
+            *cell = DynamicsCell{};
+        }
     }
+    m_state_flags[term_idx] |= TERMINAL_STATE;
 
     // Set in-reward as default reward for transitions coming to this state
     if(default_reward){
-        for(const auto& state: get_states()){
-            for(const auto& action: ActionTraits<Action>::available_actions()){
-                for(const auto&[s_i, reward, probability]: get_transitions(state, action)){
-                    if(s_i == s_term){
-                        // Change reward of transition to terminal state
-                        remove_added_transition(state, action, s_i);
-                        add_transition(state, action, s_term, default_reward.value(), probability);
-                    }
-                }
-            }
-        }
+        set_entry_reward(term_idx, default_reward.value());
+        redirect_transitions(term_idx, default_reward.value(), [term_idx](size_t){ return term_idx; });
     }
 
     // Add the state to the terminal states list
     m_terminal_states.insert(s_term);
+    this->mark_modified();
 }
 
-bool Gridworld::is_terminal_state(const GridworldState &s) const {
-    return m_terminal_states.find(s) != m_terminal_states.cend();
+template<class TReward, class TProbability>
+bool BasicGridworld<TReward, TProbability>::is_terminal_state(const State &s) const {
+    return has_flag(s, TERMINAL_STATE);
 }
 
-std::vector<Gridworld::State> Gridworld::get_terminal_states() const {
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::get_terminal_states() const -> std::vector<State> {
     return {m_terminal_states.begin(), m_terminal_states.end()};
 }
 
-void Gridworld::remove_added_transition(const GridworldState &source, const FourWayAction &action,
-                                        const GridworldState &target) {
-    // Verifies if there are custom transitions with the given parameters
-    auto [start, end] = m_dynamics.equal_range({source, action});
-    for(auto iter=start; iter != end;){
-        auto& [s_i, r, p] = iter->second;
-        if(s_i == target){
-            iter = m_dynamics.erase(iter);
-        } else {
-            ++iter;
+template<class TReward, class TProbability>
+std::vector<uint8_t> BasicGridworld<TReward, TProbability>::default_dynamics_mask() const {
+    constexpr size_t total_actions = ActionTraits<Action>::total_actions();
+    std::vector<uint8_t> mask(num_states(), 0);
+
+    // Moving into a wall or a cell with entry reward does not use the cost of living
+    auto open = [this](size_t idx){ return (m_state_flags[idx] & (WALL_STATE | ENTRY_REWARD)) == 0; };
+    auto custom = [this](size_t idx){
+        for(size_t action_id = 0; action_id != total_actions; ++action_id){
+            const DynamicsCell* cell = cell_at(idx * total_actions + action_id);
+            if(cell != nullptr && cell->size != 0) return true;
+        }
+        return false;
+    };
+
+    // Border cells bump into the bounds
+    for(size_t row = 1; row + 1 < m_rows; ++row){
+        for(size_t column = 1; column + 1 < m_columns; ++column){
+            size_t idx = row * m_columns + column;
+            if((m_state_flags[idx] & TERMINAL_STATE) != 0 || custom(idx)) continue;
+
+            if(open(idx - 1) && open(idx + 1) && open(idx - m_columns) && open(idx + m_columns)) mask[idx] = 1;
         }
     }
+
+    return mask;
 }
 
-void Gridworld::set_wall_state(const GridworldState &wall, double penalty) {
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::get_cell(size_t state_idx, const Action& action) -> DynamicsCell& {
+    constexpr size_t block_cells = CELL_BLOCK_SIZE * ActionTraits<Action>::total_actions();
+    const size_t id = cell_id(state_idx, action);
+
+    // Only the block of the state gets an index, and only the pair gets a cell
+    if(m_cell_blocks.empty()) m_cell_blocks.resize((num_states() + CELL_BLOCK_SIZE - 1) / CELL_BLOCK_SIZE);
+    auto& block = m_cell_blocks[id / block_cells];
+    if(block.empty()) block.resize(block_cells, 0);
+
+    uint32_t& position = block[id % block_cells];
+    if(position == 0){
+        if(m_cells.size() == std::numeric_limits<uint32_t>::max())
+            throw std::length_error("Too many State-Action pairs with custom transitions");
+        m_cells.emplace_back();
+        position = static_cast<uint32_t>(m_cells.size());
+    }
+    return m_cells[position - 1];
+}
+
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::set_entry_reward(size_t state_idx, Reward reward) {
+    if(m_entry_rewards.empty()) m_entry_rewards.resize(num_states());
+    m_entry_rewards[state_idx] = reward;
+    m_state_flags[state_idx] |= ENTRY_REWARD;
+}
+
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::cost_of_living(const State &state, Reward cost_of_living) {
+    if(!in_grid(state)) throw std::out_of_range("State must be inside the grid");
+    if(is_wall_state(state) || is_terminal_state(state))
+        throw std::invalid_argument("Wall and terminal states use their own in-reward");
+
+    set_entry_reward(state_index(state), cost_of_living);
+    this->mark_modified();
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworld<TReward, TProbability>::get_wall_states() const -> std::vector<State> {
+    std::vector<State> walls;
+    for(size_t idx = 0; idx != m_state_flags.size(); ++idx){
+        if((m_state_flags[idx] & WALL_STATE) != 0) walls.push_back(state_at(idx));
+    }
+    return walls;
+}
+
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::add_incoming(size_t target, size_t cell_id) {
+    auto& incoming = m_incoming[target];
+    if(incoming.empty() || incoming.back() != cell_id) incoming.push_back(cell_id);
+}
+
+template<class TReward, class TProbability>
+template<class Redirect>
+void BasicGridworld<TReward, TProbability>::redirect_transitions(size_t target, Reward reward, Redirect&& redirect) {
+    constexpr size_t total_actions = ActionTraits<Action>::total_actions();
+
+    // Custom transitions are found through the incoming index. It may have stale entries, so the
+    // successors are checked again.
+    auto incoming = m_incoming.find(target);
+    if(incoming != m_incoming.end()){
+        std::vector<size_t> cell_ids = std::move(incoming->second);
+        m_incoming.erase(incoming);
+
+        for(size_t id: cell_ids){
+            DynamicsCell& cell = *cell_at(id);
+            size_t destination = redirect(id / total_actions);
+
+            bool redirected = false;
+            IndexedTransition* transitions = cell_transitions(cell);
+            for(size_t i = 0; i != cell.size; ++i){
+                if(transitions[i].successor == target){
+                    transitions[i].successor = destination;
+                    transitions[i].reward = reward;
+                    redirected = true;
+                }
+            }
+            if(redirected) add_incoming(destination, id);
+        }
+    }
+}
+
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::compact_overflow() {
+    std::vector<IndexedTransition> overflow;
+    overflow.reserve(m_overflow.size() - m_overflow_unused);
+
+    for(auto& cell: m_cells){
+        if(cell.capacity == 0) continue;
+
+        size_t offset = overflow.size();
+        overflow.insert(overflow.end(), m_overflow.begin() + static_cast<std::ptrdiff_t>(cell.overflow),
+                        m_overflow.begin() + static_cast<std::ptrdiff_t>(cell.overflow + cell.capacity));
+        cell.overflow = offset;
+    }
+
+    m_overflow = std::move(overflow);
+    m_overflow_unused = 0;
+}
+
+template<class TReward, class TProbability>
+void BasicGridworld<TReward, TProbability>::set_wall_state(const State &wall, Reward penalty) {
     // Wall states cannot be an initial nor a terminal state
     if(is_terminal_state(wall) || is_initial_state(wall))
         throw std::invalid_argument("Terminal states cannot be walls");
 
     // Verify that it hasn't been added
     if(is_wall_state(wall)) return;
+    if(!in_grid(wall)) throw std::out_of_range("Wall state must be inside the grid");
 
-    // Get all transitions to this state and revert
-    for(const auto& state: get_states()){
-        for(const auto& action: ActionTraits<Action>::available_actions()){
-            for(const auto& [s_i, reward, probability]: get_transitions(state, action)){
-                if(s_i == wall){
-                    // Transition that goes to the wall
-                    remove_added_transition(state, action, s_i);
-                    add_transition(state, action, state, penalty, probability);
-                }
+    // Mark the wall, default transitions going to it revert to the previous state
+    size_t wall_idx = state_index(wall);
+    m_state_flags[wall_idx] |= WALL_STATE;
+    set_entry_reward(wall_idx, penalty);
+
+    // Added transitions going to the wall also revert to the previous state
+    redirect_transitions(wall_idx, penalty, [](size_t source){ return source; });
+    this->mark_modified();
+}
+
+namespace {
+    /// Reads a whole stream into memory
+    /// \param input
+    /// \return
+    std::string read_map(std::istream& input) {
+        std::string buffer;
+
+        // Use a single read when the size is known
+        auto start = input.tellg();
+        if(start != std::istream::pos_type(-1) && input.seekg(0, std::ios::end)){
+            auto size = input.tellg() - start;
+            input.seekg(start);
+            buffer.resize(static_cast<size_t>(size));
+            input.read(buffer.data(), size);
+            buffer.resize(static_cast<size_t>(input.gcount()));
+        } else {
+            input.clear();
+            buffer.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        }
+
+        return buffer;
+    }
+
+    /// Reads the next number of a PGM header, skipping whitespace and comments
+    /// \param buffer
+    /// \param position
+    /// \return
+    size_t read_pgm_value(const std::string& buffer, size_t& position) {
+        while(position < buffer.size()){
+            char c = buffer[position];
+            if(c == '#'){
+                while(position < buffer.size() && buffer[position] != '\n') ++position;
+            } else if(std::isspace(static_cast<unsigned char>(c))){
+                ++position;
+            } else {
+                break;
             }
         }
+
+        size_t value = 0, digits = 0;
+        for(; position < buffer.size() && std::isdigit(static_cast<unsigned char>(buffer[position])); ++position, ++digits){
+            value = value * 10 + static_cast<size_t>(buffer[position] - '0');
+        }
+        if(digits == 0) throw std::invalid_argument("Invalid PGM header");
+        return value;
+    }
+}
+
+template<class TReward, class TProbability>
+BasicGridworld<TReward, TProbability> BasicGridworld<TReward, TProbability>::load(const std::string &path, const GridworldMapSettings &settings) {
+    std::ifstream input(path, std::ios::binary);
+    if(!input) throw std::runtime_error("Cannot open map file: " + path);
+    return load(input, settings);
+}
+
+template<class TReward, class TProbability>
+BasicGridworld<TReward, TProbability> BasicGridworld<TReward, TProbability>::load(std::istream &input, const GridworldMapSettings &settings) {
+    std::string buffer = read_map(input);
+
+    // Binary PGM
+    if(buffer.size() > 2 && buffer[0] == 'P' && buffer[1] == '5' && std::isspace(static_cast<unsigned char>(buffer[2]))){
+        size_t position = 2;
+        size_t columns = read_pgm_value(buffer, position);
+        size_t rows = read_pgm_value(buffer, position);
+        size_t max_value = read_pgm_value(buffer, position);
+        ++position; // Single whitespace before the pixels
+
+        size_t bytes_per_pixel = max_value < 256 ? 1 : 2;
+        if(rows == 0 || columns == 0 || max_value == 0 || max_value > 65535)
+            throw std::invalid_argument("Invalid PGM header");
+        if(buffer.size() < position + rows * columns * bytes_per_pixel)
+            throw std::invalid_argument("PGM image is truncated");
+
+        BasicGridworld gridworld(rows, columns);
+        const auto* pixels = reinterpret_cast<const unsigned char*>(buffer.data() + position);
+        for(size_t idx = 0; idx != rows * columns; ++idx){
+            size_t value = bytes_per_pixel == 1 ? pixels[idx] : (size_t{pixels[2 * idx]} << 8) | pixels[2 * idx + 1];
+
+            if(settings.start_level == value){
+                gridworld.m_state_flags[idx] |= INITIAL_STATE;
+                gridworld.m_initial_states.insert(gridworld.state_at(idx));
+            } else if(settings.goal_level == value){
+                gridworld.m_state_flags[idx] |= TERMINAL_STATE;
+                gridworld.m_terminal_states.insert(gridworld.state_at(idx));
+                if(settings.goal_reward) gridworld.set_entry_reward(idx, settings.goal_reward.value());
+            } else if(value == 0){
+                gridworld.m_state_flags[idx] |= WALL_STATE;
+                gridworld.set_entry_reward(idx, settings.wall_penalty);
+            } else if(value < max_value){
+                gridworld.set_entry_reward(idx, -static_cast<Reward>(max_value - value) / static_cast<Reward>(max_value));
+            }
+        }
+        return gridworld;
+    }
+
+    // ASCII map, the first line sets the amount of columns
+    size_t columns = buffer.find('\n');
+    if(columns == std::string::npos) columns = buffer.size();
+    if(columns > 0 && buffer[columns - 1] == '\r') --columns;
+    if(columns == 0) throw std::invalid_argument("Empty map");
+
+    // Count rows, ignoring a trailing newline
+    size_t rows = static_cast<size_t>(std::count(buffer.begin(), buffer.end(), '\n'));
+    if(!buffer.empty() && buffer.back() != '\n') ++rows;
+
+    BasicGridworld gridworld(rows, columns);
+    size_t position = 0;
+    for(size_t row = 0; row != rows; ++row){
+        size_t end = buffer.find('\n', position);
+        if(end == std::string::npos) end = buffer.size();
+        size_t line_end = end > position && buffer[end - 1] == '\r' ? end - 1 : end;
+        if(line_end - position != columns)
+            throw std::invalid_argument("Map row " + std::to_string(row) + " has a different amount of columns");
+
+        for(size_t column = 0; column != columns; ++column){
+            size_t idx = row * columns + column;
+            char cell = buffer[position + column];
+            switch(cell){
+                case '.':
+                case ' ':
+                    break;
+                case '#':
+                    gridworld.m_state_flags[idx] |= WALL_STATE;
+                    gridworld.set_entry_reward(idx, settings.wall_penalty);
+                    break;
+                case 'S':
+                    gridworld.m_state_flags[idx] |= INITIAL_STATE;
+                    gridworld.m_initial_states.insert(State{row, column});
+                    break;
+                case 'G':
+                    gridworld.m_state_flags[idx] |= TERMINAL_STATE;
+                    gridworld.m_terminal_states.insert(State{row, column});
+                    if(settings.goal_reward) gridworld.set_entry_reward(idx, settings.goal_reward.value());
+                    break;
+                default:
+                    if(cell < '0' || cell > '9')
+                        throw std::invalid_argument("Unknown map cell '" + std::string(1, cell) + "' in row " +
+                                                    std::to_string(row));
+                    gridworld.set_entry_reward(idx, -static_cast<Reward>(cell - '0'));
+            }
+        }
+
+        position = end + 1;
     }
 
-    // Add state to the list of walls
-    m_wall_states.insert(wall);
+    return gridworld;
 }
 
-GridworldGreedyPolicy::GridworldGreedyPolicy(std::shared_ptr<Gridworld> gridworld, double gamma):
+template<class TReward, class TProbability>
+BasicGridworldGreedyPolicy<TReward, TProbability>::BasicGridworldGreedyPolicy(std::shared_ptr<Gridworld> gridworld, double gamma):
 m_gridworld(std::move(gridworld)),
 m_rows(m_gridworld->get_rows()), m_columns(m_gridworld->get_columns()), m_gamma(gamma),
-m_value_function_table(m_rows * m_columns, 0.0) {
-    // Initialize the state action probability map
-    for(const auto& state: m_gridworld->get_states()){
-        auto actions = m_gridworld->get_actions(state);
+m_value_function_table(m_rows * m_columns, 0.0),
+m_action_probabilities(m_rows * m_columns * ActionTraits<Action>::total_actions(), 0.0) {
+    // Initialize the action probabilities with an uniform policy
+    const size_t total_actions = ActionTraits<Action>::total_actions();
+    for(size_t idx = 0; idx != m_gridworld->num_states(); ++idx){
+        auto actions = m_gridworld->get_actions(m_gridworld->state_at(idx));
         Probability starting_probability = 1.0 / static_cast<Probability>(actions.size());
 
         for(auto a: actions){
-            m_state_action_probability_map[state][a] = starting_probability;
+            m_action_probabilities[idx * total_actions + ActionTraits<Action>::id(a)] = starting_probability;
         }
     }
 }
 
-std::vector<GridworldGreedyPolicy::ActionProbability> GridworldGreedyPolicy::get_action_probabilities(const GridworldState &state) const {
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::get_action_probabilities(const State &state) const -> std::vector<ActionProbability> {
+    const size_t total_actions = ActionTraits<Action>::total_actions();
+    auto first = m_action_probabilities.cbegin() + static_cast<long>(m_gridworld->state_index(state) * total_actions);
+
     std::vector<ActionProbability> action_probability;
-    std::transform(m_state_action_probability_map.at(state).cbegin(), m_state_action_probability_map.at(state).cend(),
-                   std::back_inserter(action_probability), [](const auto& val){
-        return ActionProbability{val.first, val.second};
-    });
+    action_probability.reserve(total_actions);
+    for(size_t action_id = 0; action_id != total_actions; ++action_id){
+        action_probability.emplace_back(ActionTraits<Action>::from_id(action_id), first[static_cast<long>(action_id)]);
+    }
 
     return action_probability;
 }
 
-double GridworldGreedyPolicy::value_function(const GridworldState &state) const {
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::value_function(const State &state) const -> Reward {
     return value_from_table(state);
 }
 
-double GridworldGreedyPolicy::policy_evaluation() {
-    Probability delta = 0.0;
-    auto states = m_gridworld->get_states();
-    auto value_table_copy{ m_value_function_table };
+template<class TReward, class TProbability>
+void BasicGridworldGreedyPolicy<TReward, TProbability>::set_value_function(std::vector<Reward> values) {
+    if(values.size() != m_value_function_table.size())
+        throw std::invalid_argument("Value function must have a value per cell");
+    m_value_function_table = std::move(values);
+}
 
-    // Iterate on each state
-    for(const auto& state: states){
-        // Skip terminal states
-        if(m_gridworld->is_terminal_state(state)) continue;
-
-        Reward expected_value = 0.0;
-        for(const auto& [action, probability]: get_action_probabilities(state)){
-            auto srp_list = m_gridworld->get_transitions(state, action);
-            Reward expected_reward = std::transform_reduce(
-                    srp_list.begin(), srp_list.end(), 0.0,
-                    std::plus<>(), [this](const auto& srp){
-                        auto [s_i, r, p] = srp;
-                        return p * (r + m_gamma * value_from_table(s_i));
-                    });
-            expected_value += expected_reward * probability;
-        }
+template<class TReward, class TProbability>
+double BasicGridworldGreedyPolicy<TReward, TProbability>::policy_evaluation() {
+    if(m_evaluation_mode == EvaluationMode::GAUSS_SEIDEL) return gauss_seidel_sweep();
 
-        auto [row, col] = state;
-        value_table_copy[row * m_columns + col] = expected_value;
-        delta = std::max(delta, std::abs(value_from_table(state) - expected_value));
+    update_stencil_mask();
+    auto value_table_copy{ m_value_function_table };
+    Reward delta{};
+
+    if(m_execution_mode == ExecutionMode::PARALLEL){
+        // Blocks only read the old table, and the max reduction does not depend on the order of the blocks
+        delta = m_arena->execute([&]{
+            return detail::parallel_reduce(size_t{0}, m_value_function_table.size(), SWEEP_BLOCK_SIZE, Reward{},
+                    [&](size_t begin, size_t end, Reward block_delta){
+                        return std::max(block_delta, evaluate_states(begin, end, value_table_copy));
+                    },
+                    [](Reward a, Reward b){ return std::max(a, b); });
+        });
+    } else {
+        delta = evaluate_states(0, m_value_function_table.size(), value_table_copy);
     }
 
     m_value_function_table = std::move(value_table_copy);
@@ -318,47 +605,230 @@ double GridworldGreedyPolicy::policy_evaluation() {
     return delta;
 }
 
-bool GridworldGreedyPolicy::update_policy() {
-    // Store if the policy was changed or not
-    bool policy_changed = false;
+template<class TReward, class TProbability>
+LinearSolverResult BasicGridworldGreedyPolicy<TReward, TProbability>::evaluate_exact(const LinearSolverSettings &settings) {
+    const size_t total_actions = ActionTraits<Action>::total_actions();
+    const size_t total_states = m_value_function_table.size();
+
+    // The system is solved in double precision for every table type
+    PolicySystemBuilder<double> system(total_states, static_cast<double>(m_gamma));
+    for(size_t idx = 0; idx != total_states; ++idx){
+        if(is_terminal(idx)){
+            system.fixed_row(m_value_function_table[idx]);
+            continue;
+        }
+
+        for(size_t action_id = 0; action_id != total_actions; ++action_id){
+            double probability = m_action_probabilities[idx * total_actions + action_id];
+            if(probability == 0.0) continue;
 
-    // Iterate on each state-action
-    for(const auto& s: m_gridworld->get_states()){
-        std::set<Action> best_actions;
-        Probability best_action_reward = -std::numeric_limits<Probability>::infinity();
-
-        for(const auto& a: m_gridworld->get_actions(s)) {
-            auto srp_list = m_gridworld->get_transitions(s, a);
-            Reward expected_reward = std::transform_reduce(
-                    srp_list.begin(), srp_list.end(), 0.0,
-                    std::plus<>(), [this](const auto& srp){
-                        auto [s_i, r, p] = srp;
-                        return p * (r + m_gamma * value_from_table(s_i));
-                    });
-
-            // Get best action
-            if(expected_reward > best_action_reward){
-                best_actions.clear();
-                best_actions.insert(a);
-                best_action_reward = expected_reward;
-            } else if(expected_reward == best_action_reward){
-                best_actions.insert(a);
+            auto add = [&system, probability](size_t s_i, const Reward& r, const Probability& p){
+                system.add(s_i, r, probability * p);
+            };
+            if(m_compiled){
+                auto range = m_compiled->transitions(idx, action_id);
+                for(size_t i = 0; i != range.size; ++i) add(range.successors[i], range.rewards[i], range.probabilities[i]);
+            } else {
+                m_gridworld->for_each_indexed_transition(idx, ActionTraits<Action>::from_id(action_id), add);
             }
         }
+        system.end_row();
+    }
 
-        // Set the probabilities to the best action
-        Probability new_probability = 1.0 / static_cast<Probability>(best_actions.size());
-        auto ap_map = m_state_action_probability_map[s];
-        for(const auto& [action, p]: ap_map){
-            if(best_actions.find(action) != best_actions.end()){
-                m_state_action_probability_map[s][action] = new_probability;
-            } else {
-                m_state_action_probability_map[s][action] = 0.0;
+    std::vector<double> values(m_value_function_table.begin(), m_value_function_table.end());
+    auto result = bicgstab(system.matrix(), system.rhs(), values, settings);
+    if(result.converged){
+        std::transform(values.begin(), values.end(), m_value_function_table.begin(),
+                       [](double value){ return static_cast<Reward>(value); });
+    }
+
+    return result;
+}
+
+template<class TReward, class TProbability>
+bool BasicGridworldGreedyPolicy<TReward, TProbability>::update_policy() {
+    // The incremental improvements start again from every state
+    m_dirty_states.reset();
+    return improve_all_states() != 0;
+}
+
+template<class TReward, class TProbability>
+size_t BasicGridworldGreedyPolicy<TReward, TProbability>::update_policy_incremental(double tolerance) {
+    size_t revision = m_compiled ? m_compiled->revision() : m_gridworld->revision();
+    if(!m_dirty_states.is_tracking(revision)){
+        size_t changed_states = improve_all_states();
+        if(m_compiled){
+            m_dirty_states.track(*m_compiled, revision, m_value_function_table);
+        } else {
+            m_dirty_states.track(*m_gridworld, revision, m_value_function_table);
+        }
+        return changed_states;
+    }
+
+    size_t changed_states = 0;
+    for(size_t idx: m_dirty_states.collect(m_value_function_table, tolerance)){
+        if(improve_state(idx)) ++changed_states;
+    }
+    return changed_states;
+}
+
+template<class TReward, class TProbability>
+size_t BasicGridworldGreedyPolicy<TReward, TProbability>::improve_all_states() {
+    if(m_execution_mode == ExecutionMode::PARALLEL){
+        // Every block only writes the probabilities of its own states
+        return m_arena->execute([&]{
+            return detail::parallel_reduce(size_t{0}, m_value_function_table.size(), SWEEP_BLOCK_SIZE, size_t{0},
+                    [&](size_t begin, size_t end, size_t block_changed){
+                        return block_changed + improve_states(begin, end);
+                    },
+                    [](size_t a, size_t b){ return a + b; });
+        });
+    }
+
+    return improve_states(0, m_value_function_table.size());
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::evaluate_states(size_t begin, size_t end,
+                                                                        std::vector<Reward> &new_values) const -> Reward {
+    Reward delta{};
+
+    // Iterate on each state
+    for(size_t idx = begin; idx != end; ++idx){
+        // Runs of default cells are backed up as a stencil. Runs never wrap around a row, the border is not in
+        // the mask.
+        if(!m_stencil_mask.empty() && m_stencil_mask[idx] != 0){
+            size_t run_end = idx + 1;
+            while(run_end != end && m_stencil_mask[run_end] != 0) ++run_end;
+
+            if constexpr (std::is_same_v<Reward, Probability>){
+                delta = std::max(delta, detail::stencil_backup(m_value_function_table.data(), m_columns,
+                        m_action_probabilities.data(), m_gridworld->get_cost_of_living(), m_gamma,
+                        idx, run_end - idx, new_values.data()));
             }
+            idx = run_end - 1;
+            continue;
+        }
+
+        // Skip terminal states
+        if(is_terminal(idx)) continue;
+
+        Reward expected_value = state_value(idx);
+        new_values[idx] = expected_value;
+        delta = std::max(delta, std::abs(m_value_function_table[idx] - expected_value));
+    }
+
+    return delta;
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::gauss_seidel_sweep() -> Reward {
+    Reward delta{};
+    auto backup = [this, &delta](size_t idx){
+        if(is_terminal(idx)) return;
+
+        Reward expected_value = state_value(idx);
+        delta = std::max(delta, std::abs(m_value_function_table[idx] - expected_value));
+        m_value_function_table[idx] = expected_value;
+    };
+
+    const size_t total_states = m_value_function_table.size();
+    switch(m_sweep_order){
+        case SweepOrder::FORWARD:
+            for(size_t idx = 0; idx != total_states; ++idx) backup(idx);
+            break;
+        case SweepOrder::REVERSE:
+            for(size_t idx = total_states; idx-- != 0;) backup(idx);
+            break;
+        case SweepOrder::FROM_TERMINALS:
+            for(size_t idx: sweep_states()) backup(idx);
+            break;
+    }
+
+    return delta;
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::sweep_states() -> const std::vector<size_t>& {
+    size_t revision = m_compiled ? m_compiled->revision() : m_gridworld->revision();
+    if(m_sweep_revision != revision){
+        m_sweep_states = m_compiled ? detail::sweep_order(*m_compiled, m_sweep_order) :
+                detail::sweep_order(*m_gridworld, m_sweep_order);
+        m_sweep_revision = revision;
+    }
+    return m_sweep_states;
+}
+
+template<class TReward, class TProbability>
+void BasicGridworldGreedyPolicy<TReward, TProbability>::update_stencil_mask() {
+    // The kernel reads the probabilities and the values as a single type
+    if(m_compiled || !std::is_same_v<Reward, Probability>){
+        m_stencil_mask.clear();
+        m_stencil_revision.reset();
+        return;
+    }
+
+    if(m_stencil_revision != m_gridworld->revision()){
+        m_stencil_mask = m_gridworld->default_dynamics_mask();
+        m_stencil_revision = m_gridworld->revision();
+    }
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::state_value(size_t state_idx) const -> Reward {
+    const size_t total_actions = ActionTraits<Action>::total_actions();
+
+    Reward expected_value = 0.0;
+    for(size_t action_id = 0; action_id != total_actions; ++action_id){
+        Probability probability = m_action_probabilities[state_idx * total_actions + action_id];
+        if(probability == 0.0) continue;
+
+        expected_value += action_value(state_idx, ActionTraits<Action>::from_id(action_id)) * probability;
+    }
+
+    return expected_value;
+}
+
+template<class TReward, class TProbability>
+size_t BasicGridworldGreedyPolicy<TReward, TProbability>::improve_states(size_t begin, size_t end) {
+    size_t changed_states = 0;
+    for(size_t idx = begin; idx != end; ++idx){
+        if(improve_state(idx)) ++changed_states;
+    }
+    return changed_states;
+}
+
+template<class TReward, class TProbability>
+bool BasicGridworldGreedyPolicy<TReward, TProbability>::improve_state(size_t state_idx) {
+    constexpr size_t total_actions = ActionTraits<Action>::total_actions();
+    std::array<Reward, total_actions> action_values{};
+
+    auto first = m_action_probabilities.begin() + static_cast<long>(state_idx * total_actions);
+    Reward best_action_reward = -std::numeric_limits<Reward>::infinity();
+    size_t best_actions = 0;
+
+    // Every action is available in a gridworld cell
+    for(size_t action_id = 0; action_id != total_actions; ++action_id) {
+        action_values[action_id] = action_value(state_idx, ActionTraits<Action>::from_id(action_id));
+
+        // Get best action
+        if(action_values[action_id] > best_action_reward){
+            best_action_reward = action_values[action_id];
+            best_actions = 1;
+        } else if(action_values[action_id] == best_action_reward){
+            ++best_actions;
         }
+    }
+
+    // Set the probabilities to the best action
+    bool policy_changed = false;
+    Probability new_probability = 1.0 / static_cast<Probability>(best_actions);
+    for(size_t action_id = 0; action_id != total_actions; ++action_id){
+        Probability p = action_values[action_id] == best_action_reward ? new_probability : Probability{};
 
         // Check if the policy changed
-        if(ap_map != m_state_action_probability_map[s]){
+        if(first[static_cast<long>(action_id)] != p){
+            first[static_cast<long>(action_id)] = p;
             policy_changed = true;
         }
     }
@@ -366,20 +836,84 @@ bool GridworldGreedyPolicy::update_policy() {
     return policy_changed;
 }
 
-std::shared_ptr<Gridworld> GridworldGreedyPolicy::get_gridworld() const{
+template<class TReward, class TProbability>
+void BasicGridworldGreedyPolicy<TReward, TProbability>::set_execution_mode(ExecutionMode mode, size_t max_threads) {
+    m_execution_mode = mode;
+    m_arena = mode == ExecutionMode::PARALLEL ? std::make_shared<detail::TaskArena>(max_threads) : nullptr;
+}
+
+template<class TReward, class TProbability>
+void BasicGridworldGreedyPolicy<TReward, TProbability>::set_evaluation_mode(EvaluationMode mode, SweepOrder order) {
+    m_evaluation_mode = mode;
+    m_sweep_order = order;
+    m_sweep_revision.reset();
+}
+
+template<class TReward, class TProbability>
+void BasicGridworldGreedyPolicy<TReward, TProbability>::compile_model() {
+    set_compiled_model(std::make_shared<const CompiledGridworld>(*m_gridworld));
+}
+
+template<class TReward, class TProbability>
+void BasicGridworldGreedyPolicy<TReward, TProbability>::set_compiled_model(std::shared_ptr<const CompiledGridworld> compiled) {
+    if(compiled){
+        // State indices must match the layout of the value function table
+        if(compiled->num_states() != m_gridworld->num_states())
+            throw std::invalid_argument("Compiled model does not match the gridworld dimensions");
+        for(size_t idx = 0; idx != compiled->num_states(); ++idx){
+            if(compiled->state_at(idx) != m_gridworld->state_at(idx))
+                throw std::invalid_argument("Compiled model states are not in row-major order");
+        }
+    }
+
+    m_compiled = std::move(compiled);
+    m_sweep_revision.reset();
+    m_dirty_states.reset();
+}
+
+template<class TReward, class TProbability>
+bool BasicGridworldGreedyPolicy<TReward, TProbability>::is_terminal(size_t state_idx) const {
+    if(m_compiled){
+        return m_compiled->is_terminal(state_idx);
+    }
+    return m_gridworld->is_terminal_state(m_gridworld->state_at(state_idx));
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::action_value(size_t state_idx, const Action &action) const -> Reward {
+    // Compiled model - iterate over the flat arrays
+    if(m_compiled){
+        auto range = m_compiled->transitions(state_idx, ActionTraits<Action>::id(action));
+        Reward value = 0.0;
+        for(size_t i = 0; i != range.size; ++i){
+            value += range.probabilities[i] * (range.rewards[i] + m_gamma * m_value_function_table[range.successors[i]]);
+        }
+        return value;
+    }
+
+    Reward value = 0.0;
+    m_gridworld->for_each_indexed_transition(state_idx, action, [this, &value](size_t s_i, const Reward& r, const Probability& p){
+        value += p * (r + m_gamma * m_value_function_table[s_i]);
+    });
+    return value;
+}
+
+template<class TReward, class TProbability>
+auto BasicGridworldGreedyPolicy<TReward, TProbability>::get_gridworld() const -> std::shared_ptr<Gridworld> {
     return m_gridworld;
 }
 
-std::ostream &operator<<(std::ostream &os, const Gridworld::State& state) {
+std::ostream &operator<<(std::ostream &os, const GridworldState& state) {
     os << "(" << state.row << "," << state.column << ")";
     return os;
 }
 
-std::ostream &operator<<(std::ostream &os, const GridworldGreedyPolicy &greedy_policy) {
+template<class TReward, class TProbability>
+std::ostream &operator<<(std::ostream &os, const BasicGridworldGreedyPolicy<TReward, TProbability> &greedy_policy) {
     auto gridworld = greedy_policy.get_gridworld();
     for (size_t row = 0; row < gridworld->get_rows(); ++row) {
         for (size_t col = 0; col < gridworld->get_columns(); ++col) {
-            Gridworld::State s{row, col};
+            GridworldState s{row, col};
             auto actions = greedy_policy.get_action_probabilities(s);
 
             // Print the best action
@@ -410,3 +944,13 @@ std::ostream &operator<<(std::ostream &os, const GridworldGreedyPolicy &greedy_p
 
     return os;
 }
+
+namespace rl::mdp {
+    template class BasicGridworld<double>;
+    template class BasicGridworld<float>;
+    template class BasicGridworldGreedyPolicy<double>;
+    template class BasicGridworldGreedyPolicy<float>;
+} // namespace rl::mdp
+
+template std::ostream &operator<<(std::ostream &os, const GridworldGreedyPolicy &greedy_policy);
+template std::ostream &operator<<(std::ostream &os, const FloatGridworldGreedyPolicy &greedy_policy);
@@ -0,0 +1,55 @@
+#include <mdp/snapshot.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace rl::mdp;
+
+MappedFile::MappedFile(const std::string &path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) throw std::runtime_error("Cannot open snapshot: " + path);
+
+    struct stat file_stat{};
+    if(::fstat(fd, &file_stat) != 0){
+        ::close(fd);
+        throw std::runtime_error("Cannot read snapshot size: " + path);
+    }
+    m_size = static_cast<size_t>(file_stat.st_size);
+
+    if(m_size > 0){
+        void* address = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if(address != MAP_FAILED){
+            m_data = static_cast<const std::byte*>(address);
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+
+    if(m_mapped || m_size == 0) return;
+#endif
+
+    // Read the whole file when it cannot be mapped
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if(!input) throw std::runtime_error("Cannot open snapshot: " + path);
+
+    m_size = static_cast<size_t>(input.tellg());
+    input.seekg(0);
+    m_buffer = std::make_unique<std::byte[]>(m_size);
+    input.read(reinterpret_cast<char*>(m_buffer.get()), static_cast<std::streamsize>(m_size));
+    if(!input) throw std::runtime_error("Cannot read snapshot: " + path);
+    m_data = m_buffer.get();
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if(m_mapped) ::munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+}
@@ -43,4 +43,105 @@ TEMPLATE_TEST_CASE("Gridworld Agents", "[gridworld][agents]",
     if (results.reached_terminal_state) {
         REQUIRE(results.last_state == final_state);
     }
-}
\ No newline at end of file
+}
+TEMPLATE_TEST_CASE("Float Gridworld Agents", "[gridworld][agents][float]",
+                   (BasicRandomAgent<GridworldState, GridworldAction, float>),
+                   (MCAgent<GridworldState, GridworldAction, float>),
+                   (TD0Agent<GridworldState, GridworldAction, float>)) {
+    auto gridworld = std::make_shared<FloatGridworld>(4, 4);
+    gridworld->cost_of_living(-1.0f);
+    gridworld->set_initial_state({0, 0});
+    gridworld->set_terminal_state({3, 3}, 0.0f);
+
+    using Environment = MDPEnvironment<FloatGridworld>;
+    using Agent = TestType;
+    static_assert(std::is_same_v<typename Agent::Reward, float>);
+    auto environment = std::make_shared<Environment>(gridworld, 42);
+
+    auto agent = std::make_shared<Agent>();
+
+    MDPExperiment<Environment, Agent> experiment(1000);
+    for (size_t episode = 0; episode != 5; ++episode) {
+        auto results = experiment.do_episode(environment, agent);
+        REQUIRE(results.total_steps > 0);
+        REQUIRE(results.total_reward <= 0.0f);
+    }
+}
+
+TEST_CASE("State indexers", "[agents][indexer]") {
+    SECTION("Generic indexer") {
+        StateIndexer<std::string> indexer;
+        REQUIRE(indexer.size() == 0);
+        REQUIRE_FALSE(indexer.find("A").has_value());
+
+        REQUIRE(indexer.index("A") == 0);
+        REQUIRE(indexer.index("B") == 1);
+        REQUIRE(indexer.index("A") == 0);
+        REQUIRE(indexer.size() == 2);
+        REQUIRE(indexer.find("B") == 1);
+        REQUIRE(indexer.state(1) == "B");
+    }
+
+    SECTION("Gridworld indexer") {
+        Gridworld gridworld(3, 4);
+        auto indexer = gridworld.state_indexer();
+        REQUIRE(indexer.size() == 12);
+        for (size_t idx = 0; idx != indexer.size(); ++idx) {
+            auto state = indexer.state(idx);
+            REQUIRE(indexer.index(state) == idx);
+            REQUIRE(gridworld.state_index(state) == idx);
+            REQUIRE(gridworld.state_at(idx) == state);
+        }
+        REQUIRE_FALSE(indexer.find(GridworldState{3, 0}).has_value());
+    }
+
+    SECTION("Agents with a gridworld indexer") {
+        auto gridworld = std::make_shared<Gridworld>(4, 4);
+        gridworld->set_initial_state({0, 0});
+        gridworld->set_terminal_state({3, 3}, 0.0);
+
+        using Environment = MDPEnvironment<Gridworld>;
+        using Agent = TD0Agent<GridworldState, GridworldAction, double, GridworldStateIndexer>;
+        auto environment = std::make_shared<Environment>(gridworld, 42);
+        auto agent = std::make_shared<Agent>(0.5, 1.0, 0.1, 42, gridworld->state_indexer());
+
+        MDPExperiment<Environment, Agent> experiment(1000);
+        auto results = experiment.do_episode(environment, agent);
+        REQUIRE(results.total_steps > 0);
+    }
+}
+
+TEST_CASE("Batched experiments", "[agents][experiment]") {
+    auto gridworld = std::make_shared<Gridworld>(4, 4);
+    GridworldState final_state{3, 3};
+    gridworld->set_initial_state({0, 0});
+    gridworld->set_terminal_state(final_state, 0.0);
+
+    using Environment = VectorMDPEnvironment<Gridworld>;
+    using Agent = TD0Agent<GridworldState, GridworldAction, double, GridworldStateIndexer>;
+    size_t num_environments = 8, max_steps = 50, total_episodes = 40;
+    auto environment = std::make_shared<Environment>(gridworld, num_environments, 42);
+
+    std::vector<std::shared_ptr<Agent>> agents;
+    for (size_t i = 0; i < num_environments; ++i) {
+        agents.push_back(std::make_shared<Agent>(0.5, 1.0, 0.1, 42 + i, gridworld->state_indexer()));
+    }
+
+    MDPExperiment<MDPEnvironment<Gridworld>, Agent> experiment(max_steps);
+    auto results = experiment.do_episodes(environment, agents, total_episodes);
+    REQUIRE(results.size() == total_episodes);
+
+    for (const auto& episode: results) {
+        REQUIRE(episode.total_steps > 0);
+        REQUIRE(episode.total_steps <= max_steps);
+        if (episode.reached_terminal_state) {
+            REQUIRE(episode.last_state == final_state);
+            REQUIRE(episode.total_reward <= 0.0);
+        } else {
+            REQUIRE(episode.total_steps == max_steps);
+        }
+    }
+
+    agents.pop_back();
+    REQUIRE_THROWS_AS(experiment.do_episodes(environment, agents, total_episodes), std::invalid_argument);
+}
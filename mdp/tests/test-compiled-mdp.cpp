@@ -0,0 +1,275 @@
+#include <mdp/compiled_mdp.h>
+#include <mdp/gridworld.h>
+#include <mdp/graph.h>
+#include <mdp/graph_policy.h>
+
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <map>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+using namespace Catch::literals;
+using Catch::Approx;
+using rl::mdp::Gridworld;
+using rl::mdp::CompiledGridworld;
+using rl::mdp::ActionTraits;
+
+TEST_CASE("CompiledMDP from Gridworld", "[compiled][gridworld]") {
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+
+    size_t rows = 4, columns = 3;
+    auto g = std::make_shared<Gridworld>(rows, columns);
+    g->cost_of_living(-1.0);
+    g->add_transition(State{1, 1}, Action::LEFT, State{0, 0}, 5.0, 1.0);
+    g->add_transition(State{1, 1}, Action::LEFT, State{2, 2}, 10.0, 3.0);
+    g->set_initial_state(State{0, 0});
+    g->set_terminal_state(State{3, 2}, 1.0);
+    g->set_wall_state(State{2, 1}, -2.0);
+
+    CompiledGridworld compiled(*g);
+
+    SECTION("Indices") {
+        REQUIRE(compiled.num_states() == rows * columns);
+        for (size_t idx = 0; idx != compiled.num_states(); ++idx) {
+            State s = compiled.state_at(idx);
+            REQUIRE(s == State{idx / columns, idx % columns});
+            REQUIRE(compiled.state_index(s) == idx);
+        }
+        REQUIRE_THROWS(compiled.state_index(State{rows, columns}));
+    }
+
+    SECTION("Same dynamics") {
+        for (const auto& s: g->get_states()) {
+            INFO("State: " << s);
+            REQUIRE(compiled.is_terminal_state(s) == g->is_terminal_state(s));
+            REQUIRE(compiled.is_initial_state(s) == g->is_initial_state(s));
+
+            for (const auto& a: ActionTraits<Action>::available_actions()) {
+                INFO("Action: " << a);
+                auto expected = g->get_transitions(s, a);
+                auto transitions = compiled.get_transitions(s, a);
+                REQUIRE(transitions.size() == expected.size());
+
+                // Probabilities are normalised and the cumulative values end in 1.0
+                auto range = compiled.transitions(compiled.state_index(s), ActionTraits<Action>::id(a));
+                REQUIRE(range.size == expected.size());
+                REQUIRE(range.cumulative[range.size - 1] == 1.0_a);
+                double total_probability = 0.0;
+                for (const auto& srp: expected) total_probability += Gridworld::srp_probability(srp);
+
+                for (size_t i = 0; i != transitions.size(); ++i) {
+                    auto [s_i, r, p] = transitions[i];
+                    REQUIRE(s_i == Gridworld::srp_state(expected[i]));
+                    REQUIRE(r == Approx(Gridworld::srp_reward(expected[i])));
+                    REQUIRE(p == Approx(Gridworld::srp_probability(expected[i]) / total_probability));
+                }
+            }
+        }
+    }
+
+    SECTION("Read-only") {
+        REQUIRE_THROWS_AS(compiled.add_transition(State{0, 0}, Action::LEFT, State{0, 1}, 0.0, 1.0), std::logic_error);
+        REQUIRE_THROWS_AS(compiled.set_terminal_state(State{0, 0}, std::nullopt), std::logic_error);
+    }
+
+    SECTION("Sampling") {
+        auto idx = compiled.state_index(State{1, 1});
+        auto action_id = ActionTraits<Action>::id(Action::LEFT);
+        auto range = compiled.transitions(idx, action_id);
+
+        REQUIRE(range.successors[compiled.sample(idx, action_id, 0.1)] == compiled.state_index(State{0, 0}));
+        REQUIRE(range.successors[compiled.sample(idx, action_id, 0.9)] == compiled.state_index(State{2, 2}));
+    }
+
+    SECTION("Environment") {
+        using Environment = rl::mdp::MDPEnvironment<CompiledGridworld>;
+        auto compiled_ptr = std::make_shared<CompiledGridworld>(*g);
+        Environment env(compiled_ptr, 42);
+
+        REQUIRE(env.start() == State{0, 0});
+        auto [s_i, r, is_final] = env.step(Action::RIGHT);
+        REQUIRE(s_i == State{0, 1});
+        REQUIRE(r == -1.0_a);
+        REQUIRE_FALSE(is_final);
+    }
+}
+
+TEST_CASE("Policies with compiled models", "[compiled]") {
+    SECTION("GridworldGreedyPolicy") {
+        using State = Gridworld::State;
+        auto g = std::make_shared<Gridworld>(4, 4);
+        g->cost_of_living(-1.0);
+        g->set_terminal_state(State{0, 0}, std::nullopt);
+        g->set_terminal_state(State{3, 3}, std::nullopt);
+
+        rl::mdp::GridworldGreedyPolicy policy(g, 1.0), compiled_policy(g, 1.0);
+        compiled_policy.compile_model();
+
+        for (size_t iteration = 0; iteration != 5; ++iteration) {
+            REQUIRE(compiled_policy.policy_evaluation() == Approx(policy.policy_evaluation()));
+            REQUIRE(compiled_policy.update_policy() == policy.update_policy());
+        }
+
+        for (const auto& s: g->get_states()) {
+            INFO("State: " << s);
+            REQUIRE(compiled_policy.value_function(s) == Approx(policy.value_function(s)));
+        }
+
+        // Models of different sizes are rejected
+        auto other = std::make_shared<const CompiledGridworld>(Gridworld(2, 2));
+        REQUIRE_THROWS(compiled_policy.set_compiled_model(other));
+    }
+
+    SECTION("GraphMDP_Greedy") {
+        using State = std::string;
+        using Action = rl::mdp::TwoWayAction;
+        auto g = std::make_shared<rl::mdp::GraphMDP<State, Action>>();
+
+        std::array<State, 6> states{"A", "B", "C", "D", "E", "GOOD"};
+        for (size_t i = 0; i + 1 < states.size(); ++i) {
+            g->add_transition(states[i], Action::RIGHT, states[i + 1], -1.0, 1.0);
+            g->add_transition(states[i + 1], Action::LEFT, states[i], -1.0, 1.0);
+        }
+        g->set_terminal_state("GOOD", 1.0);
+
+        rl::mdp::GraphMDP_Greedy<State, Action> policy(g, 1.0), compiled_policy(g, 1.0);
+        compiled_policy.compile_model();
+
+        for (size_t iteration = 0; iteration != 10; ++iteration) {
+            REQUIRE(compiled_policy.policy_evaluation() == Approx(policy.policy_evaluation()));
+            REQUIRE(compiled_policy.update_policy() == policy.update_policy());
+        }
+
+        for (const auto& s: states) {
+            INFO("State: " << s);
+            REQUIRE(compiled_policy.value_function(s) == Approx(policy.value_function(s)));
+        }
+    }
+}
+
+TEST_CASE("CompiledMDP snapshots", "[compiled][snapshot]") {
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+
+    auto g = std::make_shared<Gridworld>(5, 4);
+    g->cost_of_living(-1.0);
+    g->add_transition(State{1, 1}, Action::LEFT, State{0, 0}, 5.0, 1.0);
+    g->add_transition(State{1, 1}, Action::LEFT, State{2, 2}, 10.0, 3.0);
+    g->set_initial_state(State{0, 0});
+    g->set_terminal_state(State{4, 3}, 1.0);
+    g->set_wall_state(State{2, 1}, -2.0);
+
+    CompiledGridworld compiled(*g);
+    auto path = (std::filesystem::temp_directory_path() / "rl-mdp-test-snapshot.bin").string();
+    compiled.save(path);
+
+    SECTION("Same model") {
+        auto loaded = CompiledGridworld::load(path);
+        REQUIRE(loaded.num_states() == compiled.num_states());
+        REQUIRE(loaded.num_transitions() == compiled.num_transitions());
+        REQUIRE(loaded.get_initial_states() == compiled.get_initial_states());
+        REQUIRE(loaded.get_terminal_states() == compiled.get_terminal_states());
+
+        for (size_t idx = 0; idx != compiled.num_states(); ++idx) {
+            State s = compiled.state_at(idx);
+            INFO("State: " << s);
+            REQUIRE(loaded.state_at(idx) == s);
+            REQUIRE(loaded.state_index(s) == idx);
+            REQUIRE(loaded.is_wall(idx) == g->is_wall_state(s));
+            REQUIRE(loaded.is_terminal(idx) == compiled.is_terminal(idx));
+
+            for (const auto& a: ActionTraits<Action>::available_actions()) {
+                REQUIRE(loaded.get_transitions(s, a) == compiled.get_transitions(s, a));
+                auto range = loaded.transitions(idx, ActionTraits<Action>::id(a));
+                auto expected = compiled.transitions(idx, ActionTraits<Action>::id(a));
+                REQUIRE(std::equal(range.cumulative, range.cumulative + range.size, expected.cumulative));
+            }
+        }
+        REQUIRE_THROWS_AS(loaded.state_index(State{5, 0}), std::out_of_range);
+
+        // Initial states can still be changed
+        loaded.set_initial_state(State{1, 0});
+        REQUIRE(loaded.is_initial_state(State{1, 0}));
+        REQUIRE_FALSE(CompiledGridworld::load(path).is_initial_state(State{1, 0}));
+    }
+
+    SECTION("Environment and policy") {
+        auto loaded = std::make_shared<CompiledGridworld>(CompiledGridworld::load(path));
+        rl::mdp::MDPEnvironment<CompiledGridworld> env(loaded, 42);
+        REQUIRE(env.start() == State{0, 0});
+        auto [s_i, r, is_final] = env.step(Action::RIGHT);
+        REQUIRE(s_i == State{0, 1});
+        REQUIRE(r == -1.0_a);
+
+        rl::mdp::GridworldGreedyPolicy policy(g, 1.0), loaded_policy(g, 1.0);
+        policy.compile_model();
+        loaded_policy.set_compiled_model(loaded);
+        for (size_t iteration = 0; iteration != 5; ++iteration) {
+            REQUIRE(loaded_policy.policy_evaluation() == Approx(policy.policy_evaluation()));
+            REQUIRE(loaded_policy.update_policy() == policy.update_policy());
+        }
+    }
+
+    SECTION("Invalid files") {
+        auto invalid_path = (std::filesystem::temp_directory_path() / "rl-mdp-test-invalid.bin").string();
+        {
+            std::ofstream output(invalid_path, std::ios::binary);
+            output << "not a snapshot, but long enough to hold a header..........................................";
+        }
+        REQUIRE_THROWS_AS(CompiledGridworld::load(invalid_path), std::runtime_error);
+
+        // Truncated snapshot
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+        REQUIRE_THROWS_AS(CompiledGridworld::load(path), std::runtime_error);
+
+        // Different model type
+        compiled.save(path);
+        using OtherMDP = rl::mdp::CompiledMDP<State, rl::mdp::TwoWayAction>;
+        REQUIRE_THROWS_AS(OtherMDP::load(path), std::runtime_error);
+
+        // Corrupted headers with the right file size
+        compiled.save(path);
+        std::vector<char> bytes(std::filesystem::file_size(path));
+        {
+            std::ifstream input(path, std::ios::binary);
+            input.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        auto load_corrupted = [&](const auto& corrupt) {
+            auto corrupted = bytes;
+            rl::mdp::SnapshotHeader header{};
+            std::memcpy(&header, corrupted.data(), sizeof(header));
+            corrupt(header, corrupted);
+            std::memcpy(corrupted.data(), &header, sizeof(header));
+
+            std::ofstream output(invalid_path, std::ios::binary | std::ios::trunc);
+            output.write(corrupted.data(), static_cast<std::streamsize>(corrupted.size()));
+            output.close();
+            return CompiledGridworld::load(invalid_path);
+        };
+        REQUIRE_NOTHROW(load_corrupted([](auto&, auto&) {}));
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto&) { header.num_states *= 1000; }), std::runtime_error);
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto&) { header.num_transitions += 1; }), std::runtime_error);
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto&) { header.cumulative = header.file_size - 8; }), std::runtime_error);
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto&) { header.rewards += 8; }), std::runtime_error);
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto&) { header.offsets = ~uint64_t{0} - 63; }), std::runtime_error);
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto& corrupted) {
+            // Offsets out of order
+            uint64_t offset = 1000;
+            std::memcpy(corrupted.data() + header.offsets + sizeof(uint64_t), &offset, sizeof(offset));
+        }), std::runtime_error);
+        REQUIRE_THROWS_AS(load_corrupted([](auto& header, auto& corrupted) {
+            // Successor out of the states
+            uint64_t successor = header.num_states;
+            std::memcpy(corrupted.data() + header.successors, &successor, sizeof(successor));
+        }), std::runtime_error);
+
+        REQUIRE_THROWS_AS(CompiledGridworld::load(invalid_path + ".missing"), std::runtime_error);
+        std::filesystem::remove(invalid_path);
+    }
+
+    std::filesystem::remove(path);
+}
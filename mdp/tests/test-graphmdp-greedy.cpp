@@ -3,6 +3,9 @@
 #include <mdp/actions.h>
 
 #include <catch2/catch_all.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
 
 using namespace Catch::literals;
 using Catch::Approx;
@@ -136,3 +139,144 @@ TEST_CASE("GraphMDP GreedyPolicy", "[graphmdp]"){
     }
 }
 
+
+TEST_CASE("GraphMDP GreedyPolicy in-place evaluation", "[graphmdp][gauss_seidel]"){
+    auto g = std::make_shared<GraphMDP<State, Action>>();
+
+    // Chain with the goal at the end, states are added from the start
+    std::vector<State> states;
+    for(size_t i = 0; i != 20; ++i) states.push_back("S" + std::to_string(i));
+    states.emplace_back("GOOD");
+    for(size_t i = 0; i + 1 != states.size(); ++i){
+        g->add_transition(states[i], Action::RIGHT, states[i + 1], -1.0, 1.0);
+        g->add_transition(states[i + 1], Action::LEFT, states[i], -1.0, 1.0);
+    }
+    g->add_transition(states[0], Action::LEFT, states[0], -1.0, 1.0);
+    g->set_terminal_state("GOOD", 1.0);
+
+    auto converge = [](GraphMDP_Greedy<State, Action>& policy){
+        size_t sweeps = 1;
+        while(policy.policy_evaluation() > 1e-10) ++sweeps;
+        return sweeps;
+    };
+
+    GraphMDP_Greedy<State, Action> reference(g, 0.9);
+    size_t jacobi_sweeps = converge(reference);
+
+    SECTION("Same fixed point"){
+        for(auto order: {rl::mdp::SweepOrder::FORWARD, rl::mdp::SweepOrder::REVERSE, rl::mdp::SweepOrder::FROM_TERMINALS}){
+            GraphMDP_Greedy<State, Action> policy(g, 0.9);
+            policy.set_evaluation_mode(rl::mdp::EvaluationMode::GAUSS_SEIDEL, order);
+            REQUIRE(converge(policy) <= jacobi_sweeps);
+
+            for(const auto& s: states){
+                INFO("State is " << s);
+                REQUIRE(policy.value_function(s) == Approx(reference.value_function(s)).margin(1e-8));
+            }
+        }
+    }
+
+    SECTION("Backward order needs fewer sweeps"){
+        GraphMDP_Greedy<State, Action> forward(g, 0.9), backward(g, 0.9);
+        forward.set_evaluation_mode(rl::mdp::EvaluationMode::GAUSS_SEIDEL, rl::mdp::SweepOrder::FORWARD);
+        backward.set_evaluation_mode(rl::mdp::EvaluationMode::GAUSS_SEIDEL, rl::mdp::SweepOrder::FROM_TERMINALS);
+        size_t forward_sweeps = converge(forward), backward_sweeps = converge(backward);
+        INFO("Jacobi: " << jacobi_sweeps << " forward: " << forward_sweeps << " backward: " << backward_sweeps);
+        REQUIRE(backward_sweeps < forward_sweeps);
+    }
+
+    SECTION("Swapped value buffers"){
+        // Bellman backups of the uniform policy computed by hand: both actions cost -1 except entering GOOD,
+        // which gives 1, and S0 bounces back to itself to the left
+        auto backup = [](const std::vector<double>& values){
+            std::vector<double> next(values.size(), 0.0);
+            for(size_t i = 0; i + 1 != values.size(); ++i){
+                double left = -1.0 + 0.9 * values[i == 0 ? 0 : i - 1];
+                double right = (i + 2 == values.size() ? 1.0 : -1.0) + 0.9 * values[i + 1];
+                next[i] = 0.5 * left + 0.5 * right;
+            }
+            return next;
+        };
+
+        // Every sweep reads the values of the previous one, whichever buffer holds them
+        for(bool compiled: {false, true}){
+            GraphMDP_Greedy<State, Action> policy(g, 0.9);
+            if(compiled) policy.compile_model();
+
+            std::vector<double> expected(states.size(), 0.0);
+            for(size_t sweep = 0; sweep != 5; ++sweep){
+                auto next = backup(expected);
+                double delta = 0.0;
+                for(size_t i = 0; i != next.size(); ++i) delta = std::max(delta, std::abs(next[i] - expected[i]));
+                expected = std::move(next);
+
+                REQUIRE(policy.policy_evaluation() == Approx(delta));
+                for(size_t i = 0; i != states.size(); ++i){
+                    INFO("Compiled " << compiled << " sweep " << sweep << " state is " << states[i]);
+                    REQUIRE(policy.value_function(states[i]) == Approx(expected[i]));
+                }
+
+                // First two sweeps worked out on paper
+                if(sweep == 0){
+                    REQUIRE(policy.value_function("S0") == -1.0_a);
+                    REQUIRE(policy.value_function("S18") == -1.0_a);
+                    REQUIRE(policy.value_function("S19") == 0.0_a);
+                } else if(sweep == 1){
+                    REQUIRE(policy.value_function("S0") == -1.9_a);
+                    REQUIRE(policy.value_function("S18") == -1.45_a);
+                    REQUIRE(policy.value_function("S19") == -0.45_a);
+                }
+            }
+        }
+
+        // A converged value function is a fixed point of the next sweep
+        REQUIRE(reference.policy_evaluation() <= 1e-10);
+        REQUIRE(reference.value_function("GOOD") == 0.0_a);
+        REQUIRE(reference.value_function(states.front()) < reference.value_function(states[states.size() - 2]));
+    }
+
+    SECTION("Exact evaluation"){
+        for(bool compiled: {false, true}){
+            GraphMDP_Greedy<State, Action> policy(g, 0.9);
+            if(compiled) policy.compile_model();
+
+            auto result = policy.evaluate_exact();
+            REQUIRE(result.converged);
+            REQUIRE(result.iterations < jacobi_sweeps);
+            for(const auto& s: states){
+                INFO("State is " << s);
+                REQUIRE(policy.value_function(s) == Approx(reference.value_function(s)).margin(1e-8));
+            }
+        }
+    }
+}
+
+
+TEST_CASE("GraphMDP GreedyPolicy w/ float", "[graphmdp][float]"){
+    auto g = std::make_shared<GraphMDP<State, Action>>();
+    auto g_float = std::make_shared<GraphMDP<State, Action, float, float>>();
+
+    std::array<State, 4> states{"A", "B", "C", "GOOD"};
+    for(size_t i = 0; i + 1 != states.size(); ++i){
+        g->add_transition(states[i], Action::RIGHT, states[i + 1], -1.0, 1.0);
+        g->add_transition(states[i + 1], Action::LEFT, states[i], -1.0, 1.0);
+        g_float->add_transition(states[i], Action::RIGHT, states[i + 1], -1.0f, 1.0f);
+        g_float->add_transition(states[i + 1], Action::LEFT, states[i], -1.0f, 1.0f);
+    }
+    g->set_terminal_state("GOOD", 1.0);
+    g_float->set_terminal_state("GOOD", 1.0f);
+
+    GraphMDP_Greedy<State, Action> policy(g, 0.9);
+    GraphMDP_Greedy<State, Action, float, float> policy_float(g_float, 0.9);
+    for(size_t iteration = 0; iteration != 5; ++iteration){
+        for(size_t sweep = 0; sweep != 10; ++sweep){
+            policy.policy_evaluation();
+            policy_float.policy_evaluation();
+        }
+        REQUIRE(policy_float.update_policy() == policy.update_policy());
+    }
+
+    for(const auto& s: states){
+        REQUIRE(policy_float.value_function(s) == Approx(policy.value_function(s)).epsilon(1e-4));
+    }
+}
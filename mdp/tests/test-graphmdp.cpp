@@ -1,4 +1,5 @@
 #include <mdp/graph.h>
+#include <mdp/compiled_mdp.h>
 #include <mdp/actions.h>
 
 #include <catch2/catch_all.hpp>
@@ -85,6 +86,35 @@ TEST_CASE("GraphMDP", "[graphmdp]") {
             REQUIRE(g.state_transition_probability("A", Action::LEFT, "B") == 0.3_a);
             REQUIRE(g.state_transition_probability("B", Action::RIGHT, "A") == 0.0_a);
         }
+
+        SECTION("Interleaved actions"){
+            g.add_transition("A", Action::RIGHT, "B", 1.0, 1);
+            g.add_transition("A", Action::LEFT, "C", 2.0, 1);
+            g.add_transition("A", Action::RIGHT, "C", 3.0, 3);
+            g.add_transition("A", Action::LEFT, "A", 4.0, 1);
+
+            // Transitions keep their insertion order within an action, with normalised probabilities
+            auto right = g.get_transitions("A", Action::RIGHT);
+            REQUIRE(right.size() == 2);
+            REQUIRE(std::get<0>(right[0]) == "B");
+            REQUIRE(std::get<2>(right[0]) == 0.25_a);
+            REQUIRE(std::get<0>(right[1]) == "C");
+            REQUIRE(std::get<1>(right[1]) == 3.0_a);
+            REQUIRE(std::get<2>(right[1]) == 0.75_a);
+
+            auto left = g.get_transitions("A", Action::LEFT);
+            REQUIRE(left.size() == 2);
+            REQUIRE(std::get<0>(left[0]) == "C");
+            REQUIRE(std::get<0>(left[1]) == "A");
+            REQUIRE(std::get<2>(left[1]) == 0.5_a);
+
+            // Actions are reported in id order
+            auto actions = g.get_actions("A");
+            REQUIRE(actions.size() == 2);
+            REQUIRE(ActionTraits<Action>::id(actions[0]) < ActionTraits<Action>::id(actions[1]));
+            REQUIRE(g.get_actions("B").empty());
+            REQUIRE(g.action_mask(g.state_index("B")) == 0);
+        }
     }
 
     SECTION("Expected reward"){
@@ -163,6 +193,98 @@ TEST_CASE("GraphMDP", "[graphmdp]") {
     }
 }
 
+TEST_CASE("GraphMDP batch construction", "[graphmdp]") {
+    using State = std::string;
+    using Action = rl::mdp::TwoWayAction;
+    using MDP = GraphMDP<State, Action>;
+
+    // Enough transitions to span several blocks, with repeated states across blocks
+    std::vector<MDP::Transition> transitions;
+    for (size_t i = 0; i != 40000; ++i) {
+        auto action = i % 3 == 0 ? Action::LEFT : Action::RIGHT;
+        transitions.emplace_back("S" + std::to_string(i % 7919), action, "S" + std::to_string((i * 31) % 10007),
+                                 static_cast<double>(i % 5), static_cast<double>(1 + i % 4));
+    }
+
+    MDP sequential, batch;
+    sequential.add_transition("S1", Action::RIGHT, "S2", 1.0, 2.0);
+    batch.add_transition("S1", Action::RIGHT, "S2", 1.0, 2.0);
+    for (const auto& [s, a, s_next, r, p]: transitions) sequential.add_transition(s, a, s_next, r, p);
+    batch.add_transitions(transitions);
+
+    // Same vertex ids and transitions as adding them one by one
+    REQUIRE(batch.num_states() == sequential.num_states());
+    for (size_t idx = 0; idx != sequential.num_states(); ++idx) {
+        REQUIRE(batch.state_at(idx) == sequential.state_at(idx));
+        for (const auto& action: ActionTraits<Action>::available_actions()) {
+            auto expected = sequential.get_transitions(sequential.state_at(idx), action);
+            auto result = batch.get_transitions(batch.state_at(idx), action);
+            REQUIRE(result.size() == expected.size());
+            for (size_t i = 0; i != expected.size(); ++i) {
+                REQUIRE(std::get<0>(result[i]) == std::get<0>(expected[i]));
+                REQUIRE(std::get<1>(result[i]) == Approx(std::get<1>(expected[i])));
+                REQUIRE(std::get<2>(result[i]) == Approx(std::get<2>(expected[i])));
+            }
+        }
+    }
+
+    // Transitions out of terminal states are rejected without changing the graph
+    batch.set_terminal_state("S2", std::nullopt);
+    std::vector<MDP::Transition> invalid{{"NEW", Action::LEFT, "S2", 0.0, 1.0}, {"S2", Action::LEFT, "S3", 0.0, 1.0}};
+    size_t total_states = batch.num_states();
+    REQUIRE_THROWS_AS(batch.add_transitions(invalid), std::invalid_argument);
+    REQUIRE(batch.num_states() == total_states);
+
+    batch.add_transitions(std::vector<MDP::Transition>{});
+    REQUIRE(batch.num_states() == total_states);
+}
+
+TEST_CASE("HashedStateMap", "[graphmdp]") {
+    rl::mdp::HashedStateMap<int, size_t> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.find(3) == map.end());
+    REQUIRE_THROWS_AS(map.at(3), std::out_of_range);
+
+    // Sequential integer keys must not collide into long probe chains after rehashing
+    for (int key = 0; key != 1000; ++key) {
+        auto [iter, inserted] = map.try_emplace(key * 16, static_cast<size_t>(key));
+        REQUIRE(inserted);
+    }
+    REQUIRE(map.size() == 1000);
+
+    auto [iter, inserted] = map.try_emplace(32, 0);
+    REQUIRE_FALSE(inserted);
+    REQUIRE(iter->second == 2);
+
+    for (int key = 0; key != 1000; ++key) REQUIRE(map.at(key * 16) == static_cast<size_t>(key));
+    REQUIRE(map.find(1) == map.end());
+
+    // Iteration follows insertion order
+    size_t expected = 0;
+    for (const auto& [key, value]: map) REQUIRE(value == expected++);
+}
+
+TEST_CASE("GraphMDP w/ ordered state map", "[graphmdp]") {
+    using State = std::string;
+    using Action = rl::mdp::TwoWayAction;
+    GraphMDP<State, Action, double, double, std::map<State, size_t>> g;
+
+    g.add_transition("A", Action::RIGHT, "B", 1.0, 1.0);
+    g.add_transition("B", Action::RIGHT, "C", 2.0, 1.0);
+    g.set_terminal_state("C", 10.0);
+    g.set_initial_state("A");
+
+    REQUIRE(g.num_states() == 3);
+    REQUIRE(g.state_at(g.state_index("B")) == "B");
+    REQUIRE(g.is_terminal_state("C"));
+    REQUIRE(g.is_terminal(g.state_index("C")));
+    REQUIRE_FALSE(g.is_terminal_state("UNKNOWN"));
+    REQUIRE(g.is_initial(g.state_index("A")));
+    REQUIRE(g.get_initial_states() == std::vector<State>{"A"});
+    REQUIRE(std::get<1>(g.get_transitions("B", Action::RIGHT)[0]) == 10.0_a);
+    REQUIRE_THROWS_AS(g.get_actions("UNKNOWN"), std::out_of_range);
+}
+
 
 TEST_CASE("Graph w/ MDPEnvironment", "[graphmdp][mdp]"){
     using State = std::string;
@@ -236,6 +358,63 @@ TEST_CASE("Graph w/ MDPEnvironment", "[graphmdp][mdp]"){
         }
     }
 
+    SECTION("New initial states after alias sampling"){
+        Environment alias_environment(g, 42, rl::mdp::SamplingMode::ALIAS);
+        g->set_initial_state("B");
+        static_cast<void>(alias_environment.start());
+        static_cast<void>(alias_environment.step(Action::RIGHT));
+
+        // Adding a state as initial state grows the alias tables
+        size_t revision = g->revision();
+        g->set_initial_state("NEW");
+        REQUIRE(g->revision() != revision);
+        g->add_transition("NEW", Action::RIGHT, "A", 1.0, 1.0);
+        g->add_transition("NEW", Action::LEFT, "A", 1.0, 1.0);
+
+        for(size_t i = 0; i != 100; ++i){
+            State s = alias_environment.start();
+            auto [s_i, r, is_final] = alias_environment.step(Action::RIGHT);
+            REQUIRE_FALSE(is_final);
+            if(s == "NEW"){
+                REQUIRE(s_i == "A");
+                REQUIRE(r == 1.0_a);
+            }
+        }
+
+        // Existing states only change their flags
+        revision = g->revision();
+        g->set_initial_state("NEW");
+        REQUIRE(g->revision() == revision);
+    }
+
+    SECTION("Transitions without probability"){
+        // Zero weights cannot be normalised, both sampling modes reject the State-Action pair
+        g->add_transition("ZERO", Action::RIGHT, "A", 1.0, 0.0);
+        g->add_transition("ZERO", Action::RIGHT, "B", 1.0, 0.0);
+        g->add_transition("ZERO", Action::LEFT, "A", 1.0, 1.0);
+        g->set_initial_state("ZERO");
+        for(auto mode: {rl::mdp::SamplingMode::LINEAR, rl::mdp::SamplingMode::ALIAS}){
+            Environment environment(g, 42, mode);
+            REQUIRE(environment.start() == "ZERO");
+            REQUIRE_THROWS_AS(environment.step(Action::RIGHT), std::range_error);
+
+            REQUIRE(environment.start() == "ZERO");
+            auto [s_i, r, is_final] = environment.step(Action::LEFT);
+            REQUIRE(s_i == "A");
+            REQUIRE_FALSE(is_final);
+        }
+
+        // Compiled models leave the pair without transitions too, instead of storing NaN probabilities
+        auto compiled = std::make_shared<rl::mdp::CompiledMDP<State, Action>>(*g);
+        REQUIRE(compiled->get_actions("ZERO") == std::vector<Action>{Action::LEFT});
+        REQUIRE(compiled->get_transitions("ZERO", Action::RIGHT).empty());
+        REQUIRE(compiled->transitions(compiled->state_index("ZERO"), ActionTraits<Action>::id(Action::RIGHT)).empty());
+
+        rl::mdp::MDPEnvironment<rl::mdp::CompiledMDP<State, Action>> compiled_environment(compiled, 42);
+        REQUIRE(compiled_environment.start() == "ZERO");
+        REQUIRE_THROWS_AS(compiled_environment.step(Action::RIGHT), std::range_error);
+    }
+
     SECTION("End state"){
         State initial{"B"}, final{"A"};
         g->set_initial_state("B");
@@ -1,10 +1,14 @@
 #include "mdp/gridworld.h"
+#include "mdp/stencil.h"
 
 #include <catch2/catch_all.hpp>
 #include <array>
 #include <algorithm>
 #include <vector>
+#include <map>
 #include <iterator>
+#include <sstream>
+#include <random>
 
 using namespace Catch::literals;
 using Catch::Approx;
@@ -113,6 +117,102 @@ TEST_CASE("Gridworld", "[gridworld]") {
         REQUIRE_THAT(g.get_transitions(from, action), matcher);
     }
 
+    SECTION("Transition visitor") {
+        State from{2, 2};
+        g.add_transition(from, Action::UP, State{1, 2}, -1.0, 1.0);
+        g.add_transition(from, Action::UP, State{2, 1}, -2.0, 3.0);
+
+        for (const auto &s: g.get_states()) {
+            for (const auto &a: ActionTraits<Action>::available_actions()) {
+                std::vector<StateRewardProbability> visited;
+                g.for_each_transition(s, a, [&visited](const State &s_i, double r, double p) {
+                    visited.emplace_back(s_i, r, p);
+                });
+                REQUIRE(visited == g.get_transitions(s, a));
+            }
+        }
+
+        // Returning false stops the visit
+        size_t visits = 0;
+        g.for_each_transition(from, Action::UP, [&visits](const State &, double, double) {
+            ++visits;
+            return false;
+        });
+        REQUIRE(visits == 1);
+    }
+
+    SECTION("Dynamics table") {
+        // Single transitions are normalised when added
+        g.add_transition(State{1, 1}, Action::DOWN, State{3, 3}, 4.0, 0.25);
+        REQUIRE(g.get_transitions(State{1, 1}, Action::DOWN) ==
+                std::vector<StateRewardProbability>{{State{3, 3}, 4.0, 1.0}});
+
+        // Stochastic pairs grow in the overflow pool and keep insertion order
+        State from{2, 1};
+        double total_weight = 0.0;
+        for (size_t i = 0; i != 10; ++i) {
+            g.add_transition(from, Action::LEFT, State{i % rows, i % columns}, static_cast<double>(i), i + 1.0);
+            g.add_transition(from, Action::RIGHT, State{0, i % columns}, -1.0, 1.0);
+            total_weight += i + 1.0;
+        }
+
+        auto transitions = g.get_transitions(from, Action::LEFT);
+        REQUIRE(transitions.size() == 10);
+        double total_probability = 0.0;
+        for (size_t i = 0; i != transitions.size(); ++i) {
+            auto [s_i, r, p] = transitions[i];
+            REQUIRE(s_i == State{i % rows, i % columns});
+            REQUIRE(r == Approx(static_cast<double>(i)));
+            REQUIRE(p == Approx((i + 1.0) / total_weight));
+            total_probability += p;
+        }
+        REQUIRE(total_probability == 1.0_a);
+        REQUIRE(g.get_transitions(from, Action::RIGHT).size() == 10);
+
+        // Walls keep the probability of the transitions they redirect
+        g.set_wall_state(State{1, 1}, -3.0);
+        double wall_probability = 0.0;
+        for (const auto &[s_i, r, p]: g.get_transitions(from, Action::LEFT)) {
+            REQUIRE(s_i != State{1, 1});
+            if (s_i == from) {
+                REQUIRE(r == -3.0_a);
+                wall_probability += p;
+            }
+        }
+        REQUIRE(wall_probability == Approx(2.0 / total_weight));
+
+        // Out of grid transitions are rejected
+        REQUIRE_THROWS_AS(g.add_transition(from, Action::UP, State{rows, 0}, 0.0, 1.0), std::out_of_range);
+    }
+
+    SECTION("Dynamics table of a large map") {
+        // Custom pairs in distant blocks of the table, the rest keep the default dynamics
+        size_t size = 4096;
+        Gridworld large(size, size);
+        State first{0, 0}, middle{size / 2, 5}, last{size - 1, size - 1};
+        large.add_transition(first, Action::UP, last, 2.0, 1.0);
+        large.add_transition(middle, Action::LEFT, first, 3.0, 1.0);
+        large.add_transition(middle, Action::LEFT, last, 4.0, 3.0);
+        large.add_transition(last, Action::DOWN, middle, 5.0, 1.0);
+
+        REQUIRE(large.get_transitions(first, Action::UP) == std::vector<StateRewardProbability>{{last, 2.0, 1.0}});
+        REQUIRE(large.get_transitions(middle, Action::LEFT) ==
+                std::vector<StateRewardProbability>{{first, 3.0, 0.25}, {last, 4.0, 0.75}});
+        REQUIRE(large.get_transitions(last, Action::DOWN) == std::vector<StateRewardProbability>{{middle, 5.0, 1.0}});
+        REQUIRE(large.get_transitions(middle, Action::RIGHT) ==
+                std::vector<StateRewardProbability>{{State{size / 2, 6}, 0.0, 1.0}});
+        REQUIRE(large.get_transitions(State{size / 2 + 1, 5}, Action::LEFT) ==
+                std::vector<StateRewardProbability>{{State{size / 2 + 1, 4}, 0.0, 1.0}});
+
+        // Edits reach the cells of every block
+        large.set_terminal_state(last, 10.0);
+        REQUIRE(large.get_transitions(first, Action::UP) == std::vector<StateRewardProbability>{{last, 10.0, 1.0}});
+        for (const auto &[s_i, r, p]: large.get_transitions(last, Action::DOWN)) REQUIRE(s_i == last);
+        large.set_wall_state(first, -2.0);
+        REQUIRE(large.get_transitions(middle, Action::LEFT) ==
+                std::vector<StateRewardProbability>{{middle, -2.0, 0.25}, {last, 10.0, 0.75}});
+    }
+
     SECTION("Additional properties"){
         double cost_of_living = -5.0;
         g.cost_of_living(cost_of_living);
@@ -226,6 +326,42 @@ TEST_CASE("Gridworld", "[gridworld]") {
             }
         }
 
+        SECTION("Chained edits"){
+            // Custom transition from a distant cell into the future wall
+            State wall{1, 1}, terminal{1, 2}, far{4, 3};
+            g.add_transition(far, Action::UP, wall, 1.0, 1.0);
+            g.add_transition(far, Action::UP, State{0, 0}, 1.0, 1.0);
+            g.set_wall_state(wall, -2.0);
+
+            auto far_transitions = g.get_transitions(far, Action::UP);
+            REQUIRE(far_transitions == std::vector<StateRewardProbability>{{far, -2.0, 0.5}, {State{0, 0}, 1.0, 0.5}});
+
+            // Neighbours bounce back from the wall
+            REQUIRE(g.get_transitions(State{0, 1}, Action::DOWN) ==
+                    std::vector<StateRewardProbability>{{State{0, 1}, -2.0, 1.0}});
+            REQUIRE(g.get_transitions(State{1, 0}, Action::RIGHT) ==
+                    std::vector<StateRewardProbability>{{State{1, 0}, -2.0, 1.0}});
+
+            // Terminal next to the wall, reached from its neighbours and from a redirected transition
+            g.add_transition(State{3, 0}, Action::LEFT, terminal, 0.0, 1.0);
+            g.set_terminal_state(terminal, 5.0);
+            REQUIRE(g.get_transitions(State{0, 2}, Action::DOWN) ==
+                    std::vector<StateRewardProbability>{{terminal, 5.0, 1.0}});
+            REQUIRE(g.get_transitions(State{1, 1}, Action::RIGHT) ==
+                    std::vector<StateRewardProbability>{{terminal, 5.0, 1.0}});
+            REQUIRE(g.get_transitions(State{3, 0}, Action::LEFT) ==
+                    std::vector<StateRewardProbability>{{terminal, 5.0, 1.0}});
+            REQUIRE(g.get_transitions(State{1, 3}, Action::UP) ==
+                    std::vector<StateRewardProbability>{{State{0, 3}, 0.0, 1.0}});
+
+            // Walls next to the terminal do not change its self transitions
+            g.set_wall_state(State{2, 2}, -1.0);
+            REQUIRE(g.get_transitions(terminal, Action::DOWN) ==
+                    std::vector<StateRewardProbability>{{terminal, 5.0, 1.0}});
+            REQUIRE(g.get_transitions(State{3, 2}, Action::UP) ==
+                    std::vector<StateRewardProbability>{{State{3, 2}, -1.0, 1.0}});
+        }
+
         SECTION("Initial states"){
             State initial{0, 0};
             g.set_initial_state(initial);
@@ -579,6 +715,269 @@ TEST_CASE("Gridworld Policy", "[gridworld]"){
     }
 }
 
+TEST_CASE("Gridworld Policy parallel sweeps", "[gridworld][parallel]"){
+    using Action = Gridworld::Action;
+
+    // Large enough to be split in several blocks
+    size_t rows = 64, columns = 80;
+    auto g = std::make_shared<Gridworld>(rows, columns);
+    g->cost_of_living(-1.0);
+    for(size_t row = 4; row != rows - 4; ++row) g->set_wall_state({row, columns / 2}, -5.0);
+    g->add_transition({10, 10}, Action::RIGHT, {10, 11}, -1.0, 3.0);
+    g->add_transition({10, 10}, Action::RIGHT, {20, 30}, 2.0, 1.0);
+    g->set_terminal_state({0, 0}, std::nullopt);
+    g->set_terminal_state({rows - 1, columns - 1}, 10.0);
+
+    rl::mdp::GridworldGreedyPolicy sequential(g, 0.95);
+    rl::mdp::GridworldGreedyPolicy parallel(g, 0.95);
+    parallel.set_execution_mode(rl::mdp::ExecutionMode::PARALLEL, 4);
+    REQUIRE(parallel.get_execution_mode() == rl::mdp::ExecutionMode::PARALLEL);
+
+    auto require_same = [&](){
+        for(const auto& s: g->get_states()){
+            INFO("State: " << s);
+            REQUIRE(parallel.value_function(s) == sequential.value_function(s));
+            REQUIRE(parallel.get_action_probabilities(s) == sequential.get_action_probabilities(s));
+        }
+    };
+
+    SECTION("Same results"){
+        for(size_t iteration = 0; iteration != 5; ++iteration){
+            for(size_t sweep = 0; sweep != 20; ++sweep){
+                REQUIRE(parallel.policy_evaluation() == sequential.policy_evaluation());
+            }
+            REQUIRE(parallel.update_policy() == sequential.update_policy());
+        }
+        require_same();
+    }
+
+    SECTION("Compiled model"){
+        sequential.compile_model();
+        parallel.compile_model();
+        for(size_t sweep = 0; sweep != 20; ++sweep){
+            REQUIRE(parallel.policy_evaluation() == sequential.policy_evaluation());
+        }
+        REQUIRE(parallel.update_policy() == sequential.update_policy());
+        require_same();
+    }
+
+    SECTION("Back to sequential"){
+        parallel.set_execution_mode(rl::mdp::ExecutionMode::SEQUENTIAL);
+        REQUIRE(parallel.policy_evaluation() == sequential.policy_evaluation());
+        REQUIRE(parallel.update_policy() == sequential.update_policy());
+        REQUIRE_FALSE(parallel.update_policy());
+        REQUIRE_FALSE(sequential.update_policy());
+        require_same();
+    }
+}
+
+TEST_CASE("Gridworld Policy in-place evaluation", "[gridworld][gauss_seidel]"){
+    using rl::mdp::EvaluationMode;
+    using rl::mdp::SweepOrder;
+
+    // Corridor with the goal at the far end
+    size_t rows = 12, columns = 12;
+    auto g = std::make_shared<Gridworld>(rows, columns);
+    g->cost_of_living(-1.0);
+    for(size_t row = 0; row != rows - 2; ++row) g->set_wall_state({row, columns / 2}, -1.0);
+    g->set_terminal_state({0, columns - 1}, std::nullopt);
+
+    // Sweeps needed to converge the current policy, the value table is checked against reference
+    auto converge = [](rl::mdp::GridworldGreedyPolicy& policy){
+        size_t sweeps = 1;
+        while(policy.policy_evaluation() > 1e-10) ++sweeps;
+        return sweeps;
+    };
+
+    rl::mdp::GridworldGreedyPolicy reference(g, 0.9);
+    size_t jacobi_sweeps = converge(reference);
+
+    for(auto order: {SweepOrder::FORWARD, SweepOrder::REVERSE, SweepOrder::FROM_TERMINALS}){
+        DYNAMIC_SECTION("Order " << static_cast<int>(order)){
+            rl::mdp::GridworldGreedyPolicy policy(g, 0.9);
+            policy.set_evaluation_mode(EvaluationMode::GAUSS_SEIDEL, order);
+            size_t sweeps = converge(policy);
+            REQUIRE(sweeps < jacobi_sweeps);
+
+            for(const auto& s: g->get_states()){
+                INFO("State: " << s);
+                REQUIRE(policy.value_function(s) == Approx(reference.value_function(s)).margin(1e-8));
+            }
+
+            // Same greedy policy
+            reference.update_policy();
+            policy.update_policy();
+            for(const auto& s: g->get_states()){
+                REQUIRE(policy.get_action_probabilities(s) == reference.get_action_probabilities(s));
+            }
+        }
+    }
+
+    SECTION("Backward order needs fewer sweeps"){
+        rl::mdp::GridworldGreedyPolicy forward(g, 0.9), backward(g, 0.9);
+        forward.set_evaluation_mode(EvaluationMode::GAUSS_SEIDEL, SweepOrder::FORWARD);
+        backward.set_evaluation_mode(EvaluationMode::GAUSS_SEIDEL, SweepOrder::FROM_TERMINALS);
+        size_t forward_sweeps = converge(forward), backward_sweeps = converge(backward);
+        INFO("Jacobi: " << jacobi_sweeps << " forward: " << forward_sweeps << " backward: " << backward_sweeps);
+        REQUIRE(backward_sweeps < forward_sweeps);
+    }
+
+    SECTION("Order follows the edits"){
+        rl::mdp::GridworldGreedyPolicy policy(g, 0.9);
+        policy.set_evaluation_mode(EvaluationMode::GAUSS_SEIDEL, SweepOrder::FROM_TERMINALS);
+        policy.compile_model();
+        converge(policy);
+        policy.set_compiled_model(nullptr);
+
+        g->set_wall_state({rows - 2, columns / 2}, -1.0);
+        converge(policy);
+        rl::mdp::GridworldGreedyPolicy edited(g, 0.9);
+        converge(edited);
+        for(const auto& s: g->get_states()){
+            REQUIRE(policy.value_function(s) == Approx(edited.value_function(s)).margin(1e-8));
+        }
+    }
+}
+
+TEMPLATE_TEST_CASE("Gridworld Policy stencil backups", "[gridworld][stencil]",
+                   rl::mdp::GridworldGreedyPolicy, rl::mdp::FloatGridworldGreedyPolicy){
+    using Grid = typename TestType::Gridworld;
+    using Reward = typename Grid::Reward;
+    using Action = typename Grid::Action;
+
+    // Open map with every kind of cell the stencil cannot back up
+    size_t rows = 40, columns = 37;
+    auto g = std::make_shared<Grid>(rows, columns);
+    g->cost_of_living(Reward(-0.5));
+    g->bounds_penalty(Reward(-2));
+    for(size_t row = 5; row != 30; ++row) g->set_wall_state({row, 12}, Reward(-3));
+    g->cost_of_living({20, 20}, Reward(-4));
+    g->add_transition({8, 25}, Action::LEFT, {8, 24}, Reward(-1), Reward(3));
+    g->add_transition({8, 25}, Action::LEFT, {30, 30}, Reward(1), Reward(1));
+    g->set_terminal_state({0, 0}, std::nullopt);
+    g->set_terminal_state({rows - 2, columns - 2}, Reward(10));
+
+    SECTION("Mask"){
+        auto mask = g->default_dynamics_mask();
+        REQUIRE(mask.size() == rows * columns);
+        auto masked = [&](size_t row, size_t column){ return mask[row * columns + column] != 0; };
+        REQUIRE(masked(2, 2));
+        REQUIRE_FALSE(masked(0, 5));                // Border
+        REQUIRE_FALSE(masked(10, 11));              // Next to a wall
+        REQUIRE_FALSE(masked(20, 19));              // Next to a cell with its own cost of living
+        REQUIRE_FALSE(masked(8, 25));               // Custom transitions
+        REQUIRE_FALSE(masked(rows - 2, columns - 2)); // Terminal
+        REQUIRE_FALSE(masked(rows - 3, columns - 2)); // Next to a terminal with in-reward
+    }
+
+    SECTION("Same values as the compiled model"){
+        TestType stencil(g, 0.9), compiled(g, 0.9);
+        compiled.compile_model();
+
+        auto require_same = [&](){
+            for(const auto& s: g->get_states()){
+                INFO("State: " << s);
+                REQUIRE(stencil.value_function(s) == Approx(compiled.value_function(s)).epsilon(1e-5));
+                REQUIRE(stencil.get_action_probabilities(s) == compiled.get_action_probabilities(s));
+            }
+        };
+
+        for(size_t iteration = 0; iteration != 5; ++iteration){
+            for(size_t sweep = 0; sweep != 10; ++sweep){
+                REQUIRE(stencil.policy_evaluation() == Approx(compiled.policy_evaluation()).epsilon(1e-5));
+            }
+            stencil.update_policy();
+            compiled.update_policy();
+        }
+        require_same();
+
+        // The mask follows the edits
+        g->set_wall_state({2, 2}, Reward(-3));
+        compiled.compile_model();
+        for(size_t sweep = 0; sweep != 10; ++sweep){
+            REQUIRE(stencil.policy_evaluation() == Approx(compiled.policy_evaluation()).epsilon(1e-5));
+        }
+        require_same();
+    }
+
+    SECTION("Vector and scalar kernels"){
+        // Random values and probabilities, runs of every length up to two vectors plus a remainder
+        std::vector<Reward> values(3 * columns), probabilities(4 * values.size());
+        std::minstd_rand engine(7);
+        std::uniform_real_distribution<Reward> distribution(-1, 1);
+        for(auto& v: values) v = distribution(engine);
+        for(auto& p: probabilities) p = distribution(engine);
+
+        for(size_t count = 1; count != 12; ++count){
+            std::vector<Reward> vector_values(values.size()), scalar_values(values.size());
+            Reward vector_delta = rl::mdp::detail::stencil_backup(values.data(), columns, probabilities.data(),
+                    Reward(-0.5), Reward(0.9), columns + 1, count, vector_values.data());
+            Reward scalar_delta = rl::mdp::detail::stencil_backup_scalar(values.data(), columns, probabilities.data(),
+                    Reward(-0.5), Reward(0.9), columns + 1, count, scalar_values.data());
+
+            REQUIRE(vector_delta == Approx(scalar_delta));
+            for(size_t i = 0; i != values.size(); ++i) REQUIRE(vector_values[i] == Approx(scalar_values[i]));
+        }
+    }
+}
+
+TEST_CASE("FloatGridworld Policy", "[gridworld][float]"){
+    auto build = [](auto& grid){
+        grid.cost_of_living(-1.0f);
+        grid.set_wall_state({1, 1}, -2.0f);
+        grid.add_transition({2, 0}, Gridworld::Action::UP, {0, 0}, 0.5f, 1.0f);
+        grid.add_transition({2, 0}, Gridworld::Action::UP, {3, 3}, 1.0f, 3.0f);
+        grid.set_terminal_state({0, 0}, std::nullopt);
+        grid.set_terminal_state({3, 3}, 5.0f);
+    };
+
+    auto g = std::make_shared<Gridworld>(4, 4);
+    auto g_float = std::make_shared<rl::mdp::FloatGridworld>(4, 4);
+    build(*g);
+    build(*g_float);
+    static_assert(std::is_same_v<rl::mdp::FloatGridworld::Reward, float>);
+
+    rl::mdp::GridworldGreedyPolicy policy(g, 0.9);
+    rl::mdp::FloatGridworldGreedyPolicy policy_float(g_float, 0.9);
+
+    SECTION("Same dynamics"){
+        for(const auto& s: g->get_states()){
+            for(const auto& a: ActionTraits<Gridworld::Action>::available_actions()){
+                auto expected = g->get_transitions(s, a);
+                auto result = g_float->get_transitions(s, a);
+                REQUIRE(result.size() == expected.size());
+                for(size_t i = 0; i != expected.size(); ++i){
+                    REQUIRE(std::get<0>(result[i]) == std::get<0>(expected[i]));
+                    REQUIRE(std::get<1>(result[i]) == Approx(std::get<1>(expected[i])));
+                    REQUIRE(std::get<2>(result[i]) == Approx(std::get<2>(expected[i])));
+                }
+            }
+        }
+    }
+
+    SECTION("Generalized policy iteration"){
+        for(size_t iteration = 0; iteration != 10; ++iteration){
+            for(size_t sweep = 0; sweep != 10; ++sweep){
+                policy.policy_evaluation();
+                policy_float.policy_evaluation();
+            }
+            policy.update_policy();
+            policy_float.update_policy();
+        }
+
+        for(const auto& s: g->get_states()){
+            REQUIRE(policy_float.value_function(s) == Approx(policy.value_function(s)).epsilon(1e-4));
+        }
+    }
+
+    SECTION("Compiled model"){
+        policy_float.compile_model();
+        for(size_t sweep = 0; sweep != 10; ++sweep){
+            REQUIRE(policy_float.policy_evaluation() == Approx(policy.policy_evaluation()).epsilon(1e-4));
+        }
+    }
+}
+
 TEST_CASE("Gridworld w/ MDPEnvironment", "[gridworld][mdp_environment]"){
     using Action = Gridworld::Action;
     using State = Gridworld::State;
@@ -623,4 +1022,251 @@ TEST_CASE("Gridworld w/ MDPEnvironment", "[gridworld][mdp_environment]"){
             current_state = s_i;
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Gridworld w/ MDPEnvironment alias sampling", "[gridworld][mdp_environment]"){
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+    using Environment = rl::mdp::MDPEnvironment<Gridworld>;
+
+    auto grid = std::make_shared<Gridworld>(3, 3);
+    grid->cost_of_living(-1.0);
+    grid->set_initial_state(State{1, 1});
+    grid->add_transition(State{1, 1}, Action::LEFT, State{0, 0}, 5.0, 1.0);
+    grid->add_transition(State{1, 1}, Action::LEFT, State{2, 2}, 10.0, 3.0);
+    Environment env(grid, 42, rl::mdp::SamplingMode::ALIAS);
+
+    SECTION("Distribution"){
+        size_t total = 10000, first = 0;
+        for(size_t i = 0; i < total; ++i){
+            REQUIRE(env.start() == State{1, 1});
+            auto [s_i, reward, is_final] = env.step(Action::LEFT);
+            REQUIRE_FALSE(is_final);
+            if(s_i == State{0, 0}){
+                REQUIRE(reward == 5.0_a);
+                ++first;
+            } else {
+                REQUIRE(s_i == State{2, 2});
+                REQUIRE(reward == 10.0_a);
+            }
+        }
+
+        REQUIRE(static_cast<double>(first) / static_cast<double>(total) == Approx(0.25).margin(0.02));
+    }
+
+    SECTION("Tables are rebuilt after edits"){
+        REQUIRE(env.start() == State{1, 1});
+        auto [s_i, reward, is_final] = env.step(Action::UP);
+        REQUIRE(s_i == State{0, 1});
+        REQUIRE(reward == -1.0_a);
+        REQUIRE_FALSE(is_final);
+
+        // Walls bounce back to the current state and terminal states end the episode
+        grid->set_wall_state(State{1, 2}, -2.0);
+        grid->set_terminal_state(State{1, 0}, 1.0);
+        REQUIRE(env.start() == State{1, 1});
+        std::tie(s_i, reward, is_final) = env.step(Action::RIGHT);
+        REQUIRE(s_i == State{1, 1});
+        REQUIRE(reward == -2.0_a);
+        REQUIRE_FALSE(is_final);
+
+        grid->add_transition(State{1, 1}, Action::DOWN, State{1, 0}, 1.0, 1.0);
+        std::tie(s_i, reward, is_final) = env.step(Action::DOWN);
+        REQUIRE(s_i == State{1, 0});
+        REQUIRE(reward == 1.0_a);
+        REQUIRE(is_final);
+    }
+}
+
+TEST_CASE("Gridworld w/ VectorMDPEnvironment", "[gridworld][mdp_environment]"){
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+    using Environment = rl::mdp::VectorMDPEnvironment<Gridworld>;
+
+    auto grid = std::make_shared<Gridworld>(3, 3);
+    grid->cost_of_living(-1.0);
+    grid->add_transition(State{1, 1}, Action::LEFT, State{0, 0}, 5.0, 1.0);
+    grid->add_transition(State{1, 1}, Action::LEFT, State{2, 2}, 10.0, 3.0);
+    size_t total = 4096;
+    Environment env(grid, total, 42);
+
+    SECTION("Start"){
+        REQUIRE(env.size() == total);
+        REQUIRE_THROWS(env.start());
+
+        grid->set_initial_state(State{1, 1});
+        env.start();
+        for(size_t i = 0; i < total; ++i) REQUIRE(env.state(i) == State{1, 1});
+
+        std::vector<Action> actions(total - 1, Action::LEFT);
+        REQUIRE_THROWS_AS(env.step(actions), std::invalid_argument);
+    }
+
+    SECTION("Distribution"){
+        grid->set_initial_state(State{1, 1});
+        env.start();
+
+        std::vector<Action> actions(total, Action::LEFT);
+        env.step(actions);
+
+        size_t first = 0;
+        for(size_t i = 0; i < total; ++i){
+            REQUIRE_FALSE(env.dones()[i]);
+            REQUIRE(env.episode_steps()[i] == 1);
+            REQUIRE(env.episode_returns()[i] == env.rewards()[i]);
+            if(env.state(i) == State{0, 0}){
+                REQUIRE(env.rewards()[i] == 5.0_a);
+                ++first;
+            } else {
+                REQUIRE(env.state(i) == State{2, 2});
+                REQUIRE(env.rewards()[i] == 10.0_a);
+            }
+        }
+
+        REQUIRE(static_cast<double>(first) / static_cast<double>(total) == Approx(0.25).margin(0.03));
+    }
+
+    SECTION("Auto-reset"){
+        grid->set_initial_state(State{1, 1});
+        grid->set_terminal_state(State{1, 2}, 3.0);
+        env.start();
+
+        std::vector<Action> actions(total, Action::UP);
+        env.step(actions);
+        std::fill(actions.begin(), actions.end(), Action::DOWN);
+        env.step(actions);
+        std::fill(actions.begin(), actions.end(), Action::RIGHT);
+        env.step(actions);
+
+        for(size_t i = 0; i < total; ++i){
+            REQUIRE(env.dones()[i]);
+            REQUIRE(env.final_state(i) == State{1, 2});
+            REQUIRE(env.completed_returns()[i] == 1.0_a);
+            REQUIRE(env.completed_steps()[i] == 3);
+
+            // A new episode has started
+            REQUIRE(env.state(i) == State{1, 1});
+            REQUIRE(env.episode_steps()[i] == 0);
+            REQUIRE(env.episode_returns()[i] == 0.0_a);
+        }
+    }
+
+    SECTION("Restart"){
+        REQUIRE_THROWS_AS(env.restart(0), std::logic_error);
+
+        grid->set_initial_state(State{1, 1});
+        env.start();
+        std::vector<Action> actions(total, Action::UP);
+        env.step(actions);
+
+        // Only the restarted environment goes back, from the initial states of the last start
+        grid->set_initial_state(State{2, 2});
+        env.restart(0);
+        REQUIRE(env.state(0) == State{1, 1});
+        REQUIRE(env.episode_steps()[0] == 0);
+        REQUIRE(env.episode_returns()[0] == 0.0_a);
+        REQUIRE(env.state(1) == State{0, 1});
+        REQUIRE(env.episode_steps()[1] == 1);
+    }
+}
+
+TEST_CASE("Gridworld map loader", "[gridworld][loader]"){
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+
+    rl::mdp::GridworldMapSettings settings;
+    settings.wall_penalty = -5.0;
+    settings.goal_reward = 10.0;
+
+    SECTION("ASCII map"){
+        std::istringstream map("S..#\r\n.3.#\n..#G\n");
+        auto g = Gridworld::load(map, settings);
+        g.cost_of_living(-1.0);
+
+        REQUIRE(g.get_rows() == 3);
+        REQUIRE(g.get_columns() == 4);
+        REQUIRE(g.get_initial_states() == std::vector<State>{State{0, 0}});
+        REQUIRE(g.get_terminal_states() == std::vector<State>{State{2, 3}});
+        REQUIRE(g.get_wall_states() == std::vector<State>{State{0, 3}, State{1, 3}, State{2, 2}});
+
+        // Same dynamics as building the map with the mutators
+        Gridworld expected(3, 4);
+        expected.cost_of_living(-1.0);
+        expected.set_initial_state(State{0, 0});
+        expected.set_wall_state(State{0, 3}, -5.0);
+        expected.set_wall_state(State{1, 3}, -5.0);
+        expected.set_wall_state(State{2, 2}, -5.0);
+        expected.set_terminal_state(State{2, 3}, 10.0);
+        expected.cost_of_living(State{1, 1}, -3.0);
+
+        for(const auto& s: g.get_states()){
+            INFO("State: " << s);
+            REQUIRE(g.is_wall_state(s) == expected.is_wall_state(s));
+            REQUIRE(g.is_terminal_state(s) == expected.is_terminal_state(s));
+            for(const auto& a: ActionTraits<Action>::available_actions()){
+                INFO("Action: " << a);
+                REQUIRE(g.get_transitions(s, a) == expected.get_transitions(s, a));
+            }
+        }
+
+        // Per-cell cost of living
+        REQUIRE(g.get_transitions(State{0, 1}, Action::DOWN) ==
+                std::vector<StateRewardProbability>{{State{1, 1}, -3.0, 1.0}});
+        REQUIRE(g.get_transitions(State{1, 2}, Action::RIGHT) ==
+                std::vector<StateRewardProbability>{{State{1, 2}, -5.0, 1.0}});
+    }
+
+    SECTION("Invalid ASCII maps"){
+        std::istringstream uneven("S..\n..\n");
+        REQUIRE_THROWS_AS(Gridworld::load(uneven), std::invalid_argument);
+
+        std::istringstream unknown("S.x\n...\n");
+        REQUIRE_THROWS_AS(Gridworld::load(unknown), std::invalid_argument);
+
+        std::istringstream empty("");
+        REQUIRE_THROWS_AS(Gridworld::load(empty), std::invalid_argument);
+
+        REQUIRE_THROWS_AS(Gridworld::load("missing-map-file.txt"), std::runtime_error);
+    }
+
+    SECTION("PGM map"){
+        std::string pixels{'\xff', '\x00', '\x80', '\x00', '\xff', '\xff'};
+        std::istringstream map("P5\n# Comment\n3 2\n255\n" + pixels);
+        auto g = Gridworld::load(map, settings);
+
+        REQUIRE(g.get_rows() == 2);
+        REQUIRE(g.get_columns() == 3);
+        REQUIRE(g.get_wall_states() == std::vector<State>{State{0, 1}, State{1, 0}});
+
+        REQUIRE(g.get_transitions(State{0, 0}, Action::RIGHT) ==
+                std::vector<StateRewardProbability>{{State{0, 0}, -5.0, 1.0}});
+        REQUIRE(g.get_transitions(State{1, 1}, Action::UP) ==
+                std::vector<StateRewardProbability>{{State{1, 1}, -5.0, 1.0}});
+
+        // Gray pixels set the cost of living
+        auto [s_i, r, p] = g.get_transitions(State{1, 2}, Action::UP)[0];
+        REQUIRE(s_i == State{0, 2});
+        REQUIRE(r == Approx(-127.0 / 255.0));
+
+        // Without gray levels for them there are no initial states nor goals
+        REQUIRE(g.get_initial_states().empty());
+        REQUIRE(g.get_terminal_states().empty());
+
+        std::istringstream truncated("P5 3 2 255\n" + pixels.substr(0, 4));
+        REQUIRE_THROWS_AS(Gridworld::load(truncated), std::invalid_argument);
+    }
+
+    SECTION("PGM start and goal levels"){
+        std::string pixels{'\x10', '\x00', '\x80', '\x20', '\xff', '\x20'};
+        std::istringstream map("P5 3 2 255\n" + pixels);
+        settings.start_level = 0x10;
+        settings.goal_level = 0x20;
+        auto g = Gridworld::load(map, settings);
+
+        REQUIRE(g.get_initial_states() == std::vector<State>{State{0, 0}});
+        REQUIRE(g.get_terminal_states() == std::vector<State>{State{1, 0}, State{1, 2}});
+        REQUIRE(g.get_wall_states() == std::vector<State>{State{0, 1}});
+        REQUIRE(g.get_transitions(State{0, 0}, Action::DOWN) ==
+                std::vector<StateRewardProbability>{{State{1, 0}, settings.goal_reward.value(), 1.0}});
+    }
+}
@@ -0,0 +1,127 @@
+#include "mdp/static_gridworld.h"
+#include "mdp/compiled_mdp.h"
+
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace Catch::literals;
+using Catch::Approx;
+using rl::mdp::Gridworld;
+using rl::mdp::StaticGridworld;
+using rl::mdp::ActionTraits;
+
+namespace {
+    /// Applies the same map to a Gridworld and a StaticGridworld
+    template<class Grid>
+    void build_map(Grid& grid) {
+        grid.cost_of_living(-1.0);
+        grid.bounds_penalty(-2.0);
+        grid.set_wall_state({1, 1}, -5.0);
+        grid.set_wall_state({2, 3}, -3.0);
+        grid.cost_of_living({0, 3}, -4.0);
+        grid.add_transition({2, 0}, rl::mdp::GridworldAction::UP, {0, 0}, 1.0, 1.0);
+        grid.add_transition({2, 0}, rl::mdp::GridworldAction::UP, {3, 4}, 2.0, 3.0);
+        grid.add_transition({1, 2}, rl::mdp::GridworldAction::DOWN, {3, 4}, 0.5, 1.0);
+        grid.set_terminal_state({3, 4}, 10.0);
+        grid.set_terminal_state({0, 0}, std::nullopt);
+        grid.set_initial_state({3, 0});
+    }
+}
+
+TEST_CASE("StaticGridworld", "[gridworld][static]") {
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+
+    Gridworld dynamic(4, 5);
+    auto grid = std::make_shared<StaticGridworld<4, 5>>();
+    build_map(dynamic);
+    build_map(*grid);
+
+    SECTION("Constexpr neighbours") {
+        using Grid = StaticGridworld<4, 5>;
+        static_assert(Grid::neighbour(0, ActionTraits<Action>::id(Action::LEFT)) == 0);
+        static_assert(Grid::neighbour(0, ActionTraits<Action>::id(Action::DOWN)) == 5);
+        static_assert(Grid::neighbour(19, ActionTraits<Action>::id(Action::RIGHT)) == 19);
+        static_assert(Grid::num_states() == 20);
+        REQUIRE(Grid::state_at(Grid::state_index(State{2, 3})) == State{2, 3});
+    }
+
+    SECTION("Same dynamics as Gridworld") {
+        for (const auto& state: dynamic.get_states()) {
+            REQUIRE(grid->is_terminal_state(state) == dynamic.is_terminal_state(state));
+            REQUIRE(grid->is_wall_state(state) == dynamic.is_wall_state(state));
+            REQUIRE(grid->is_initial_state(state) == dynamic.is_initial_state(state));
+
+            for (const auto& action: ActionTraits<Action>::available_actions()) {
+                auto expected = dynamic.get_transitions(state, action);
+                auto result = grid->get_transitions(state, action);
+                INFO("From " << state << " with " << action);
+                REQUIRE(result.size() == expected.size());
+                for (size_t i = 0; i != expected.size(); ++i) {
+                    REQUIRE(std::get<0>(result[i]) == std::get<0>(expected[i]));
+                    REQUIRE(std::get<1>(result[i]) == Approx(std::get<1>(expected[i])));
+                    REQUIRE(std::get<2>(result[i]) == Approx(std::get<2>(expected[i])));
+                }
+                REQUIRE(grid->expected_reward(state, action) == Approx(dynamic.expected_reward(state, action)));
+            }
+        }
+
+        REQUIRE(grid->get_wall_states() == dynamic.get_wall_states());
+        REQUIRE(grid->get_terminal_states() == std::vector<State>{{0, 0}, {3, 4}});
+        REQUIRE_THROWS_AS(grid->add_transition({0, 0}, Action::UP, {1, 0}, 0.0, 1.0), std::invalid_argument);
+        REQUIRE_THROWS_AS(grid->set_wall_state({4, 0}, -1.0), std::out_of_range);
+    }
+
+    SECTION("Compiled model") {
+        rl::mdp::CompiledMDP<State, Action> compiled(*grid);
+        REQUIRE(compiled.num_states() == 20);
+        REQUIRE(compiled.is_wall(compiled.state_index({1, 1})));
+        REQUIRE(compiled.get_transitions({2, 0}, Action::UP).size() == 2);
+    }
+
+    SECTION("MDPEnvironment") {
+        rl::mdp::MDPEnvironment<StaticGridworld<4, 5>> env(grid, 42, rl::mdp::SamplingMode::ALIAS);
+        std::default_random_engine random_engine(42); // NOLINT(cert-msc51-cpp)
+        std::uniform_int_distribution<size_t> action_dist(0, 3);
+
+        REQUIRE(env.start() == State{3, 0});
+        bool is_final = false;
+        for (size_t step = 0; step != 10000 && !is_final; ++step) {
+            auto [s_i, reward, done] = env.step(ActionTraits<Action>::from_id(action_dist(random_engine)));
+            REQUIRE_FALSE(grid->is_wall_state(s_i));
+            is_final = done;
+        }
+        REQUIRE(is_final);
+    }
+}
+
+TEST_CASE("StaticGridworld Policy", "[gridworld][static]") {
+    auto dynamic = std::make_shared<Gridworld>(4, 5);
+    auto grid = std::make_shared<StaticGridworld<4, 5>>();
+    build_map(*dynamic);
+    build_map(*grid);
+
+    rl::mdp::GridworldGreedyPolicy expected(dynamic, 0.9);
+    rl::mdp::StaticGridworldGreedyPolicy<4, 5> policy(grid, 0.9);
+
+    // Generalized policy iteration gives the same values and policies
+    for (size_t iteration = 0; iteration != 20; ++iteration) {
+        for (size_t sweep = 0; sweep != 5; ++sweep) {
+            REQUIRE(policy.policy_evaluation() == Approx(expected.policy_evaluation()));
+        }
+        REQUIRE(policy.update_policy() == expected.update_policy());
+
+        for (const auto& state: dynamic->get_states()) {
+            REQUIRE(policy.value_function(state) == Approx(expected.value_function(state)));
+            REQUIRE(policy.get_action_probabilities(state) == expected.get_action_probabilities(state));
+        }
+    }
+
+    // The stencil follows edits of the gridworld
+    dynamic->set_wall_state({0, 4}, -20.0);
+    grid->set_wall_state({0, 4}, -20.0);
+    REQUIRE(policy.policy_evaluation() == Approx(expected.policy_evaluation()));
+    REQUIRE(policy.value_function({0, 3}) == Approx(expected.value_function({0, 3})));
+}
@@ -0,0 +1,119 @@
+#include <mdp/tensor_mdp.h>
+#include <mdp/gridworld.h>
+#include <mdp/graph.h>
+#include <mdp/graph_policy.h>
+
+#include <catch2/catch_all.hpp>
+#include <array>
+#include <memory>
+#include <string>
+
+using namespace Catch::literals;
+using Catch::Approx;
+using rl::mdp::Gridworld;
+using rl::mdp::ActionTraits;
+
+TEST_CASE("TensorMDP from Gridworld", "[tensor][gridworld]") {
+    using Action = Gridworld::Action;
+    using State = Gridworld::State;
+    using TensorGridworld = rl::mdp::TensorMDP<State, Action>;
+
+    auto g = std::make_shared<Gridworld>(4, 3);
+    g->cost_of_living(-1.0);
+    g->add_transition(State{1, 1}, Action::LEFT, State{0, 0}, 5.0, 1.0);
+    g->add_transition(State{1, 1}, Action::LEFT, State{2, 2}, 10.0, 3.0);
+    g->set_terminal_state(State{3, 2}, 1.0);
+    g->set_wall_state(State{2, 1}, -2.0);
+
+    auto tensors = std::make_shared<const TensorGridworld>(*g);
+
+    SECTION("Shapes") {
+        REQUIRE(tensors->num_states() == 12);
+        REQUIRE(tensors->transitions().shape()[0] == 12);
+        REQUIRE(tensors->transitions().shape()[1] == ActionTraits<Action>::total_actions());
+        REQUIRE(tensors->transitions().shape()[2] == 12);
+        REQUIRE(tensors->rewards().shape()[1] == ActionTraits<Action>::total_actions());
+        REQUIRE_THROWS_AS(tensors->state_index(State{4, 0}), std::out_of_range);
+    }
+
+    SECTION("Same dynamics") {
+        for (const auto& s: g->get_states()) {
+            size_t idx = tensors->state_index(s);
+            REQUIRE(tensors->state_at(idx) == s);
+            REQUIRE(tensors->is_terminal(idx) == g->is_terminal_state(s));
+            if (g->is_terminal_state(s)) continue;
+
+            for (const auto& a: g->get_actions(s)) {
+                size_t action_id = ActionTraits<Action>::id(a);
+                INFO("State: " << s << " Action: " << a);
+                REQUIRE(tensors->is_available(idx, action_id));
+
+                double expected_reward = 0.0;
+                for (const auto& [s_i, r, p]: g->get_transitions(s, a)) expected_reward += r * p;
+                REQUIRE(tensors->rewards()(idx, action_id) == Approx(expected_reward));
+
+                double total = 0.0;
+                for (const auto& s_i: g->get_states()) {
+                    double p = tensors->transitions()(idx, action_id, tensors->state_index(s_i));
+                    REQUIRE(p == Approx(g->state_transition_probability(s, a, s_i)));
+                    total += p;
+                }
+                REQUIRE(total == Approx(1.0));
+            }
+        }
+
+        // Terminal rows are empty
+        size_t terminal = tensors->state_index(State{3, 2});
+        REQUIRE(tensors->rewards()(terminal, 0) == 0.0);
+        REQUIRE_FALSE(tensors->is_available(terminal, 0));
+    }
+
+    SECTION("Same policy as GridworldGreedyPolicy") {
+        rl::mdp::GridworldGreedyPolicy expected(g, 0.9);
+        rl::mdp::TensorGreedyPolicy<State, Action> policy(tensors, 0.9);
+
+        for (size_t iteration = 0; iteration != 10; ++iteration) {
+            for (size_t sweep = 0; sweep != 5; ++sweep) {
+                REQUIRE(policy.policy_evaluation() == Approx(expected.policy_evaluation()));
+            }
+            REQUIRE(policy.update_policy() == expected.update_policy());
+        }
+
+        for (const auto& s: g->get_states()) {
+            INFO("State: " << s);
+            REQUIRE(policy.value_function(s) == Approx(expected.value_function(s)));
+            if (!g->is_terminal_state(s)) {
+                REQUIRE(policy.get_action_probabilities(s) == expected.get_action_probabilities(s));
+            }
+        }
+    }
+}
+
+TEST_CASE("TensorGreedyPolicy on GraphMDP", "[tensor][graph]") {
+    using State = std::string;
+    using Action = rl::mdp::TwoWayAction;
+    auto g = std::make_shared<rl::mdp::GraphMDP<State, Action>>();
+
+    std::array<State, 6> states{"A", "B", "C", "D", "E", "GOOD"};
+    for (size_t i = 0; i + 1 < states.size(); ++i) {
+        g->add_transition(states[i], Action::RIGHT, states[i + 1], -1.0, 1.0);
+        g->add_transition(states[i + 1], Action::LEFT, states[i], -1.0, 1.0);
+    }
+    g->set_terminal_state("GOOD", 1.0);
+
+    auto tensors = std::make_shared<const rl::mdp::TensorMDP<State, Action>>(*g);
+    REQUIRE_FALSE(tensors->is_available(tensors->state_index("A"), ActionTraits<Action>::id(Action::LEFT)));
+
+    rl::mdp::GraphMDP_Greedy<State, Action> expected(g, 1.0);
+    rl::mdp::TensorGreedyPolicy<State, Action> policy(tensors, 1.0);
+
+    for (size_t iteration = 0; iteration != 10; ++iteration) {
+        REQUIRE(policy.policy_evaluation() == Approx(expected.policy_evaluation()));
+        REQUIRE(policy.update_policy() == expected.update_policy());
+    }
+
+    for (const auto& s: states) {
+        INFO("State: " << s);
+        REQUIRE(policy.value_function(s) == Approx(expected.value_function(s)));
+    }
+}
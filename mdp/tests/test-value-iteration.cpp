@@ -0,0 +1,589 @@
+#include <mdp/value_iteration.h>
+#include <mdp/prioritized_sweeping.h>
+#include <mdp/linear_solver.h>
+#include <mdp/multigrid.h>
+#include <mdp/policy_iteration.h>
+#include <mdp/graph_policy.h>
+#include <mdp/gridworld.h>
+#include <mdp/graph.h>
+
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Catch::literals;
+using Catch::Approx;
+using rl::mdp::Gridworld;
+using rl::mdp::StopReason;
+using rl::mdp::StoppingCriteria;
+using rl::mdp::ValueIterationSolver;
+using rl::mdp::PrioritizedSweepingSolver;
+
+namespace {
+    using Chain = rl::mdp::GraphMDP<std::string, rl::mdp::TwoWayAction>;
+
+    /// Chain of states where moving costs 1, the first state bounces back to itself to the left and entering the
+    /// last one, which is terminal, gives 10
+    /// \param states
+    /// \return
+    std::shared_ptr<Chain> make_chain(const std::vector<std::string>& states) {
+        using Action = rl::mdp::TwoWayAction;
+        auto chain = std::make_shared<Chain>();
+        for (size_t i = 0; i + 1 != states.size(); ++i) {
+            chain->add_transition(states[i], Action::RIGHT, states[i + 1], -1.0, 1.0);
+            chain->add_transition(states[i + 1], Action::LEFT, states[i], -1.0, 1.0);
+        }
+        chain->add_transition(states.front(), Action::LEFT, states.front(), -1.0, 1.0);
+        chain->set_terminal_state(states.back(), 10.0);
+        return chain;
+    }
+
+    /// Gridworld with a wall down the middle column that leaves a gap at the bottom, a stochastic cell that may
+    /// jump back to the origin and the goal in the top right corner
+    /// \param rows
+    /// \param columns
+    /// \return
+    std::shared_ptr<Gridworld> make_walled_gridworld(size_t rows, size_t columns) {
+        auto g = std::make_shared<Gridworld>(rows, columns);
+        g->cost_of_living(-1.0);
+        for (size_t row = 0; row + 4 < rows; ++row) g->set_wall_state({row, columns / 2}, -5.0);
+        g->add_transition({15, 5}, Gridworld::Action::RIGHT, {15, 6}, -1.0, 3.0);
+        g->add_transition({15, 5}, Gridworld::Action::RIGHT, {0, 0}, 0.0, 1.0);
+        g->set_terminal_state({0, columns - 1}, 20.0);
+        return g;
+    }
+} // namespace
+
+TEST_CASE("Value iteration on a Gridworld", "[value_iteration][gridworld]") {
+    using State = Gridworld::State;
+    using Action = Gridworld::Action;
+
+    // Sutton & Barto [example 4.1], optimal values are minus the distance to the closest terminal state
+    Gridworld g(4, 4);
+    g.cost_of_living(-1.0);
+    g.set_terminal_state(State{0, 0}, std::nullopt);
+    g.set_terminal_state(State{3, 3}, std::nullopt);
+
+    ValueIterationSolver<Gridworld> solver(g, 1.0);
+
+    SECTION("Optimal values and policy") {
+        auto result = solver.solve();
+        REQUIRE(result.stop_reason == StopReason::EPSILON);
+        REQUIRE(result.residual < 1e-6);
+
+        // Values reach the furthest states after 3 sweeps, the 4th one sees no change
+        REQUIRE(result.iterations == 4);
+
+        for (const auto& s: g.get_states()) {
+            INFO("State: " << s);
+            double distance = static_cast<double>(std::min(s.row + s.column, 6 - s.row - s.column));
+            REQUIRE(result.value(s) == Approx(-distance));
+        }
+
+        REQUIRE(result.action(State{0, 1}) == Action::LEFT);
+        REQUIRE(result.action(State{1, 0}) == Action::UP);
+        REQUIRE(result.action(State{3, 2}) == Action::RIGHT);
+        REQUIRE(result.action(State{2, 3}) == Action::DOWN);
+    }
+
+    SECTION("Greedy actions follow the values") {
+        auto result = solver.solve();
+        for (const auto& s: g.get_states()) {
+            if (g.is_terminal_state(s)) continue;
+
+            auto [next, reward, probability] = g.get_transitions(s, result.action(s)).front();
+            INFO("State: " << s);
+            REQUIRE(reward + result.value(next) == Approx(result.value(s)));
+        }
+    }
+
+    SECTION("Stopping criteria") {
+        StoppingCriteria criteria;
+        criteria.epsilon.reset();
+        criteria.max_iterations = 2;
+        auto result = solver.solve(criteria);
+        REQUIRE(result.stop_reason == StopReason::MAX_ITERATIONS);
+        REQUIRE(result.iterations == 2);
+        REQUIRE(result.value(State{1, 1}) == -2.0_a);
+        REQUIRE(result.value(State{1, 2}) == -2.0_a);
+
+        criteria.max_iterations.reset();
+        criteria.time_budget = std::chrono::duration<double>::zero();
+        result = solver.solve(criteria);
+        REQUIRE(result.stop_reason == StopReason::TIME_BUDGET);
+        REQUIRE(result.iterations == 1);
+
+        REQUIRE_THROWS_AS(solver.solve(StoppingCriteria{std::nullopt}), std::invalid_argument);
+    }
+
+    SECTION("Warm start") {
+        auto result = solver.solve();
+        auto warm = solver.solve(result.values, StoppingCriteria{});
+        REQUIRE(warm.iterations == 1);
+        REQUIRE(warm.values == result.values);
+        REQUIRE(warm.setup_time == result.setup_time);
+
+        REQUIRE_THROWS_AS(solver.solve(std::vector<double>(3), StoppingCriteria{}), std::invalid_argument);
+    }
+
+    SECTION("Compiled model") {
+        ValueIterationSolver<Gridworld> compiled_solver(solver.get_model(), 1.0);
+        REQUIRE(compiled_solver.solve().values == solver.solve().values);
+    }
+}
+
+TEST_CASE("Value iteration on a GraphMDP", "[value_iteration][graphmdp]") {
+    using State = std::string;
+    using Action = rl::mdp::TwoWayAction;
+    using Graph = rl::mdp::GraphMDP<State, Action>;
+
+    // Chain ending in a goal, and a cycle where the values never converge with gamma = 1
+    auto g = make_chain({"A", "B", "C", "GOOD"});
+
+    SECTION("Discounted") {
+        auto result = ValueIterationSolver<Graph>(*g, 0.9).solve();
+        REQUIRE(result.stop_reason == StopReason::EPSILON);
+        REQUIRE(result.value("C") == 10.0_a);
+        REQUIRE(result.value("B") == Approx(-1.0 + 0.9 * 10.0));
+        REQUIRE(result.value("A") == Approx(-1.0 + 0.9 * (-1.0 + 0.9 * 10.0)));
+        for (const auto& s: {"A", "B", "C"}) REQUIRE(result.action(s) == Action::RIGHT);
+    }
+
+    SECTION("Span seminorm") {
+        // Every state gains the same reward forever, so only the span converges
+        Graph loop;
+        loop.add_transition("X", Action::LEFT, "Y", 1.0, 1.0);
+        loop.add_transition("Y", Action::LEFT, "X", 1.0, 1.0);
+        loop.add_transition("X", Action::RIGHT, "X", 0.5, 1.0);
+        loop.add_transition("Y", Action::RIGHT, "Y", 0.5, 1.0);
+
+        StoppingCriteria criteria;
+        criteria.span = 1e-9;
+        criteria.max_iterations = 1000;
+        auto result = ValueIterationSolver<Graph>(loop, 1.0).solve(criteria);
+        REQUIRE(result.stop_reason == StopReason::SPAN);
+        REQUIRE(result.residual == 1.0_a);
+        REQUIRE(result.action("X") == Action::LEFT);
+        REQUIRE(result.action("Y") == Action::LEFT);
+    }
+}
+
+TEST_CASE("Prioritized sweeping", "[prioritized_sweeping]") {
+    using State = Gridworld::State;
+
+    // Sparse rewards, only reaching the goal is rewarded, so most states do not change between sweeps
+    size_t rows = 30, columns = 30;
+    Gridworld g(rows, columns);
+    g.bounds_penalty(0.0);
+    for (size_t row = 0; row + 5 < rows; ++row) g.set_wall_state({row, columns / 3}, 0.0);
+    for (size_t row = 5; row != rows; ++row) g.set_wall_state({row, 2 * columns / 3}, 0.0);
+    g.add_transition({10, 5}, Gridworld::Action::UP, {9, 5}, 0.0, 3.0);
+    g.add_transition({10, 5}, Gridworld::Action::UP, {10, 6}, 0.0, 1.0);
+    g.set_terminal_state({rows - 1, columns - 1}, 10.0);
+
+    auto reference = ValueIterationSolver<Gridworld>(g, 0.95).solve(StoppingCriteria{1e-10});
+
+    SECTION("Same fixed point as value iteration") {
+        PrioritizedSweepingSolver<Gridworld> solver(g, 0.95);
+        rl::mdp::PrioritizedSweepingSettings settings;
+        settings.theta = 1e-10;
+        auto result = solver.solve(settings);
+
+        REQUIRE(result.converged);
+        for (const auto& s: g.get_states()) {
+            INFO("State: " << s);
+            REQUIRE(result.value(s) == Approx(reference.value(s)).margin(1e-7));
+            if (!g.is_terminal_state(s)) REQUIRE(result.action(s) == reference.action(s));
+        }
+
+        // Far fewer backups than full sweeps
+        INFO("Backups: " << result.backups << " value iteration: " << reference.iterations * g.num_states());
+        REQUIRE(result.backups < reference.iterations * g.num_states() / 10);
+    }
+
+    SECTION("Same fixed point as policy iteration") {
+        rl::mdp::GridworldGreedyPolicy policy(std::make_shared<Gridworld>(g), 0.95);
+        do {
+            while (policy.policy_evaluation() > 1e-10);
+        } while (policy.update_policy());
+
+        rl::mdp::PrioritizedSweepingSettings settings;
+        settings.theta = 1e-10;
+        auto result = PrioritizedSweepingSolver<Gridworld>(g, 0.95).solve(settings);
+        for (const auto& s: g.get_states()) {
+            INFO("State: " << s);
+            REQUIRE(result.value(s) == Approx(policy.value_function(s)).margin(1e-7));
+        }
+    }
+
+    SECTION("Backup budget") {
+        rl::mdp::PrioritizedSweepingSettings settings;
+        settings.max_backups = 10;
+        auto result = PrioritizedSweepingSolver<Gridworld>(g, 0.95).solve(settings);
+        REQUIRE_FALSE(result.converged);
+        REQUIRE(result.backups == 10);
+
+        // The first backups are next to the goal
+        REQUIRE(result.value(State{rows - 2, columns - 1}) == 10.0_a);
+        REQUIRE(result.value(State{0, 0}) == 0.0_a);
+    }
+
+    SECTION("Predecessor index") {
+        auto index = rl::mdp::detail::predecessor_index(g);
+        std::vector<size_t> predecessors;
+        index.for_each(g.state_index({9, 5}), [&](size_t p) { predecessors.push_back(p); });
+        std::vector<size_t> expected{g.state_index({8, 5}), g.state_index({9, 4}), g.state_index({9, 6}),
+                                     g.state_index({10, 5})};
+        REQUIRE(predecessors == expected);
+
+        // Terminal states have no successors
+        predecessors.clear();
+        index.for_each(g.state_index({rows - 2, columns - 1}), [&](size_t p) { predecessors.push_back(p); });
+        REQUIRE(std::find(predecessors.begin(), predecessors.end(), g.state_index({rows - 1, columns - 1})) == predecessors.end());
+    }
+}
+
+TEST_CASE("Exact policy evaluation", "[linear_solver]") {
+    using State = Gridworld::State;
+
+    SECTION("BiCGSTAB") {
+        // Non-symmetric system with solution [1, 2, 3]
+        rl::mdp::SparseMatrix<double> matrix;
+        matrix.row_offsets = {0, 2, 5, 7};
+        matrix.columns = {0, 1, 0, 1, 2, 1, 2};
+        matrix.values = {4.0, 1.0, -2.0, 5.0, 1.0, 1.0, 3.0};
+        std::vector<double> b{6.0, 11.0, 11.0}, x(3, 0.0);
+
+        auto result = rl::mdp::bicgstab(matrix, b, x);
+        REQUIRE(result.converged);
+        REQUIRE(result.residual <= 1e-10);
+        REQUIRE(x[0] == 1.0_a);
+        REQUIRE(x[1] == 2.0_a);
+        REQUIRE(x[2] == 3.0_a);
+    }
+
+    auto g = std::make_shared<Gridworld>(12, 15);
+    g->cost_of_living(-1.0);
+    for (size_t row = 0; row != 9; ++row) g->set_wall_state({row, 7}, -2.0);
+    g->add_transition({5, 3}, Gridworld::Action::RIGHT, {5, 4}, -1.0, 3.0);
+    g->add_transition({5, 3}, Gridworld::Action::RIGHT, {0, 0}, 2.0, 1.0);
+    g->set_terminal_state({0, 14}, 5.0);
+    g->set_terminal_state({11, 0}, std::nullopt);
+
+    SECTION("Same values as the sweeps") {
+        for (bool compiled: {false, true}) {
+            rl::mdp::GridworldGreedyPolicy exact(g, 0.9), sweeps(g, 0.9);
+            if (compiled) exact.compile_model();
+
+            for (size_t iteration = 0; iteration != 3; ++iteration) {
+                auto result = exact.evaluate_exact();
+                REQUIRE(result.converged);
+                while (sweeps.policy_evaluation() > 1e-12);
+
+                for (const auto& s: g->get_states()) {
+                    INFO("State: " << s << " compiled: " << compiled);
+                    REQUIRE(exact.value_function(s) == Approx(sweeps.value_function(s)).margin(1e-8));
+                }
+
+                // A single sweep from the exact values does not change them
+                REQUIRE(exact.policy_evaluation() < 1e-8);
+                exact.update_policy();
+                sweeps.update_policy();
+            }
+        }
+    }
+
+    SECTION("Policy iteration without discount") {
+        // Every policy reaches a terminal state, so the system is not singular with gamma = 1
+        rl::mdp::GridworldGreedyPolicy policy(g, 1.0);
+        size_t improvements = 0;
+        do {
+            REQUIRE(policy.evaluate_exact().converged);
+            ++improvements;
+        } while (policy.update_policy() && improvements != 100);
+        REQUIRE(improvements < 10);
+
+        StoppingCriteria criteria;
+        criteria.epsilon = 1e-12;
+        auto reference = ValueIterationSolver<Gridworld>(*g, 1.0).solve(criteria);
+        for (const auto& s: g->get_states()) {
+            INFO("State: " << s);
+            REQUIRE(policy.value_function(s) == Approx(reference.value(s)).margin(1e-8));
+        }
+    }
+
+    SECTION("Singular systems keep the values") {
+        // Without terminal states the undiscounted values diverge
+        auto open = std::make_shared<Gridworld>(4, 4);
+        open->cost_of_living(-1.0);
+        rl::mdp::GridworldGreedyPolicy policy(open, 1.0);
+        policy.policy_evaluation();
+
+        auto result = policy.evaluate_exact();
+        REQUIRE_FALSE(result.converged);
+        REQUIRE(policy.value_function(State{1, 1}) == -1.0_a);
+    }
+}
+
+TEST_CASE("Multigrid on a Gridworld", "[multigrid]") {
+    using State = Gridworld::State;
+
+    // Rooms separated by walls with a gap, the goal is in the far corner
+    size_t rows = 96, columns = 80;
+    auto g = std::make_shared<Gridworld>(rows, columns);
+    g->cost_of_living(-0.1);
+    for (size_t row = 0; row + 10 < rows; ++row) g->set_wall_state({row, 30}, -1.0);
+    for (size_t column = 31; column + 8 < columns; ++column) g->set_wall_state({50, column}, -1.0);
+    g->cost_of_living({60, 10}, -5.0);
+    g->set_terminal_state({rows - 1, columns - 1}, 10.0);
+
+    rl::mdp::MultigridSettings settings;
+    settings.min_size = 16;
+    settings.epsilon = 1e-9;
+    rl::mdp::GridworldMultigridSolver solver(g, 0.99, settings);
+
+    SECTION("Levels") {
+        const auto& levels = solver.get_levels();
+        REQUIRE(levels.size() == 4);
+        REQUIRE(levels.front() == g);
+        REQUIRE(levels[1]->get_rows() == 48);
+        REQUIRE(levels[1]->get_columns() == 40);
+        REQUIRE(levels[3]->get_rows() == 12);
+        REQUIRE(levels[3]->get_columns() == 10);
+
+        // Walls where at least half of the block is a wall, terminals where any cell is terminal
+        REQUIRE(levels[1]->is_wall_state(State{10, 15}));
+        REQUIRE_FALSE(levels[1]->is_wall_state(State{45, 15}));
+        REQUIRE_FALSE(levels[1]->is_wall_state(State{10, 5}));
+        REQUIRE(levels[1]->is_wall_state(State{25, 20}));
+        REQUIRE(levels[1]->is_terminal_state(State{47, 39}));
+        REQUIRE(levels[1]->get_cost_of_living() == Approx(-0.199));
+        REQUIRE(levels[1]->entry_reward(State{30, 5}) < levels[1]->get_cost_of_living());
+    }
+
+    // Plain value iteration from zero values
+    rl::mdp::GridworldGreedyPolicy reference(g, 0.99);
+    size_t reference_sweeps = 0;
+    do {
+        reference.update_policy();
+        ++reference_sweeps;
+    } while (reference.policy_evaluation() >= settings.epsilon);
+    reference.update_policy();
+
+    auto require_reference_values = [&](const rl::mdp::GridworldGreedyPolicy& policy) {
+        for (const auto& s: g->get_states()) {
+            INFO("State: " << s);
+            REQUIRE(policy.value_function(s) == Approx(reference.value_function(s)).margin(1e-6));
+        }
+    };
+
+    SECTION("Same values as value iteration") {
+        auto result = solver.solve();
+        REQUIRE(result.converged);
+        REQUIRE(result.levels.size() == 4);
+        REQUIRE(result.levels.back().rows == rows);
+        REQUIRE(result.policy->get_gridworld() == g);
+        require_reference_values(*result.policy);
+
+        // The warm start gives the final directions, so a sweep from the terminals reaches every cell
+        INFO("Value iteration: " << reference_sweeps << " multigrid: " << result.levels.back().sweeps);
+        REQUIRE(result.levels.back().sweeps < reference_sweeps / 10);
+    }
+
+    SECTION("Jacobi sweeps") {
+        settings.evaluation_mode = rl::mdp::EvaluationMode::JACOBI;
+        auto result = rl::mdp::GridworldMultigridSolver(g, 0.99, settings).solve();
+        REQUIRE(result.converged);
+        REQUIRE(result.levels.back().sweeps <= reference_sweeps);
+        require_reference_values(*result.policy);
+    }
+}
+
+TEST_CASE("Policy iteration", "[policy_iteration]") {
+    using rl::mdp::PolicyIteration;
+    using rl::mdp::PolicyIterationSettings;
+    using GridworldIteration = PolicyIteration<rl::mdp::GridworldGreedyPolicy>;
+
+    size_t rows = 20, columns = 20;
+    auto g = make_walled_gridworld(rows, columns);
+
+    StoppingCriteria criteria;
+    criteria.epsilon = 1e-10;
+    auto reference = ValueIterationSolver<Gridworld>(*g, 0.95).solve(criteria);
+
+    PolicyIterationSettings settings;
+    settings.epsilon = 1e-10;
+
+    SECTION("Converges for every amount of sweeps") {
+        size_t previous_improvements = std::numeric_limits<size_t>::max();
+        for (size_t sweeps: {1, 5, 50, 1000}) {
+            rl::mdp::GridworldGreedyPolicy policy(g, 0.95);
+            settings.evaluation_sweeps = sweeps;
+            auto result = GridworldIteration(policy, settings).run();
+
+            INFO("Evaluation sweeps: " << sweeps << " improvements: " << result.improvements);
+            REQUIRE(result.converged);
+            REQUIRE(result.residual < 1e-10);
+            REQUIRE(result.improvement.sweeps == result.improvements);
+            REQUIRE(result.evaluation.sweeps <= sweeps * result.improvements);
+            REQUIRE(result.evaluation.backups == result.evaluation.sweeps * g->num_states());
+            REQUIRE(result.improvement.backups == result.improvements * g->num_states());
+
+            // Longer evaluations need fewer improvements
+            REQUIRE(result.improvements <= previous_improvements);
+            previous_improvements = result.improvements;
+
+            for (const auto& s: g->get_states()) {
+                INFO("State: " << s);
+                REQUIRE(policy.value_function(s) == Approx(reference.value(s)).margin(1e-7));
+            }
+        }
+    }
+
+    SECTION("Warm start") {
+        rl::mdp::GridworldGreedyPolicy policy(g, 0.95);
+        GridworldIteration iteration(policy, settings);
+        auto first = iteration.run();
+        REQUIRE(first.converged);
+
+        // The values are kept, so the policy is already stable
+        auto second = iteration.run();
+        REQUIRE(second.converged);
+        REQUIRE(second.improvements == 1);
+        REQUIRE(second.evaluation.sweeps == 1);
+
+        // Opening a shortcut only needs a few more improvements
+        g->set_terminal_state({rows - 1, columns - 1}, 20.0);
+        auto third = iteration.run();
+        REQUIRE(third.converged);
+        REQUIRE(third.evaluation.sweeps < first.evaluation.sweeps);
+    }
+
+    SECTION("Improvement budget") {
+        rl::mdp::GridworldGreedyPolicy policy(g, 0.95);
+        settings.evaluation_sweeps = 1;
+        settings.max_improvements = 3;
+        auto result = GridworldIteration(policy, settings).run();
+        REQUIRE_FALSE(result.converged);
+        REQUIRE(result.improvements == 3);
+    }
+
+    SECTION("GraphMDP") {
+        using State = std::string;
+        using Action = rl::mdp::TwoWayAction;
+
+        std::vector<State> states{"A", "B", "C", "GOOD"};
+        auto graph = make_chain(states);
+
+        rl::mdp::GraphMDP_Greedy<State, Action> policy(graph, 0.9);
+        auto result = PolicyIteration<decltype(policy)>(policy, settings).run();
+        REQUIRE(result.converged);
+        REQUIRE(result.evaluation.backups == result.evaluation.sweeps * states.size());
+        REQUIRE(policy.value_function("A") == Approx(-1.0 + 0.9 * (-1.0 + 0.9 * 10.0)));
+        REQUIRE(policy.get_action_probabilities("A") ==
+                std::vector<std::pair<Action, double>>{{Action::LEFT, 0.0}, {Action::RIGHT, 1.0}});
+    }
+}
+
+TEST_CASE("Incremental policy improvement", "[policy_iteration][incremental]") {
+    using Policy = rl::mdp::GridworldGreedyPolicy;
+
+    size_t rows = 20, columns = 20;
+    auto g = make_walled_gridworld(rows, columns);
+
+    auto probabilities = [&g](const Policy& policy) {
+        std::vector<std::vector<Policy::ActionProbability>> table;
+        for (const auto& s: g->get_states()) table.push_back(policy.get_action_probabilities(s));
+        return table;
+    };
+    auto changed_states = [](const auto& before, const auto& after) {
+        size_t changed = 0;
+        for (size_t idx = 0; idx != before.size(); ++idx) changed += before[idx] != after[idx];
+        return changed;
+    };
+
+    // Modified policy iteration with full and incremental improvements
+    auto same_policies = [&](Policy& full, Policy& incremental) {
+        size_t last_changed = 0;
+        for (size_t improvement = 0; improvement != 60; ++improvement) {
+            for (size_t sweep = 0; sweep != 5; ++sweep) {
+                full.policy_evaluation();
+                incremental.policy_evaluation();
+            }
+
+            auto before = probabilities(incremental);
+            full.update_policy();
+            last_changed = incremental.update_policy_incremental();
+
+            auto after = probabilities(incremental);
+            INFO("Improvement " << improvement);
+            REQUIRE(last_changed == changed_states(before, after));
+            REQUIRE(after == probabilities(full));
+        }
+        return last_changed;
+    };
+
+    SECTION("Same policy as full improvements") {
+        for (bool compiled: {false, true}) {
+            Policy full(g, 0.95), incremental(g, 0.95);
+            if (compiled) {
+                full.compile_model();
+                incremental.compile_model();
+            }
+
+            INFO("Compiled: " << compiled);
+            REQUIRE(same_policies(full, incremental) == 0);
+        }
+    }
+
+    SECTION("Model changes improve every state") {
+        Policy full(g, 0.95), incremental(g, 0.95);
+        same_policies(full, incremental);
+
+        // Values are unchanged, only the dynamics of the cells around the new terminal
+        g->set_terminal_state({rows - 1, columns - 1}, 20.0);
+        full.update_policy();
+        REQUIRE(incremental.update_policy_incremental() > 0);
+        REQUIRE(probabilities(incremental) == probabilities(full));
+        same_policies(full, incremental);
+    }
+
+    SECTION("Tolerance") {
+        Policy policy(g, 0.95);
+        policy.update_policy_incremental();
+
+        // A single sweep of the greedy policy moves every cell by at most the in-reward of the terminal
+        policy.policy_evaluation();
+        auto before = probabilities(policy);
+        REQUIRE(policy.update_policy_incremental(25.0) == 0);
+        REQUIRE(probabilities(policy) == before);
+    }
+
+    SECTION("GraphMDP") {
+        using State = std::string;
+        using Action = rl::mdp::TwoWayAction;
+
+        std::vector<State> states;
+        for (size_t i = 0; i != 10; ++i) states.push_back("S" + std::to_string(i));
+        states.emplace_back("GOOD");
+        auto graph = make_chain(states);
+
+        rl::mdp::GraphMDP_Greedy<State, Action> full(graph, 0.9), incremental(graph, 0.9);
+        size_t last_changed = 0;
+        for (size_t improvement = 0; improvement != 20; ++improvement) {
+            full.policy_evaluation();
+            incremental.policy_evaluation();
+            full.update_policy();
+            last_changed = incremental.update_policy_incremental();
+
+            for (size_t i = 0; i + 1 != states.size(); ++i) {
+                INFO("Improvement " << improvement << " state " << states[i]);
+                REQUIRE(incremental.get_action_probabilities(states[i]) == full.get_action_probabilities(states[i]));
+            }
+        }
+        REQUIRE(last_changed == 0);
+        REQUIRE(incremental.get_action_probabilities("S0") ==
+                std::vector<std::pair<Action, double>>{{Action::LEFT, 0.0}, {Action::RIGHT, 1.0}});
+    }
+}